@@ -36,6 +36,7 @@ int main(int argc, char *argv[])
   int ret = 0;
   double time_elapsed;
   size_t tpeak;
+  compass_store *store = NULL;
   //csa->graph = NULL;
   csa->format = FMT_LIB_FILE;
   csa->tm_start = xtime();
@@ -52,7 +53,13 @@ int main(int argc, char *argv[])
   compass_neigh_init_cp(csa->neighcp);
   csa->in_res = NULL;
   csa->scale = 1;
+  csa->dist_table = 5000;
+  csa->dist_cache = -1;
+  csa->spacefill = 0;
+  csa->load_stats = 0;
   csa->out_sol = NULL;
+  csa->out_bin = NULL;
+  csa->cache_dir = NULL;
   csa->out_res = NULL;
   csa->out_ranges = NULL;
   csa->check = 0;
@@ -121,7 +128,8 @@ int main(int argc, char *argv[])
     goto done;
   }
   if (csa->format == FMT_LIB_FILE)
-  { ret = compass_read_prob(csa->prob, FMT_LIB_FILE, csa->in_file);
+  { ret = compass_read_prob(csa->prob, FMT_LIB_FILE |
+        (csa->load_stats ? FMT_LOAD_STATS : 0), csa->in_file);
     if (ret != 0)
 err1: {  xprintf("LIB file processing error\n");
         ret = EXIT_FAILURE;
@@ -140,30 +148,107 @@ err1: {  xprintf("LIB file processing error\n");
   if (csa->new_name != NULL)
     compass_set_prob_name(csa->prob, csa->new_name);
   /*--------------------------------------------------------------------------*/
-  /* hash the problem */
-  compass_hash_init(csa->prob);
-  compass_hash_update(csa->prob, HASH_UPDATE_NAME);
-  compass_hash_update(csa->prob, HASH_UPDATE_OPSCORE);
-  compass_hash_update(csa->prob, HASH_UPDATE_OPD0);
-  if (csa->hash_tm)
-    compass_hash_update_time(csa->prob, csa->tm_start);
+  /* hash the problem, unless read with it from a binary file */
+  if (!csa->prob->hashed || csa->hash_tm)
+  { compass_hash_init(csa->prob);
+    compass_hash_update(csa->prob, HASH_UPDATE_NAME);
+    compass_hash_update(csa->prob, HASH_UPDATE_OPSCORE);
+    compass_hash_update(csa->prob, HASH_UPDATE_OPD0);
+    if (csa->hash_tm)
+      compass_hash_update_time(csa->prob, csa->tm_start);
+  }
   compass_hash_print(csa->prob->hash);
+  /*--------------------------------------------------------------------------*/
+  /* write the problem in binary format, if required */
+  if (csa->out_bin != NULL)
+  { if (compass_write_bin(csa->prob, csa->out_bin))
+    { ret = EXIT_FAILURE;
+      goto done;
+    }
+  }
+  /*--------------------------------------------------------------------------*/
+  /* renumber the nodes along a space filling curve, if required */
+  if (csa->spacefill)
+  { xprintf("Renumbering the nodes along a space filling curve...\n");
+    if (compass_spacefill_prob(csa->prob))
+      xprintf("Nodes not renumbered - %s", get_err_msg());
+  }
+  /*--------------------------------------------------------------------------*/
+  /* precompute the edge lengths, if the problem is small enough */
+  { compass_data *data = csa->prob->data;
+    if (data->n <= csa->dist_table && data->n <= DATA_TABLE_MAXN
+        && (data->norm & (CC_D2_NORM_SIZE | CC_D3_NORM_SIZE))
+        && data->adj == (int **) NULL)
+    { xprintf("Precomputing the edge lengths (%.1f Mb)...\n",
+          (double) data->n * (data->n + 1) / 2 * sizeof(int) / 1048576.0);
+      if (compass_data_build_table(data, csa->opcp->eacp->nthreads))
+      { xprintf("Unable to precompute the edge lengths\n");
+        ret = EXIT_FAILURE;
+        goto done;
+      }
+    }
+  }
+  /*--------------------------------------------------------------------------*/
+  /* share a distance cache among the subproblems, if worth it */
+  { compass_data *data = csa->prob->data;
+    int mb = csa->dist_cache;
+    if (mb < 0)
+      mb = (data->adj == (int **) NULL && (data->norm == CC_GEOGRAPHIC
+          || data->norm == CC_GEOM)) ? DIST_CACHE_MB : 0;
+    if (mb > 0)
+      csa->prob->cache = compass_cache_create(data, mb);
+  }
+  /*--------------------------------------------------------------------------*/
+  /* open the cache of derived data, if required */
+  if (csa->cache_dir != NULL)
+  { if (csa->hash_tm)
+      xprintf("Cache directory ignored - problem hashed with time\n");
+    else
+      store = compass_store_open(csa->prob, csa->cache_dir, csa->neighcp);
+  }
   /******************************************/
   compass_init_rng(csa->prob, csa->seed);
   /*--------------------------------------------------------------------------*/
   /* Build neigh graph */
-  compass_data_k_nearest (csa->prob, csa->neighcp );
+  /* with a cache, the random numbers drawn by the steps it can skip are
+   * given back, so that the run does not depend on what was found in it */
+  rstate = *csa->prob->rstate_cc;
+  if (store == NULL || !compass_store_get_neigh(store, csa->prob))
+  { compass_data_k_nearest (csa->prob, csa->neighcp );
+    if (csa->neighcp->induced)
+      compass_data_cand_graph (csa->prob, csa->neighcp );
+    if (store != NULL)
+    { compass_store_put_neigh(store, csa->prob);
+      *csa->prob->rstate_cc = rstate;
+    }
+  }
   /*--------------------------------------------------------------------------*/
   /* solve problems*/
   if (csa->solve_tsp == COMPASS_ON )
     main_tsp(csa, argc, argv);
   if (csa->solve_op == COMPASS_ON )
   { if (csa->opcp->initcp->pinit==0)
-    { main_tsp(csa, argc, argv);
+    { if (store != NULL && compass_store_get_tour(store, csa->prob))
+        xprintf ("tsp  : Reference tour value: %.0f (cached)\n",
+            csa->prob->tsp->sol->val);
+      else
+      { rstate = *csa->prob->rstate_cc;
+        main_tsp(csa, argc, argv);
+        if (store != NULL)
+        { compass_store_put_tour(store, csa->prob);
+          *csa->prob->rstate_cc = rstate;
+        }
+      }
       csa->opcp->initcp->pinit = sqrt(csa->prob->op->d0 / csa->prob->tsp->sol->val);
     }
-    main_op(csa, argc, argv);
   }
+  /* write the cache before the long run */
+  if (store != NULL)
+  { compass_store_close(store);
+    store = NULL;
+  }
+  if (csa->solve_op == COMPASS_ON )
+    main_op(csa, argc, argv);
   /*--------------------------------------------------------------------------*/
   /* Time and memory usage summary*/
   xprintf("\n");
@@ -173,6 +258,13 @@ err1: {  xprintf("LIB file processing error\n");
   compass_mem_usage(NULL, NULL, NULL, &tpeak);
   xprintf("Memory used: %.1f Mb (%.0f bytes)\n",
       (double)tpeak / 1048576.0, (double)tpeak);
+  if (csa->prob->cache != NULL)
+  { double size, hits, misses;
+    compass_cache_stats(csa->prob->cache, &size, &hits, &misses);
+    xprintf("Distance cache: %.0f entries, %.0f hits, %.0f misses"
+        " (%.1f%% hits)\n", size, hits, misses,
+        hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0);
+  }
 
 #if 0
   if ( csa->stats_file == COMPASS_ON )
@@ -193,6 +285,8 @@ err1: {  xprintf("LIB file processing error\n");
   ret = EXIT_SUCCESS;
   /*--------------------------------------------------------------------------*/
 done:
+  if (store != NULL)
+    compass_store_close(store);
   xfree(csa->neighcp);
   compass_tsp_delete_cp(csa->tspcp);
   compass_op_delete_cp(csa->opcp);
@@ -239,6 +333,8 @@ static void print_help(const char *my_name)
   xprintf("  --wlp filename       Write problem to filename in CPLEX LP format\n");
   xprintf("  --wglp filename      Write problem to filename in GLPK format\n");
   xprintf("  --wop filename       Write OP to filename in TSPLIB format\n");
+  xprintf("  --wbin filename      Write problem to filename in binary format, read\n"
+          "                       back in place (mapped) as input file\n");
   xprintf("  --log filename       Write copy of terminal output to filename\n");
   xprintf("  -h, --help           Display this help information and exit\n");
   xprintf("  --version            Display program version and exit\n");
@@ -251,12 +347,27 @@ static void print_help(const char *my_name)
   xprintf("                       8=DSJRAND, 9=CRYSTAL, 10=SPARSE, 11-15=RH-norm 1-5,\n");
   xprintf("                       16=TOROIDAL ,17=GEOM, 18=JOHNSON\n");
   xprintf("  --neigh-set #       Neighbor set technique\n"
-          "                        %d-Nearest[default], %d-Quadnearest, %d-Delaunay\n",
+          "                        %d-Nearest[default], %d-Quadnearest, %d-Delaunay,\n"
+          "                        %d-Alpha-nearness\n",
                                     NEIGH_NEAREST, NEIGH_QUADNEAREST,
-                                    NEIGH_DELAUNAY);
+                                    NEIGH_DELAUNAY, NEIGH_ALPHA);
+  xprintf("  --neigh-induced     Induce the neighbor sets of subproblems from the\n"
+          "                        candidate graph of the full problem\n");
   xprintf("  --scale              Scale problem (default)\n");
   xprintf("  --hash-with-tm       Hash the problem using initialization time\n");
+  xprintf("  --load-stats         Report the size and the loading speed of the problem\n"
+          "                        file\n");
   xprintf("  --noscale            Do not scale problem\n");
+  xprintf("  --dist-table n       Precompute the edge lengths of problems with at most\n"
+          "                        n nodes (default 5000, 0 = never)\n");
+  xprintf("  --spacefill          Renumber the nodes along a space filling curve for\n"
+          "                        memory locality (solutions keep the file numbers)\n");
+  xprintf("  --dist-cache m       Cache the edge lengths computed in m Mb shared by\n"
+          "                        all threads (default %d for GEO and GEOM norms,\n"
+          "                        0 = never)\n", DIST_CACHE_MB);
+  xprintf("  --cache-dir dir      Keep the neighbor graph, the kd-tree and the reference\n"
+          "                        tour of the problem in dir and reuse them in later\n"
+          "                        runs\n");
   xprintf("\n");
   xprintf("Traveller Salesman Problem options:\n");
   xprintf("\n");
@@ -298,9 +409,28 @@ static void print_help(const char *my_name)
   xprintf("  --ea-itlim n         Number of iterations\n");
   xprintf("  --ea-improve1 d      1 if on. 0 else.\n");
   xprintf("  --ea-improve2 d      1 if On. 0 else.\n");
+  xprintf("  --ea-improve-full    Improve the whole tour after add/drop phase"
+      "s\n");
+  xprintf("                       (default only around the changed nodes)\n");
+  xprintf("  --ea-fix p           Fix the tour edges shared by a fraction p of "
+      "the\n");
+  xprintf("                       best quarter of the population in "
+      "Lin-Kernighan\n");
   xprintf("  --ea-d2d it          Number of iterations between add/drop phase"
       "s\n");
   xprintf("  --pop-size p         Population size\n");
+  xprintf("  --ea-threads n       Number of threads for the add/drop phases "
+      "and\n");
+  xprintf("                       batches (0 = all)\n");
+  xprintf("  --ea-batch b         Number of children bred in parallel per "
+      "iteration\n");
+  xprintf("  --ea-islands n       Number of islands (populations) evolved in "
+      "parallel\n");
+  xprintf("  --ea-migr-it k       Number of iterations between migrations "
+      "(default d2d)\n");
+  xprintf("  --ea-migr-size m     Number of elites sent per migration\n");
+  xprintf("  --ea-migr-ring       Send elites to the next island (default)\n");
+  xprintf("  --ea-migr-all        Send elites to all other islands\n");
   xprintf("  --stop-pop p         Population based stopping criteria (perc)\n");
   xprintf("  --ea-pmut p          Use mutation p probability\n");
   xprintf("  --ea-nparsel n       Number of parents preselected\n");
@@ -409,6 +539,18 @@ static int parse_cmdline(struct csa *csa, int argc, char *argv[])
       }
       csa->out_sol = argv[k];
     }
+    else if (p("--wbin"))
+    { k++;
+      if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
+      { xprintf("No output binary problem file specified\n");
+        return 1;
+      }
+      if (csa->out_bin != NULL)
+      { xprintf("Only one output binary problem file allowed\n");
+        return 1;
+      }
+      csa->out_bin = argv[k];
+    }
     else if (p("-w") || p("--write"))
     { k++;
       if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
@@ -587,6 +729,7 @@ static int parse_cmdline(struct csa *csa, int argc, char *argv[])
       case NEIGH_NEAREST:     csa->neighcp->neigh_graph = NEIGH_NEAREST; break;
       case NEIGH_QUADNEAREST: csa->neighcp->neigh_graph = NEIGH_QUADNEAREST; break;
       case NEIGH_DELAUNAY:    csa->neighcp->neigh_graph = NEIGH_DELAUNAY; break;
+      case NEIGH_ALPHA:       csa->neighcp->neigh_graph = NEIGH_ALPHA; break;
       default:
         xprintf("Invalid tour improvement for phase 1'%d'\n", neigh_set);
         print_help (argv[0]);
@@ -595,6 +738,11 @@ static int parse_cmdline(struct csa *csa, int argc, char *argv[])
       csa->tspcp->neighcp->neigh_graph = csa->neighcp->neigh_graph;
       csa->opcp->tspcp->neighcp->neigh_graph = csa->neighcp->neigh_graph;
     }
+    else if (p("--neigh-induced"))
+    { csa->neighcp->induced = 1;
+      csa->tspcp->neighcp->induced = 1;
+      csa->opcp->tspcp->neighcp->induced = 1;
+    }
     else if (p("--neigh-k"))
     { int neigh_k;
       k++;
@@ -614,6 +762,44 @@ static int parse_cmdline(struct csa *csa, int argc, char *argv[])
       csa->scale = 1;
     else if (p("--noscale"))
       csa->scale = 0;
+    else if (p("--dist-table"))
+    { int dist_table;
+      k++;
+      if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
+      { xprintf("No number of nodes specified\n");
+        return 1;
+      }
+      if (str2int(argv[k], &dist_table) || dist_table < 0)
+      { xprintf("Invalid number of nodes '%s'\n", argv[k]);
+        return 1;
+      }
+      csa->dist_table = dist_table;
+    }
+    else if (p("--spacefill"))
+      csa->spacefill = 1;
+    else if (p("--load-stats"))
+      csa->load_stats = 1;
+    else if (p("--dist-cache"))
+    { int dist_cache;
+      k++;
+      if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
+      { xprintf("No cache size specified\n");
+        return 1;
+      }
+      if (str2int(argv[k], &dist_cache) || dist_cache < 0)
+      { xprintf("Invalid cache size '%s'\n", argv[k]);
+        return 1;
+      }
+      csa->dist_cache = dist_cache;
+    }
+    else if (p("--cache-dir"))
+    { k++;
+      if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
+      { xprintf("No cache directory specified\n");
+        return 1;
+      }
+      csa->cache_dir = argv[k];
+    }
     /*------------------------------------------------------------------------*/
     /* Population parameters*/
     else if (p("--pop-size"))
@@ -909,6 +1095,21 @@ static int parse_cmdline(struct csa *csa, int argc, char *argv[])
       }
       csa->opcp->eacp->len_improve2 = status;
     }
+    else if (p("--ea-improve-full"))
+      csa->opcp->eacp->len_repair = 0;
+    else if (p("--ea-fix"))
+    { double share;
+      k++;
+      if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
+      { xprintf("No fraction of the elite specified\n");
+        return 1;
+      }
+      if (str2num(argv[k], &share) || share < 0.0 || share > 1.0)
+      { xprintf("Invalid fraction of the elite '%s'\n", argv[k]);
+        return 1;
+      }
+      csa->opcp->eacp->fix_share = share;
+    }
     else if (p("--ea-d2d"))
     { int d2d;
       k++;
@@ -929,6 +1130,75 @@ static int parse_cmdline(struct csa *csa, int argc, char *argv[])
       else
         csa->opcp->eacp->d2d = d2d;
     }
+    else if (p("--ea-threads"))
+    { int nthreads;
+      k++;
+      if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
+      { xprintf("No number of threads specified\n");
+        return 1;
+      }
+      if (str2int(argv[k], &nthreads) || nthreads < 0)
+      { xprintf("Invalid number of threads '%s'\n", argv[k]);
+        return 1;
+      }
+      csa->opcp->eacp->nthreads = nthreads;
+    }
+    else if (p("--ea-batch"))
+    { int batch;
+      k++;
+      if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
+      { xprintf("No batch size specified\n");
+        return 1;
+      }
+      if (str2int(argv[k], &batch) || batch < 1)
+      { xprintf("Invalid batch size '%s'\n", argv[k]);
+        return 1;
+      }
+      csa->opcp->eacp->batch = batch;
+    }
+    else if (p("--ea-islands"))
+    { int nislands;
+      k++;
+      if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
+      { xprintf("No number of islands specified\n");
+        return 1;
+      }
+      if (str2int(argv[k], &nislands) || nislands < 1)
+      { xprintf("Invalid number of islands '%s'\n", argv[k]);
+        return 1;
+      }
+      csa->opcp->eacp->nislands = nislands;
+    }
+    else if (p("--ea-migr-it"))
+    { int migr_it;
+      k++;
+      if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
+      { xprintf("No migration interval specified\n");
+        return 1;
+      }
+      if (str2int(argv[k], &migr_it) || migr_it < 1)
+      { xprintf("Invalid migration interval '%s'\n", argv[k]);
+        return 1;
+      }
+      csa->opcp->eacp->migr_it = migr_it;
+    }
+    else if (p("--ea-migr-size"))
+    { int migr_size;
+      k++;
+      if (k == argc || argv[k][0] == '\0' || argv[k][0] == '-')
+      { xprintf("No number of migrants specified\n");
+        return 1;
+      }
+      if (str2int(argv[k], &migr_size) || migr_size < 0)
+      { xprintf("Invalid number of migrants '%s'\n", argv[k]);
+        return 1;
+      }
+      csa->opcp->eacp->migr_size = migr_size;
+    }
+    else if (p("--ea-migr-ring"))
+      csa->opcp->eacp->migr_topo = OP_MIGR_RING;
+    else if (p("--ea-migr-all"))
+      csa->opcp->eacp->migr_topo = OP_MIGR_ALL;
     /*------------------------------------------------------------------------*/
     else if (argv[k][0] == '-' || (argv[k][0] == '-' && argv[k][1] == '-'))
     { xprintf("Invalid option '%s'; try %s --help\n", argv[k], argv[0]);
@@ -63,18 +63,28 @@ struct compass_prob
   SHA256_CTX    *ctx;
   /* problem name (1 to 255 chars); NULL means no name is assigned
   to the problem */
+  int           hashed;
+  /* hash already holds the hash of the problem, read with it from a
+  binary file */
   int           n_max;
   /* length of the array of nodes (enlarged automatically) */
   int           n;
   /* number of nodes */
+  int           *node_id;
+  /* node_id[k] is the node of the input file for node k, if the nodes
+  were renumbered (see compass_spacefill_prob); NULL means k itself */
   compass_data *data;
   /* compass data object */
-  int           *cacheind;
-  int           *cacheval;
-  int           cacheM;
-  /* Distance cache */
+  compass_cache *cache;
+  /* distance cache installed on data, shared by the views of data in
+  all threads; NULL means no cache */
   CCkdtree  *kdtree;
   /* compass data object */
+  int           *neighbeg;
+  int           *neighlist;
+  /* candidate graph: the neighbors of node i, nearest first, are
+     neighlist[neighbeg[i]], ..., neighlist[neighbeg[i+1]-1]; NULL if
+     not built */
   int seed;
   /* seed value to be passed to the MathProg translator; initially
      set to 1; 0x80000000 means the value is omitted */
@@ -110,6 +120,7 @@ struct csa
 #define FMT_GLP         4  /* GLPK LP/MIP */
 #define FMT_MATHPROG    5  /* MathProg */
 #define FMT_LIB_FILE    6  /* TSP/OP LIB */
+#define FMT_LOAD_STATS  0x100 /* report the loading speed (flag) */
   const char *in_file;
   /* name of input problem file */
 #define DATA_MAX 10
@@ -130,8 +141,23 @@ struct csa
   /* name of input solution file in raw format */
   int scale;
   /* automatic problem scaling flag */
+  int dist_table;
+  /* the edge lengths of problems with coordinates and at most this many
+     nodes are precomputed in a table; 0 means never */
+  int spacefill;
+  /* renumber the nodes along a space filling curve after reading */
+  int dist_cache;
+  /* size of the distance cache in Mb; 0 means no cache, -1 means a cache
+     of DIST_CACHE_MB for the norms too costly to recompute */
+  int load_stats;
+  /* report the size and the loading speed of the problem file */
   const char *out_sol;
   /* name of output solution file in printable format */
+  const char *out_bin;
+  /* name of output problem file in binary format */
+  const char *cache_dir;
+  /* name of the directory caching the data derived from the problem;
+     NULL means no cache */
   const char *out_res;
   /* name of output solution file in raw format */
   const char *out_ranges;
@@ -184,4 +210,17 @@ struct csa
   /* flag to consider MIP as pure LP */
 };
 
+int compass_worker_prob(compass_prob *inprob, compass_prob *outprob,
+    int seed);
+/* create a view of inprob with its own random streams for a thread */
+
+void compass_delete_worker_prob(compass_prob *prob);
+/* delete a view created by compass_worker_prob */
+
+int compass_spacefill_prob(compass_prob *prob);
+/* renumber the nodes of prob along a space filling curve */
+
+int compass_write_bin(compass_prob *prob, const char *fname);
+/* write prob to a binary problem file */
+
 #endif
@@ -0,0 +1,464 @@
+/***********************************************************************
+*  This code is part of Compass.
+*
+*  Compass is free software: you can redistribute it and/or modify it
+*  under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  Compass is distributed in the hope that it will be useful, but WITHOUT
+*  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+*  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+*  License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with Compass. If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include "compass.h"
+#include "neigh.h"
+#include "xnear.h"
+#include "data/kdtree/kdtree.h"
+#include "tsp.h"
+#include "env.h"
+#include "util.h"
+
+#define ALPHA_CAND_FACTOR 5
+/* alpha-nearness values are computed for the ALPHA_CAND_FACTOR*k nearest
+ * neighbors of each node, and the subgradient optimization runs on this
+ * graph */
+#define ALPHA_PERIOD 25
+/* the step size is halved every ALPHA_PERIOD iterations */
+#define ALPHA_MAX_ITER 100
+/* maximum number of subgradient iterations */
+
+struct alpha_graph
+{ /* sparse graph on which the 1-trees are computed */
+  int n;
+  int *beg;
+  /* adj[beg[i]..beg[i+1]-1] are the neighbors of node i */
+  int *adj;
+  int *len;
+  /* len[p] is the length of the edge (i, adj[p]) */
+  double *pi;
+  /* node weights, c'(i,j) = c(i,j) + pi[i] + pi[j] */
+  int *dad;
+  /* dad[i] is the parent of node i in the minimum spanning tree, -1 for
+     the root */
+  double *dadcost;
+  /* dadcost[i] is c'(i,dad[i]) */
+  int *deg;
+  /* deg[i] is the degree of node i in the 1-tree */
+  int *state;
+  /* Prim: 0 not reached, 1 in the heap, 2 in the tree */
+  int special;
+  /* leaf s of the tree, joined to the 1-tree by its two cheapest edges */
+  int mate1, mate2;
+  /* the other ends of the 1-tree edges at s, mate1 the tree one */
+  double second;
+  /* c'(s,mate2) */
+  CCdheap heap;
+};
+
+static int build_graph (compass_prob *prob, struct alpha_graph *G, int kc);
+static double one_tree (struct alpha_graph *G);
+static void free_graph (struct alpha_graph *G);
+static int in_list (int *list, int cnt, int a);
+
+/***********************************************************************
+*  NAME
+*
+*  compass_data_alpha_nearest - build alpha-nearness neighbor graph
+*
+*  SYNOPSIS
+*
+*  int compass_data_alpha_nearest(compass_prob *prob,
+*     struct neigh_cp *neighcp);
+*
+*  DESCRIPTION
+*
+*  The routine compass_data_alpha_nearest stores in prob->tsp the graph
+*  joining each node to the neighcp->k nodes of lowest alpha-nearness.
+*
+*  The node weights pi of the Held-Karp 1-tree bound are first improved
+*  by subgradient optimization on the ALPHA_CAND_FACTOR*k nearest
+*  neighbor graph. The alpha-nearness of an edge (i,j) of this graph is
+*  the increase of the minimum 1-tree under the weights pi when it is
+*  forced to contain (i,j), that is c'(i,j) minus the longest edge on
+*  the tree path from i to j. Ties are broken by edge length.
+*
+*  If the nearest neighbor graph is not connected no 1-tree is computed
+*  and the routine falls back to the neighcp->k nearest neighbors.
+*
+*  RETURNS
+*
+*  The routine returns zero on success and non-zero otherwise. */
+
+int compass_data_alpha_nearest (compass_prob *prob, struct neigh_cp *neighcp)
+{ int a, b, i, p, q, u, it, k, kc, n = prob->n, top, cnt, best, ecount;
+  int connected, *nlist, *ncnt, *mark, *stack, *vlast;
+  double w, wbest, t, norm, *bestpi, *beta, *alpha;
+  struct alpha_graph G;
+  struct tsp_prob *tsp = prob->tsp;
+  k = neighcp->k;
+  if (k > n - 1)
+    k = n - 1;
+  kc = ALPHA_CAND_FACTOR * k;
+  if (kc > n - 1)
+    kc = n - 1;
+  if (neighcp->msg_lev >= COMPASS_MSG_ALL)
+    xprintf ("data  :  Generating %d-alpha-nearest Neighbor Graph...", k);
+  tsp->ecount = 0;
+  tsp->elist = (int *) NULL;
+  if (k < 1)
+    return 0;
+  if (build_graph (prob, &G, kc))
+  { put_err_msg("data  :   build_graph failed.\n");
+    return 1;
+  }
+  bestpi = xcalloc(n, sizeof(double));
+  vlast = xcalloc(n, sizeof(int));
+  for (i = 0; i < n; i++)
+  { G.pi[i] = 0.0;
+    bestpi[i] = 0.0;
+    vlast[i] = 0;
+  }
+  /* subgradient optimization of the 1-tree bound */
+  w = one_tree (&G);
+  connected = (w > -CCutil_MAXDOUBLE);
+  wbest = w;
+  t = 0.01 * w / n;
+  for (it = 0; connected && it < ALPHA_MAX_ITER; it++)
+  { norm = 0.0;
+    for (i = 0; i < n; i++)
+      norm += (G.deg[i] - 2) * (G.deg[i] - 2);
+    if (norm == 0.0)
+      break;   /* the 1-tree is a tour */
+    for (i = 0; i < n; i++)
+    { G.pi[i] += t * (0.7 * (G.deg[i] - 2) + 0.3 * vlast[i]);
+      vlast[i] = G.deg[i] - 2;
+    }
+    w = one_tree (&G);
+    if (w > wbest)
+    { wbest = w;
+      for (i = 0; i < n; i++)
+        bestpi[i] = G.pi[i];
+    }
+    if ((it + 1) % ALPHA_PERIOD == 0)
+      t /= 2.0;
+  }
+  if (connected)
+  { for (i = 0; i < n; i++)
+      G.pi[i] = bestpi[i];
+    one_tree (&G);
+  }
+  /* alpha values of the edges of G; for the current node a, beta[j] is
+     the longest edge on the tree path from a to j and is valid when
+     mark[j] == a */
+  beta = xcalloc(n, sizeof(double));
+  mark = xcalloc(n, sizeof(int));
+  stack = xcalloc(n, sizeof(int));
+  alpha = xcalloc(G.beg[n]+1, sizeof(double));
+  for (i = 0; i < n; i++)
+    mark[i] = -1;
+  for (a = 0; a < n; a++)
+  { if (!connected)
+    { for (p = G.beg[a]; p < G.beg[a+1]; p++)
+        alpha[p] = 0.0;
+      continue;
+    }
+    mark[a] = a;
+    beta[a] = -CCutil_MAXDOUBLE;
+    for (u = a; G.dad[u] >= 0; u = G.dad[u])
+    { mark[G.dad[u]] = a;
+      beta[G.dad[u]] = (beta[u] > G.dadcost[u] ? beta[u] : G.dadcost[u]);
+    }
+    for (p = G.beg[a]; p < G.beg[a+1]; p++)
+    { b = G.adj[p];
+      w = G.len[p] + G.pi[a] + G.pi[b];
+      if (a == G.special || b == G.special)
+      { u = (a == G.special ? b : a);
+        if (u == G.mate1 || u == G.mate2)
+          alpha[p] = 0.0;
+        else
+          alpha[p] = w - G.second;
+        continue;
+      }
+      /* the walk up from b stops at the lowest common ancestor */
+      top = 0;
+      for (u = b; mark[u] != a; u = G.dad[u])
+        stack[top++] = u;
+      while (top > 0)
+      { u = stack[--top];
+        mark[u] = a;
+        beta[u] = (beta[G.dad[u]] > G.dadcost[u] ? beta[G.dad[u]]
+            : G.dadcost[u]);
+      }
+      alpha[p] = w - beta[b];
+    }
+  }
+  /* keep the k edges of lowest alpha at each node, the adjacency lists
+     are sorted by length so the first minimum breaks ties */
+  nlist = xcalloc(n * k, sizeof(int));
+  ncnt = xcalloc(n, sizeof(int));
+  for (i = 0; i < n; i++)
+    mark[i] = -1;
+  for (a = 0; a < n; a++)
+  { cnt = 0;
+    while (cnt < k)
+    { best = -1;
+      for (p = G.beg[a]; p < G.beg[a+1]; p++)
+      { if (mark[G.adj[p]] != a && (best < 0 || alpha[p] < alpha[best]))
+          best = p;
+      }
+      if (best < 0)
+        break;
+      mark[G.adj[best]] = a;
+      nlist[a*k + cnt++] = G.adj[best];
+    }
+    ncnt[a] = cnt;
+  }
+  /* an edge listed by both its ends is only taken from the smaller one */
+  ecount = 0;
+  for (a = 0; a < n; a++)
+  { for (i = 0; i < ncnt[a]; i++)
+    { b = nlist[a*k + i];
+      if (a < b || !in_list(&nlist[b*k], ncnt[b], a))
+        ecount++;
+    }
+  }
+  tsp->elist = xcalloc(2*ecount+1, sizeof(int));
+  tsp->ecount = ecount;
+  q = 0;
+  for (a = 0; a < n; a++)
+  { for (i = 0; i < ncnt[a]; i++)
+    { b = nlist[a*k + i];
+      if (a < b || !in_list(&nlist[b*k], ncnt[b], a))
+      { tsp->elist[2*q] = a;
+        tsp->elist[2*q+1] = b;
+        q++;
+      }
+    }
+  }
+  if (neighcp->msg_lev >= COMPASS_MSG_ALL)
+  { if (connected)
+      xprintf (" %d edges, 1-tree bound %.2f after %d iterations\n",
+          ecount, wbest, it);
+    else
+      xprintf (" %d edges, nearest neighbors only\n", ecount);
+  }
+  xfree(bestpi);
+  xfree(vlast);
+  xfree(beta);
+  xfree(mark);
+  xfree(stack);
+  xfree(alpha);
+  xfree(nlist);
+  xfree(ncnt);
+  free_graph (&G);
+  return 0;
+}
+
+static int in_list (int *list, int cnt, int a)
+{ int i;
+  for (i = 0; i < cnt; i++)
+  { if (list[i] == a)
+      return 1;
+  }
+  return 0;
+}
+
+/* G is the kc nearest neighbor graph of prob, with each adjacency list
+ * sorted by length and without repeated edges */
+static int build_graph (compass_prob *prob, struct alpha_graph *G, int kc)
+{ int i, j, d, n = prob->n, ecount, maxdeg;
+  int *elist = (int *) NULL, *perm, *tmp, *tmplen;
+  struct compass_data *data = prob->data;
+  if ((data->norm & CC_NORM_BITS) == CC_KD_NORM_TYPE)
+  { if (prob->kdtree->root == (CCkdnode *) NULL)
+      CCkdtree_build(prob->kdtree, n, data, (double *) NULL, prob->rstate_cc);
+    if (CCkdtree_k_nearest (prob->kdtree, n, kc, data, (double *) NULL, 1,
+        &ecount, &elist, 1, prob->rstate_cc))
+    { put_err_msg("CCkdtree_k_nearest failed\n");
+      return 1;
+    }
+  }
+  else if ((data->norm & CC_NORM_BITS) == CC_X_NORM_TYPE)
+  { if (CCedgegen_x_k_nearest (n, kc, data, (double *) NULL, 1, &ecount,
+        &elist, 1))
+    { put_err_msg("CCedgegen_x_k_nearest failed\n");
+      return 1;
+    }
+  }
+  else
+  { if (CCedgegen_junk_k_nearest (n, kc, data, (double *) NULL, 1, &ecount,
+        &elist, 1))
+    { put_err_msg("CCedgegen_junk_k_nearest failed\n");
+      return 1;
+    }
+  }
+  G->n = n;
+  G->beg = xcalloc(n+1, sizeof(int));
+  G->adj = xcalloc(2*ecount+1, sizeof(int));
+  G->len = xcalloc(2*ecount+1, sizeof(int));
+  G->pi = xcalloc(n, sizeof(double));
+  G->dad = xcalloc(n, sizeof(int));
+  G->dadcost = xcalloc(n, sizeof(double));
+  G->deg = xcalloc(n, sizeof(int));
+  G->state = xcalloc(n, sizeof(int));
+  tmp = xcalloc(n, sizeof(int));
+  for (i = 0; i < n; i++)
+    tmp[i] = 0;
+  for (i = 0; i < 2*ecount; i++)
+    tmp[elist[i]]++;
+  G->beg[0] = 0;
+  maxdeg = 0;
+  for (i = 0; i < n; i++)
+  { if (tmp[i] > maxdeg)
+      maxdeg = tmp[i];
+    G->beg[i+1] = G->beg[i] + tmp[i];
+    tmp[i] = G->beg[i];
+  }
+  for (i = 0; i < ecount; i++)
+  { G->adj[tmp[elist[2*i]]++] = elist[2*i+1];
+    G->adj[tmp[elist[2*i+1]]++] = elist[2*i];
+  }
+  xfree(elist);
+  /* sort the adjacency lists, nearest first, dropping repeated edges */
+  perm = xcalloc(maxdeg+1, sizeof(int));
+  tmplen = xcalloc(maxdeg+1, sizeof(int));
+  tmp = xrealloc(tmp, maxdeg+1, sizeof(int));
+  for (i = 0; i < n; i++)
+    G->state[i] = -1;
+  d = 0;
+  for (i = 0; i < n; i++)
+  { int b = G->beg[i], e = G->beg[i+1];
+    for (j = 0; j < e - b; j++)
+    { perm[j] = j;
+      tmp[j] = G->adj[b+j];
+      tmplen[j] = CCutil_dat_edgelen(i, tmp[j], data);
+    }
+    CCutil_int_perm_quicksort(perm, tmplen, e - b);
+    G->beg[i] = d;
+    for (j = 0; j < e - b; j++)
+    { if (G->state[tmp[perm[j]]] == i)
+        continue;
+      G->state[tmp[perm[j]]] = i;
+      G->adj[d] = tmp[perm[j]];
+      G->len[d] = tmplen[perm[j]];
+      d++;
+    }
+  }
+  G->beg[n] = d;
+  xfree(perm);
+  xfree(tmplen);
+  xfree(tmp);
+  if (CCutil_dheap_init (&G->heap, n))
+  { put_err_msg("CCutil_dheap_init failed\n");
+    free_graph (G);
+    return 1;
+  }
+  return 0;
+}
+
+/* computes the minimum 1-tree of G under the weights pi: a minimum
+ * spanning tree by Prim's algorithm rooted at node 0, plus the second
+ * cheapest edge of the leaf at which it is the most expensive; returns
+ * the 1-tree bound, or -CCutil_MAXDOUBLE if G is not connected */
+static double one_tree (struct alpha_graph *G)
+{ int i, p, u, v, n = G->n, cnt;
+  double c, w, sum;
+  CCdheap *h = &G->heap;
+  for (i = 0; i < n; i++)
+  { G->state[i] = 0;
+    G->deg[i] = 0;
+  }
+  G->dad[0] = -1;
+  G->dadcost[0] = 0.0;
+  h->key[0] = 0.0;
+  CCutil_dheap_insert (h, 0);
+  G->state[0] = 1;
+  cnt = 0;
+  sum = 0.0;
+  while ((u = CCutil_dheap_deletemin (h)) != -1)
+  { G->state[u] = 2;
+    cnt++;
+    if (G->dad[u] >= 0)
+    { sum += G->dadcost[u];
+      G->deg[u]++;
+      G->deg[G->dad[u]]++;
+    }
+    for (p = G->beg[u]; p < G->beg[u+1]; p++)
+    { v = G->adj[p];
+      if (G->state[v] == 2)
+        continue;
+      c = G->len[p] + G->pi[u] + G->pi[v];
+      if (G->state[v] == 0)
+      { G->state[v] = 1;
+        G->dad[v] = u;
+        G->dadcost[v] = c;
+        h->key[v] = c;
+        CCutil_dheap_insert (h, v);
+      }
+      else if (c < G->dadcost[v])
+      { G->dad[v] = u;
+        G->dadcost[v] = c;
+        CCutil_dheap_changekey (h, v, c);
+      }
+    }
+  }
+  if (cnt < n)
+    return -CCutil_MAXDOUBLE;
+  /* special node */
+  G->special = -1;
+  G->second = -CCutil_MAXDOUBLE;
+  for (u = 0; u < n; u++)
+  { int mate = -1, m2 = -1;
+    double c2 = CCutil_MAXDOUBLE;
+    if (G->deg[u] != 1)
+      continue;
+    if (G->dad[u] >= 0)
+      mate = G->dad[u];
+    for (p = G->beg[u]; p < G->beg[u+1]; p++)
+    { v = G->adj[p];
+      if (mate < 0 && G->dad[v] == u)
+      { mate = v;
+        continue;
+      }
+      if (v == mate)
+        continue;
+      c = G->len[p] + G->pi[u] + G->pi[v];
+      if (c < c2)
+      { c2 = c;
+        m2 = v;
+      }
+    }
+    if (m2 >= 0 && c2 > G->second)
+    { G->special = u;
+      G->mate1 = mate;
+      G->mate2 = m2;
+      G->second = c2;
+    }
+  }
+  if (G->special < 0)
+    return -CCutil_MAXDOUBLE;
+  G->deg[G->special]++;
+  G->deg[G->mate2]++;
+  w = sum + G->second;
+  for (i = 0; i < n; i++)
+    w -= 2.0 * G->pi[i];
+  return w;
+}
+
+static void free_graph (struct alpha_graph *G)
+{ xfree(G->beg);
+  xfree(G->adj);
+  xfree(G->len);
+  xfree(G->pi);
+  xfree(G->dad);
+  xfree(G->dadcost);
+  xfree(G->deg);
+  xfree(G->state);
+  CCutil_dheap_free (&G->heap);
+  return;
+}
@@ -0,0 +1,271 @@
+/***********************************************************************
+*  This code is part of Compass.
+*
+*  Compass is free software: you can redistribute it and/or modify it
+*  under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  Compass is distributed in the hope that it will be useful, but WITHOUT
+*  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+*  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+*  License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with Compass. If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include "compass.h"
+#include "env.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_X86
+#include <immintrin.h>
+#endif
+
+static void batch_scalar (compass_data *data, int i, int beg, int cnt,
+    const int *list, int *len);
+static int batch_norm (compass_data *data);
+#ifdef BATCH_X86
+static void batch_avx2 (compass_data *data, int i, int beg, int cnt,
+    const int *list, int *len);
+static void batch_avx512 (compass_data *data, int i, int beg, int cnt,
+    const int *list, int *len);
+#endif
+
+/***********************************************************************
+*  NAME
+*
+*  compass_data_edgelen_list - compute lengths from a node to a list
+*
+*  SYNOPSIS
+*
+*  void compass_data_edgelen_list(compass_data *data, int i, int cnt,
+*     const int *list, int *len);
+*
+*  DESCRIPTION
+*
+*  The routine compass_data_edgelen_list stores in len[k] the length of
+*  the edge (i, list[k]) of data, k = 0, ..., cnt-1.
+*
+*  For the EUC_2D, CEIL_2D, MAN_2D, MAX_2D and ATT norms on coordinates
+*  the lengths are computed four (AVX2) or eight (AVX-512) at a time
+*  when the processor supports it, with the rounding of the edge length
+*  routines of the norm, so the results are the same. Other norms, the
+*  table of compass_data_build_table and the views of explicit matrices
+*  are read one length at a time. */
+
+void compass_data_edgelen_list (compass_data *data, int i, int cnt,
+    const int *list, int *len)
+{ if (cnt <= 0)
+    return;
+#ifdef BATCH_X86
+  if (batch_norm(data))
+  { if (__builtin_cpu_supports("avx512f"))
+    { batch_avx512(data, i, 0, cnt, list, len);
+      return;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    { batch_avx2(data, i, 0, cnt, list, len);
+      return;
+    }
+  }
+#endif
+  batch_scalar(data, i, 0, cnt, list, len);
+  return;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_data_edgelen_range - compute lengths from a node to a range
+*
+*  SYNOPSIS
+*
+*  void compass_data_edgelen_range(compass_data *data, int i, int beg,
+*     int end, int *len);
+*
+*  DESCRIPTION
+*
+*  The routine compass_data_edgelen_range stores in len[k-beg] the
+*  length of the edge (i, k) of data, k = beg, ..., end-1, like the
+*  routine compass_data_edgelen_list. */
+
+void compass_data_edgelen_range (compass_data *data, int i, int beg,
+    int end, int *len)
+{ if (end <= beg)
+    return;
+#ifdef BATCH_X86
+  if (batch_norm(data))
+  { if (__builtin_cpu_supports("avx512f"))
+    { batch_avx512(data, i, beg, end - beg, (int *) NULL, len);
+      return;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    { batch_avx2(data, i, beg, end - beg, (int *) NULL, len);
+      return;
+    }
+  }
+#endif
+  batch_scalar(data, i, beg, end - beg, (int *) NULL, len);
+  return;
+}
+
+/* len[k] is the length of (i, list[k]), or of (i, beg+k) if list is
+ * NULL, k = 0, ..., cnt-1, computed one at a time */
+static void batch_scalar (compass_data *data, int i, int beg, int cnt,
+    const int *list, int *len)
+{ int k;
+  if (list != (int *) NULL)
+  { for (k = 0; k < cnt; k++)
+      len[k] = (data->edgelen)(i, list[k], data);
+  }
+  else
+  { for (k = 0; k < cnt; k++)
+      len[k] = (data->edgelen)(i, beg + k, data);
+  }
+  return;
+}
+
+/* non-zero if data->edgelen is the coordinate routine of a norm which
+ * has vector kernels: not a matrix, a table or a view of one of them */
+static int batch_norm (compass_data *data)
+{ if (data->adj != (int **) NULL || data->ndepot
+      || data->x == (double *) NULL || data->y == (double *) NULL)
+    return 0;
+  if (data->orig != (compass_data *) NULL
+      && data->orig->adj != (int **) NULL)
+    return 0;
+  switch (data->norm)
+  { case CC_EUCLIDEAN:
+    case CC_EUCLIDEAN_CEIL:
+    case CC_MANNORM:
+    case CC_MAXNORM:
+    case CC_ATT:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+#ifdef BATCH_X86
+
+/* The kernels below follow the edge length routines of data.c operation
+ * by operation (no fused multiply-add), and convert to int by
+ * truncation like the casts there. The remaining cnt % 4 (or 8) nodes
+ * are done by batch_scalar. */
+
+__attribute__((target("avx2")))
+static void batch_avx2 (compass_data *data, int i, int beg, int cnt,
+    const int *list, int *len)
+{ int k, norm = data->norm;
+  const double *x = data->x, *y = data->y;
+  __m256d xi = _mm256_set1_pd(x[i]), yi = _mm256_set1_pd(y[i]);
+  __m256d half = _mm256_set1_pd(0.5), one = _mm256_set1_pd(1.0);
+  __m256d ten = _mm256_set1_pd(10.0), sign = _mm256_set1_pd(-0.0);
+  __m256d xj, yj, t1, t2, d;
+  for (k = 0; k + 4 <= cnt; k += 4)
+  { if (list != (int *) NULL)
+    { __m128i idx = _mm_loadu_si128((const __m128i *) (list + k));
+      xj = _mm256_i32gather_pd(x, idx, 8);
+      yj = _mm256_i32gather_pd(y, idx, 8);
+    }
+    else
+    { xj = _mm256_loadu_pd(x + beg + k);
+      yj = _mm256_loadu_pd(y + beg + k);
+    }
+    t1 = _mm256_sub_pd(xi, xj);
+    t2 = _mm256_sub_pd(yi, yj);
+    switch (norm)
+    { case CC_EUCLIDEAN:
+        d = _mm256_add_pd(_mm256_mul_pd(t1, t1), _mm256_mul_pd(t2, t2));
+        d = _mm256_add_pd(_mm256_sqrt_pd(d), half);
+        break;
+      case CC_EUCLIDEAN_CEIL:
+        d = _mm256_add_pd(_mm256_mul_pd(t1, t1), _mm256_mul_pd(t2, t2));
+        d = _mm256_ceil_pd(_mm256_sqrt_pd(d));
+        break;
+      case CC_MANNORM:
+        t1 = _mm256_andnot_pd(sign, t1);
+        t2 = _mm256_andnot_pd(sign, t2);
+        d = _mm256_add_pd(_mm256_add_pd(t1, t2), half);
+        break;
+      case CC_MAXNORM:
+        t1 = _mm256_add_pd(_mm256_andnot_pd(sign, t1), half);
+        t2 = _mm256_add_pd(_mm256_andnot_pd(sign, t2), half);
+        d = _mm256_max_pd(t1, t2);
+        break;
+      default: /* CC_ATT */
+        d = _mm256_add_pd(_mm256_mul_pd(t1, t1), _mm256_mul_pd(t2, t2));
+        d = _mm256_sqrt_pd(_mm256_div_pd(d, ten));
+        t1 = _mm256_round_pd(d, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        d = _mm256_add_pd(t1, _mm256_and_pd(one,
+            _mm256_cmp_pd(t1, d, _CMP_LT_OQ)));
+        break;
+    }
+    _mm_storeu_si128((__m128i *) (len + k), _mm256_cvttpd_epi32(d));
+  }
+  if (k < cnt)
+    batch_scalar(data, i, beg + k, cnt - k,
+        list != (int *) NULL ? list + k : (int *) NULL, len + k);
+  return;
+}
+
+__attribute__((target("avx512f"), optimize("fp-contract=off")))
+static void batch_avx512 (compass_data *data, int i, int beg, int cnt,
+    const int *list, int *len)
+{ int k, norm = data->norm;
+  const double *x = data->x, *y = data->y;
+  __m512d xi = _mm512_set1_pd(x[i]), yi = _mm512_set1_pd(y[i]);
+  __m512d half = _mm512_set1_pd(0.5), one = _mm512_set1_pd(1.0);
+  __m512d ten = _mm512_set1_pd(10.0);
+  __m512d xj, yj, t1, t2, d;
+  for (k = 0; k + 8 <= cnt; k += 8)
+  { if (list != (int *) NULL)
+    { __m256i idx = _mm256_loadu_si256((const __m256i *) (list + k));
+      xj = _mm512_i32gather_pd(idx, x, 8);
+      yj = _mm512_i32gather_pd(idx, y, 8);
+    }
+    else
+    { xj = _mm512_loadu_pd(x + beg + k);
+      yj = _mm512_loadu_pd(y + beg + k);
+    }
+    t1 = _mm512_sub_pd(xi, xj);
+    t2 = _mm512_sub_pd(yi, yj);
+    switch (norm)
+    { case CC_EUCLIDEAN:
+        d = _mm512_add_pd(_mm512_mul_pd(t1, t1), _mm512_mul_pd(t2, t2));
+        d = _mm512_add_pd(_mm512_sqrt_pd(d), half);
+        break;
+      case CC_EUCLIDEAN_CEIL:
+        d = _mm512_add_pd(_mm512_mul_pd(t1, t1), _mm512_mul_pd(t2, t2));
+        d = _mm512_roundscale_pd(_mm512_sqrt_pd(d),
+            _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+        break;
+      case CC_MANNORM:
+        t1 = _mm512_abs_pd(t1);
+        t2 = _mm512_abs_pd(t2);
+        d = _mm512_add_pd(_mm512_add_pd(t1, t2), half);
+        break;
+      case CC_MAXNORM:
+        t1 = _mm512_add_pd(_mm512_abs_pd(t1), half);
+        t2 = _mm512_add_pd(_mm512_abs_pd(t2), half);
+        d = _mm512_max_pd(t1, t2);
+        break;
+      default: /* CC_ATT */
+        d = _mm512_add_pd(_mm512_mul_pd(t1, t1), _mm512_mul_pd(t2, t2));
+        d = _mm512_sqrt_pd(_mm512_div_pd(d, ten));
+        t1 = _mm512_roundscale_pd(d, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        d = _mm512_mask_add_pd(t1, _mm512_cmp_pd_mask(t1, d, _CMP_LT_OQ),
+            t1, one);
+        break;
+    }
+    _mm256_storeu_si256((__m256i *) (len + k), _mm512_cvttpd_epi32(d));
+  }
+  if (k < cnt)
+    batch_scalar(data, i, beg + k, cnt - k,
+        list != (int *) NULL ? list + k : (int *) NULL, len + k);
+  return;
+}
+
+#endif /* BATCH_X86 */
@@ -0,0 +1,205 @@
+/***********************************************************************
+*  This code is part of Compass.
+*
+*  Compass is free software: you can redistribute it and/or modify it
+*  under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  Compass is distributed in the hope that it will be useful, but WITHOUT
+*  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+*  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+*  License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with Compass. If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include "compass.h"
+#include "env.h"
+#include <stdint.h>
+
+#define CACHE_WAYS 4
+/* entries per set; a set is CACHE_WAYS consecutive slots */
+#define CACHE_SHARDS 64
+/* the hit and miss counters are split in CACHE_SHARDS shards, each in
+ * its own 64-byte line, so that threads seldom update the same one */
+
+struct compass_cache
+{ /* distance cache shared by all threads and by the views of data */
+  compass_data *data;
+  /* data object the cache is installed on */
+  int (*edgelen) (int i, int j, struct compass_data *data);
+  /* edge length routine of data without the cache */
+  uint64_t n;
+  /* number of nodes */
+  int bits;
+  /* the pair key i*n+j, i < j, has at most bits bits */
+  int setbits;
+  /* there are 2^setbits sets */
+  uint64_t *slot;
+  /* slot[CACHE_WAYS*s..CACHE_WAYS*s+CACHE_WAYS-1] is set s; a slot is 0
+     if empty, otherwise the length in the high 32 bits and the tag of
+     the pair plus one in the low 32 bits */
+  uint64_t *count;
+  /* count[8*k] and count[8*k+1] are the hits and misses of shard k */
+};
+
+static int cache_edgelen (int i, int j, compass_data *data);
+
+/***********************************************************************
+*  NAME
+*
+*  compass_cache_create - install a distance cache on data object
+*
+*  SYNOPSIS
+*
+*  compass_cache *compass_cache_create(compass_data *data, int mb);
+*
+*  DESCRIPTION
+*
+*  The routine compass_cache_create makes data->edgelen look the edge
+*  lengths up in a cache of about mb megabytes before computing them
+*  with the edge length routine of the norm. The views of data read
+*  their lengths through it as well (see compass_view_data), so a length
+*  is computed once for all the subproblems of a run, while it stays in
+*  the cache.
+*
+*  The cache is set associative with CACHE_WAYS entries per set. Each
+*  entry holds the length and the key of its node pair in one 64-bit
+*  word, read and written atomically without locks, so it may be used
+*  by concurrent threads; two threads missing on the same pair both
+*  compute the length and store the same entry.
+*
+*  data must not be a view, and the cache must be deleted with the
+*  routine compass_cache_delete before data.
+*
+*  RETURNS
+*
+*  The routine returns a pointer to the cache, or NULL if it cannot be
+*  installed on data. */
+
+compass_cache *compass_cache_create (compass_data *data, int mb)
+{ compass_cache *cache;
+  uint64_t n = data->n, pairs, sets;
+  int bits, setbits;
+  if (data->orig != (compass_data *) NULL || data->cache != NULL
+      || n < 2 || mb < 1)
+    return NULL;
+  for (bits = 1; ((uint64_t) 1 << bits) < n * n; bits++);
+  sets = (uint64_t) mb * 1048576 / (CACHE_WAYS * sizeof(uint64_t));
+  pairs = n * (n - 1) / 2;
+  for (setbits = 0; ((uint64_t) 2 << setbits) <= sets
+      && ((uint64_t) CACHE_WAYS << setbits) < pairs; setbits++);
+  /* the tag, the key without the set bits, must fit in 31 bits */
+  if (setbits < bits - 31)
+    setbits = bits - 31;
+  cache = xmalloc(sizeof(compass_cache));
+  cache->data = data;
+  cache->edgelen = data->edgelen;
+  cache->n = n;
+  cache->bits = bits;
+  cache->setbits = setbits;
+  cache->slot = xcalloc((size_t) CACHE_WAYS << setbits, sizeof(uint64_t));
+  memset(cache->slot, 0, ((size_t) CACHE_WAYS << setbits)
+      * sizeof(uint64_t));
+  cache->count = xcalloc(8 * CACHE_SHARDS, sizeof(uint64_t));
+  memset(cache->count, 0, 8 * CACHE_SHARDS * sizeof(uint64_t));
+  data->cache = cache;
+  data->edgelen = cache_edgelen;
+  return cache;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_cache_delete - remove distance cache from data object
+*
+*  SYNOPSIS
+*
+*  void compass_cache_delete(compass_cache *cache);
+*
+*  DESCRIPTION
+*
+*  The routine compass_cache_delete restores the edge length routine of
+*  the data object the cache was installed on and frees the cache. */
+
+void compass_cache_delete (compass_cache *cache)
+{ cache->data->edgelen = cache->edgelen;
+  cache->data->cache = NULL;
+  xfree(cache->slot);
+  xfree(cache->count);
+  xfree(cache);
+  return;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_cache_stats - report distance cache usage
+*
+*  SYNOPSIS
+*
+*  void compass_cache_stats(compass_cache *cache, double *size,
+*     double *hits, double *misses);
+*
+*  DESCRIPTION
+*
+*  The routine compass_cache_stats stores in size the number of entries
+*  of the cache, and in hits and misses the number of lengths found in
+*  the cache and computed since it was created. */
+
+void compass_cache_stats (compass_cache *cache, double *size, double *hits,
+    double *misses)
+{ int k;
+  *size = (double) ((uint64_t) CACHE_WAYS << cache->setbits);
+  *hits = *misses = 0.0;
+  for (k = 0; k < CACHE_SHARDS; k++)
+  { *hits += (double) __atomic_load_n(&cache->count[8*k], __ATOMIC_RELAXED);
+    *misses += (double) __atomic_load_n(&cache->count[8*k+1],
+        __ATOMIC_RELAXED);
+  }
+  return;
+}
+
+/* the key p = i*n+j of the pair is scrambled by a bijection of the
+ * numbers of bits bits, whose low setbits bits select the set and whose
+ * other bits are the tag */
+static int cache_edgelen (int i, int j, compass_data *data)
+{ compass_cache *cache = data->cache;
+  uint64_t p, h, word, mask, tag, *set;
+  int k, way, val;
+  if (i > j)
+  { k = i; i = j; j = k;
+  }
+  if (i == j)
+    return (cache->edgelen)(i, j, data);
+  p = (uint64_t) i * cache->n + (uint64_t) j;
+  mask = ((uint64_t) 1 << cache->bits) - 1;
+  h = (p * 0x9e3779b97f4a7c15ULL) & mask;
+  h ^= h >> ((cache->bits + 1) / 2);
+  h = (h * 0xbf58476d1ce4e5b9ULL) & mask;
+  h ^= h >> ((cache->bits + 1) / 2);
+  set = cache->slot + CACHE_WAYS * (h & (((uint64_t) 1 << cache->setbits)
+      - 1));
+  tag = (h >> cache->setbits) + 1;
+  way = -1;
+  for (k = 0; k < CACHE_WAYS; k++)
+  { word = __atomic_load_n(&set[k], __ATOMIC_RELAXED);
+    if ((word & 0xffffffffULL) == tag)
+    { __atomic_fetch_add(&cache->count[8 * (h % CACHE_SHARDS)], 1,
+          __ATOMIC_RELAXED);
+      return (int) (uint32_t) (word >> 32);
+    }
+    if (word == 0 && way < 0)
+      way = k;
+  }
+  val = (cache->edgelen)(i, j, data);
+  if (way < 0)
+    way = (int) (tag % CACHE_WAYS);
+  __atomic_store_n(&set[way], ((uint64_t) (uint32_t) val << 32) | tag,
+      __ATOMIC_RELAXED);
+  __atomic_fetch_add(&cache->count[8 * (h % CACHE_SHARDS) + 1], 1,
+      __ATOMIC_RELAXED);
+  return val;
+}
@@ -3,9 +3,10 @@
 #include "machdefs.h"
 #include "util.h"
 #include "macrorus.h"
-
-static double
-    dtrunc (double);
+#include "norms.h"
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 static int
     edgelen_nonorm (int i, int j, compass_data *data),
@@ -16,11 +17,14 @@ static int
     euclid3d_edgelen (int i, int j, compass_data *data),
     geographic_edgelen (int i, int j, compass_data *data),
     geom_edgelen (int i, int j, compass_data *data),
+    geographic_node_edgelen (int i, int j, compass_data *data),
+    geom_node_edgelen (int i, int j, compass_data *data),
     att_edgelen (int i, int j, compass_data *data),
 //    dsjrand_edgelen (int i, int j, compass_data *data),
     crystal_edgelen (int i, int j, compass_data *data),
     matrix_edgelen (int i, int j, compass_data *data),
     sparse_edgelen (int i, int j, compass_data *data),
+    view_edgelen (int i, int j, compass_data *data),
 //    user_edgelen (int i, int j, compass_data *data),
 //    rhmap1_edgelen (int i, int j, compass_data *data),
 //    rhmap2_edgelen (int i, int j, compass_data *data),
@@ -87,6 +91,12 @@ static void init_data ( compass_data *data)
   data->orig_ncount = 0;
   data->depotcost = (int *) NULL;
   data->orig_names = (int *) NULL;
+  data->orig_pos = (int *) NULL;
+  data->orig = (compass_data *) NULL;
+  data->cache = (compass_cache *) NULL;
+  data->geo = (CCdata_geonode *) NULL;
+  data->map = (char *) NULL;
+  data->maplen = 0;
   return;
 }
 
@@ -139,6 +149,37 @@ void compass_erase_data(compass_data *data)
 }
 
 
+/***********************************************************************
+*  NAME
+*
+*  compass_data_mapped - test if array is in the file image of data
+*
+*  SYNOPSIS
+*
+*  int compass_data_mapped(compass_data *data, const void *p);
+*
+*  DESCRIPTION
+*
+*  The routine compass_data_mapped tells whether p points into the file
+*  mapped in memory by compass_read_prob for data, whose arrays must not
+*  be freed one by one.
+*
+*  RETURNS
+*
+*  The routine returns non-zero if p is in the file image of data. */
+
+int compass_data_mapped (compass_data *data, const void *p)
+{ return data->map != (char *) NULL && (const char *) p >= data->map
+      && (const char *) p < data->map + data->maplen;
+}
+
+/* free p, an array of data, unless it is NULL or in the file image */
+static void data_free (compass_data *data, void *p)
+{ if (p != NULL && !compass_data_mapped(data, p))
+    xfree(p);
+  return;
+}
+
 /***********************************************************************
 *  NAME
 *
@@ -154,15 +195,15 @@ void compass_erase_data(compass_data *data)
 *  frees all the memory allocated to it. */
 
 static void delete_data(compass_data *data)
-{ if (data->x != (int *) NULL) xfree (data->x);
-  if (data->y != (int *) NULL) xfree (data->y);
-  if (data->z != (int *) NULL) xfree (data->z);
+{ data_free (data, data->x);
+  data_free (data, data->y);
+  data_free (data, data->z);
 #if 0
   xfree(data->tw_opening);
   xfree(data->tw_closing);
 #endif
   if (data->adj != (int **) NULL) xfree (data->adj);
-  if (data->adjspace != (int *) NULL) xfree (data->adjspace);
+  data_free (data, data->adjspace);
   if (data->len != (int **) NULL) xfree (data->len);
   if (data->lenspace != (int *) NULL) xfree (data->lenspace);
   if (data->degree != (int *) NULL) xfree (data->degree);
@@ -172,6 +213,11 @@ static void delete_data(compass_data *data)
 #endif
   if (data->depotcost != (int *) NULL) xfree (data->depotcost);
   if (data->orig_names != (int *) NULL) xfree (data->orig_names);
+  if (data->orig_pos != (int *) NULL) xfree (data->orig_pos);
+  if (data->geo != (CCdata_geonode *) NULL) xfree (data->geo);
+#ifdef HAVE_SYS_MMAN_H
+  if (data->map != (char *) NULL) munmap (data->map, data->maplen);
+#endif
   return;
 }
 
@@ -182,6 +228,203 @@ void compass_delete_data(compass_data *data)
   return;
 }
 
+/***********************************************************************
+*  NAME
+*
+*  compass_view_data - make data object a view of a subset of nodes
+*
+*  SYNOPSIS
+*
+*  int compass_view_data(compass_data *indata, compass_data *outdata,
+*     int *selected);
+*
+*  DESCRIPTION
+*
+*  The routine compass_view_data makes outdata a view of the nodes i of
+*  indata with selected[i] != 0, taken in increasing order. Node k of the
+*  view is node orig_names[k] of indata, and orig_pos[i] is the node of
+*  the view for node i of indata (-1 if i is not selected).
+*
+*  The distance matrix of the explicit norms (or the table built by
+*  compass_data_build_table) is not copied: the edge lengths of the view
+*  are read from indata through orig_names, as they are when indata has
+*  a distance cache (see compass_cache_create). The
+*  coordinates are gathered, since the kd-tree and the neighbour graph
+*  routines index them directly.
+*
+*  The arrays of the view are sized for indata, so further calls with the
+*  same indata reuse them. indata must not be modified or deleted while
+*  outdata is a view of it.
+*
+*  RETURNS
+*
+*  The routine returns zero on success and non-zero otherwise. */
+
+int compass_view_data (compass_data *indata, compass_data *outdata,
+    int *selected)
+{ int i, k, n = indata->n;
+  xassert(indata->orig == (compass_data *) NULL);
+  if (outdata->orig != indata)
+  { compass_erase_data(outdata);
+    outdata->orig = indata;
+    outdata->orig_names = xcalloc(n, sizeof(int));
+    outdata->orig_pos = xcalloc(n, sizeof(int));
+    if (indata->x != (double *) NULL)
+      outdata->x = xcalloc(n, sizeof(double));
+    if (indata->y != (double *) NULL)
+      outdata->y = xcalloc(n, sizeof(double));
+    if (indata->z != (double *) NULL)
+      outdata->z = xcalloc(n, sizeof(double));
+  }
+  for (i = 0, k = 0; i < n; i++)
+  { if (!selected[i])
+    { outdata->orig_pos[i] = -1;
+      continue;
+    }
+    outdata->orig_names[k] = i;
+    outdata->orig_pos[i] = k;
+    if (outdata->x != (double *) NULL) outdata->x[k] = indata->x[i];
+    if (outdata->y != (double *) NULL) outdata->y[k] = indata->y[i];
+    if (outdata->z != (double *) NULL) outdata->z[k] = indata->z[i];
+    k++;
+  }
+  outdata->n = k;
+  outdata->gridsize = indata->gridsize;
+  outdata->default_len = indata->default_len;
+  if (compass_data_set_norm(outdata, indata->norm))
+    return 1;
+  if (indata->adj != (int **) NULL || indata->cache != NULL)
+    outdata->edgelen = view_edgelen;
+  return 0;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_data_permute - renumber the nodes of data object
+*
+*  SYNOPSIS
+*
+*  void compass_data_permute(compass_data *data, const int *perm);
+*
+*  DESCRIPTION
+*
+*  The routine compass_data_permute renumbers the nodes of data so that
+*  node k is the former node perm[k], k = 0, ..., n-1. The coordinates
+*  and the distance matrix (or the table of compass_data_build_table)
+*  are moved accordingly; data must not be a view nor have a distance
+*  cache. */
+
+static double *permute_coords (compass_data *data, double *x,
+    const int *perm);
+static void geo_nodes (compass_data *data);
+
+void compass_data_permute (compass_data *data, const int *perm)
+{ int i, j, k, n = data->n;
+  xassert(data->orig == (compass_data *) NULL);
+  xassert(data->cache == NULL);
+  if (data->x != (double *) NULL)
+    data->x = permute_coords(data, data->x, perm);
+  if (data->y != (double *) NULL)
+    data->y = permute_coords(data, data->y, perm);
+  if (data->z != (double *) NULL)
+    data->z = permute_coords(data, data->z, perm);
+  if (data->adj != (int **) NULL)
+  { int **adj = xcalloc(n, sizeof(int *));
+    int *adjspace = xcalloc(n * (n+1) / 2, sizeof(int));
+    for (i = 0, k = 0; i < n; i++)
+    { adj[i] = adjspace + k;
+      k += (i+1);
+    }
+    for (i = 0; i < n; i++)
+    { for (j = 0; j <= i; j++)
+        adj[i][j] = perm[i] > perm[j] ? data->adj[perm[i]][perm[j]]
+            : data->adj[perm[j]][perm[i]];
+    }
+    xfree(data->adj);
+    data_free(data, data->adjspace);
+    data->adj = adj;
+    data->adjspace = adjspace;
+  }
+  if (data->geo != (CCdata_geonode *) NULL)
+  { int (*edgelen) (int i, int j, struct compass_data *data) =
+        data->edgelen;
+    geo_nodes(data);
+    data->edgelen = edgelen;
+  }
+  return;
+}
+
+static double *permute_coords (compass_data *data, double *x,
+    const int *perm)
+{ double *y = xcalloc(data->n, sizeof(double));
+  int k;
+  for (k = 0; k < data->n; k++)
+    y[k] = x[perm[k]];
+  data_free(data, x);
+  return y;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_data_build_table - precompute the lengths of all edges
+*
+*  SYNOPSIS
+*
+*  int compass_data_build_table(compass_data *data, int nthreads);
+*
+*  DESCRIPTION
+*
+*  The routine compass_data_build_table computes the length of every
+*  edge of data, which must have a coordinate norm, and stores it in a
+*  lower triangular table laid out as the matrix of the explicit norms
+*  (data->adj). data->edgelen is then a lookup in this table. The rows
+*  are computed by nthreads threads (0 means all processors).
+*
+*  The norm of data is left unchanged, so the kd-tree and the neighbor
+*  graph routines still work on the coordinates, and the views of data
+*  read their lengths from the table (see compass_view_data).
+*
+*  RETURNS
+*
+*  The routine returns zero on success and non-zero otherwise. */
+
+static void table_row (void *info, int tid, int k)
+{ compass_data *data = info;
+  int j, *row = data->adj[k];
+  xassert(tid == tid);
+  for (j = 0; j <= k; j++)
+    row[j] = (data->edgelen)(k, j, data);
+  return;
+}
+
+int compass_data_build_table (compass_data *data, int nthreads)
+{ int i, j, n = data->n;
+  if (!(data->norm & (CC_D2_NORM_SIZE | CC_D3_NORM_SIZE))
+      || data->adj != (int **) NULL || data->orig != (compass_data *) NULL)
+  { put_err_msg("compass_data_build_table: no coordinate norm\n");
+    return 1;
+  }
+  if (n < 1 || n > DATA_TABLE_MAXN)
+  { put_err_msg("compass_data_build_table: n = %d; too many nodes\n", n);
+    return 1;
+  }
+  data->adj = xcalloc(n, sizeof(int *));
+  data->adjspace = xcalloc(n * (n+1) / 2, sizeof(int));
+  for (i = 0, j = 0; i < n; i++)
+  { data->adj[i] = data->adjspace + j;
+    j += (i+1);
+  }
+  xparallel(nthreads, n, table_row, data);
+  data->edgelen = matrix_edgelen;
+  return 0;
+}
+
+/* the GEO and GEOM norms read their lengths from data->geo when the
+ * coordinates are there, so the norm is set again once they are read
+ * or gathered */
+
 int compass_data_set_norm (compass_data *data, int norm)
 {
     switch (norm) {
@@ -247,6 +490,7 @@ int compass_data_set_norm (compass_data *data, int norm)
         return 1;
     }
     data->norm = norm;
+    geo_nodes (data);
 
 #ifdef CCUTIL_EDGELEN_FUNCTIONPTR
     OPutil_dat_edgelen = data->edgelen;
@@ -255,6 +499,51 @@ int compass_data_set_norm (compass_data *data, int norm)
     return 0;
 }
 
+/* fill data->geo for the GEO and GEOM norms, from the nodes of the full
+ * problem for a view, and use it in data->edgelen; free it otherwise */
+static void geo_nodes (compass_data *data)
+{
+    compass_data *orig = data->orig;
+    int i;
+
+    if ((data->norm != CC_GEOGRAPHIC && data->norm != CC_GEOM)
+          || data->x == (double *) NULL || data->y == (double *) NULL
+          || data->n <= 0) {
+        if (data->geo != (CCdata_geonode *) NULL) {
+            xfree (data->geo);
+            data->geo = (CCdata_geonode *) NULL;
+        }
+        return;
+    }
+    if (orig != (compass_data *) NULL && orig->geo != (CCdata_geonode *) NULL
+          && orig->norm == data->norm) {
+        /* the arrays of a view are sized for orig and kept */
+        if (data->geo == (CCdata_geonode *) NULL) {
+            data->geo = xcalloc (orig->n, sizeof (CCdata_geonode));
+        }
+        for (i = 0; i < data->n; i++) {
+            data->geo[i] = orig->geo[data->orig_names[i]];
+        }
+    } else {
+        if (data->geo != (CCdata_geonode *) NULL) {
+            xfree (data->geo);
+        }
+        data->geo = xcalloc (data->n, sizeof (CCdata_geonode));
+        for (i = 0; i < data->n; i++) {
+            if (data->norm == CC_GEOGRAPHIC) {
+                CCdata_geonode_set (&data->geo[i],
+                        CCdata_geo_radians (data->x[i]),
+                        CCdata_geo_radians (data->y[i]));
+            } else {
+                CCdata_geonode_set (&data->geo[i], M_PI * data->x[i] / 180.0,
+                        M_PI * data->y[i] / 180.0);
+            }
+        }
+    }
+    data->edgelen = (data->norm == CC_GEOGRAPHIC ? geographic_node_edgelen
+                                                 : geom_node_edgelen);
+}
+
 void compass_get_dat_norm (compass_data *data, int *norm)
 {
     (*norm) = data->norm;
@@ -289,11 +578,7 @@ static int man_edgelen (int i, int j, compass_data *data)
 
 static int euclid_edgelen (int i, int j, compass_data *data)
 {
-    double t1 = data->x[i] - data->x[j], t2 = data->y[i] - data->y[j];
-    int temp;
-
-    temp = (int) (sqrt (t1 * t1 + t2 * t2) + 0.5);
-    return temp;
+    return CCdata_euclid_len (data->x, data->y, i, j);
 }
 
 static int toroidal_edgelen (int i, int j, compass_data *data)
@@ -322,102 +607,47 @@ static int euclid3d_edgelen (int i, int j, compass_data *data)
 
 static int euclid_ceiling_edgelen (int i, int j, compass_data *data)
 {
-    double t1 = data->x[i] - data->x[j], t2 = data->y[i] - data->y[j];
-/*
-    int rd;
-    double max;
-
-    max = sqrt (t1 * t1 + t2 * t2);
-    rd = (int) max;
-    return (((max - rd) > .000000001) ? rd + 1 : rd);
-*/
-    return (int) (ceil (sqrt (t1 * t1 + t2 * t2)));
+    return CCdata_euclid_ceiling_len (data->x, data->y, i, j);
 }
 
-#define GH_PI (3.141592)
-
-
-#define GH_PI (3.141592)
-
 static int geographic_edgelen (int i, int j, compass_data *data)
 {
-    double deg, min;
-    double lati, latj, longi, longj;
-    double q1, q2, q3;
-    int dd;
-    double x1 = data->x[i], x2 = data->x[j], yy1 = data->y[i], yy2 = data->y[j];
-
-    deg = dtrunc (x1);
-    min = x1 - deg;
-    lati = GH_PI * (deg + 5.0 * min / 3.0) / 180.0;
-    deg = dtrunc (x2);
-    min = x2 - deg;
-    latj = GH_PI * (deg + 5.0 * min / 3.0) / 180.0;
-
-    deg = dtrunc (yy1);
-    min = yy1 - deg;
-    longi = GH_PI * (deg + 5.0 * min / 3.0) / 180.0;
-    deg = dtrunc (yy2);
-    min = yy2 - deg;
-    longj = GH_PI * (deg + 5.0 * min / 3.0) / 180.0;
-
-    q1 = cos (longi - longj);
-    q2 = cos (lati - latj);
-    q3 = cos (lati + latj);
-    dd = (int) (6378.388 * acos (0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3))
-                + 1.0);
-    return dd;
+    return CCdata_geographic_len (data->x, data->y, i, j);
 }
 
 static int geom_edgelen (int i, int j, compass_data *data)
 {
-    double lati, latj, longi, longj;
-    double q1, q2, q3, q4, q5;
-
-    lati = M_PI * data->x[i] / 180.0;
-    latj = M_PI * data->x[j] / 180.0;
+    return CCdata_geom_rad_len (M_PI * data->x[i] / 180.0,
+            M_PI * data->x[j] / 180.0, M_PI * data->y[i] / 180.0,
+            M_PI * data->y[j] / 180.0);
+}
 
-    longi = M_PI * data->y[i] / 180.0;
-    longj = M_PI * data->y[j] / 180.0;
+static int geographic_node_edgelen (int i, int j, compass_data *data)
+{
+    return CCdata_geographic_node_len (data->geo, i, j);
+}
 
-    q1 = cos (latj) * sin(longi - longj);
-    q3 = sin((longi - longj)/2.0);
-    q4 = cos((longi - longj)/2.0);
-    q2 = sin(lati + latj) * q3 * q3 - sin(lati - latj) * q4 * q4;
-    q5 = cos(lati - latj) * q4 * q4 - cos(lati + latj) * q3 * q3;
-    return (int) (6378388.0 * atan2(sqrt(q1*q1 + q2*q2), q5) + 1.0);
+static int geom_node_edgelen (int i, int j, compass_data *data)
+{
+    return CCdata_geom_node_len (data->geo, i, j);
 }
 
 static int att_edgelen (int i, int j, compass_data *data)
 {
-    double xd = data->x[i] - data->x[j];
-    double yd = data->y[i] - data->y[j];
-    double rij = sqrt ((xd * xd + yd * yd) / 10.0);
-    double tij = dtrunc (rij);
-    int dij;
-
-    if (tij < rij)
-        dij = (int) tij + 1;
-    else
-        dij = (int) tij;
-    return dij;
+    return CCdata_att_len (data->x, data->y, i, j);
 }
 
-static double dtrunc (double x)
-{
-    int k;
 
-    k = (int) x;
-    x = (double) k;
-    return x;
+static int matrix_edgelen (int i, int j, compass_data *data)
+{
+    return CCdata_matrix_len (data->adj, i, j);
 }
 
-static int matrix_edgelen (int i, int j, compass_data *data)
+static int view_edgelen (int i, int j, compass_data *data)
 {
-    if (i > j)
-        return (data->adj[i])[j];
-    else
-        return (data->adj[j])[i];
+    compass_data *orig = data->orig;
+
+    return (orig->edgelen)(data->orig_names[i], data->orig_names[j], orig);
 }
 
 static int sparse_edgelen (int i, int j, compass_data *data)
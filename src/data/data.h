@@ -1,6 +1,7 @@
 #ifndef DATA_H
 #define DATA_H
 
+#include <stddef.h>
 
 #undef  CCUTIL_EDGELEN_FUNCTIONPTR
 
@@ -22,9 +23,11 @@ typedef struct CCdata_rhvector {
 } CCdata_rhvector;
 
 typedef struct compass_data compass_data;
+typedef struct compass_cache compass_cache;
 typedef struct compass_file compass_file;
 typedef struct CCdata_user CCdata_user;
 typedef struct CCdata_rhvector CCdata_rhvector;
+typedef struct CCdata_geonode CCdata_geonode;
 
 struct compass_data
 {  int    (*edgelen) ( int i, int j, struct compass_data *data);
@@ -49,8 +52,62 @@ struct compass_data
     int      orig_ncount;     /* just ncount-ndepot               */
     int     *depotcost;       /* cost from each node to the depot */
     int     *orig_names;      /* the nodes names from full problem */
+    int     *orig_pos;        /* node of the view for each node of the
+                                 full problem, -1 if not in the view */
+    struct compass_data *orig; /* full problem data, if this is a view */
+    compass_cache *cache;     /* distance cache behind edgelen, if any */
+    CCdata_geonode *geo;      /* radians, sines and cosines of the nodes,
+                                 GEO and GEOM norms (see norms.h)  */
+    char    *map;             /* file image the coordinates and the
+                                 matrix may point into, unmapped with
+                                 the data (see compass_read_prob)  */
+    size_t   maplen;          /* size of map in bytes              */
 };
 
+#ifdef CCUTIL_EDGELEN_FUNCTIONPTR
+extern int (*CCutil_dat_edgelen) (int i, int j, compass_data *dat);
+#else
+int CCutil_dat_edgelen(int i, int j, compass_data *dat);
+#endif
+/* length of the edge from node i to node j */
+
+void compass_data_edgelen_list(compass_data *data, int i, int cnt,
+    const int *list, int *len);
+/* lengths of the edges from node i to list[0..cnt-1] */
+
+void compass_data_edgelen_range(compass_data *data, int i, int beg,
+    int end, int *len);
+/* lengths of the edges from node i to nodes beg..end-1 */
+
+int compass_data_set_norm(compass_data *data, int norm);
+/* set the norm of data and its edge length routine */
+
+int compass_view_data(compass_data *indata, compass_data *outdata,
+    int *selected);
+/* make outdata a view of the nodes of indata with selected[i] set */
+
+void compass_data_permute(compass_data *data, const int *perm);
+/* renumber the nodes so that node k is the former node perm[k] */
+
+int compass_data_mapped(compass_data *data, const void *p);
+/* non-zero if p points into the file image mapped for data */
+
+int compass_data_build_table(compass_data *data, int nthreads);
+/* precompute the edge lengths of data in a table */
+
+compass_cache *compass_cache_create(compass_data *data, int mb);
+/* install a distance cache of about mb megabytes on data */
+
+void compass_cache_delete(compass_cache *cache);
+/* remove the distance cache from its data object */
+
+void compass_cache_stats(compass_cache *cache, double *size, double *hits,
+    double *misses);
+/* entries, hits and misses of the distance cache */
+
+#define DATA_TABLE_MAXN  46340  /* largest n with n*(n+1)/2 an int  */
+#define DIST_CACHE_MB    64     /* default distance cache size (Mb) */
+
 #define CC_KD_NORM_TYPE    128            /* Kdtrees work      */
 #define CC_X_NORM_TYPE     256            /* Old nearest works */
 #define CC_JUNK_NORM_TYPE  512            /* Nothing works     */
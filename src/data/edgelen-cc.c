@@ -529,6 +529,9 @@ void CCutil_init_datagroup (compass_data *dat)
     dat->orig_ncount = 0;
     dat->depotcost = (int *) NULL;
     dat->orig_names = (int *) NULL;
+    dat->orig_pos = (int *) NULL;
+    dat->orig = (compass_data *) NULL;
+    dat->cache = (compass_cache *) NULL;
 }
 
 void CCutil_freedatagroup (compass_data *dat)
@@ -35,6 +35,13 @@
 /*     is used for node weights (like in Held-Karp), it can be NULL.        */
 /*     The node weights must be nonegative (for cutoffs).                   */
 /*                                                                          */
+/*  int CCkdtree_build_perm (CCkdtree *kt, int ncount, compass_data *dat,    */
+/*      double *wcoord, int *perm)                                          */
+/*    -Builds again the tree of a CCkdtree_build call, whose perm array     */
+/*     (possibly after deletions and undeletions) was saved in perm. The    */
+/*     new tree has the same cuts, buckets and perm, so the searches give   */
+/*     the same results, and no random numbers are drawn.                   */
+/*                                                                          */
 /*  void CCkdtree_free (CCkdtree *kt)                                       */
 /*    -Frees the space (including the ptrs) used by kt.                     */
 /*                                                                          */
@@ -75,9 +82,15 @@ static void
     kdtree_free_work (CCkdnode *p, CCptrworld *kdnode_world,
         CCptrworld *kdbnds_world),
     kdtree_free_world (CCptrworld *kdnode_world, CCptrworld *kdbnds_world);
+static int
+    build_tree (CCkdtree *intree, int ncount, compass_data *dat,
+        double *wcoord, int *perm, CCrandstate *rstate);
 static unsigned char
     findmaxspread (int l, int u, CCkdtree *thetree, double *datx,
            double *daty, double *datw);
+static double
+    findcutval (int l, int u, int m, CCkdtree *thetree, double *dat,
+           CCrandstate *rstate);
 static CCkdnode
     *build (int l, int u, int *depth, double *current_bnds_x,
            double *current_bnds_y, CCkdtree *thetree, double *datx,
@@ -92,6 +105,19 @@ CC_PTRWORLD_LEAKS_ROUTINE (CCkdbnds, kdbnds_check_leaks, x[0], double)
 
 int CCkdtree_build (CCkdtree *intree, int ncount, compass_data *dat,
         double *wcoord, CCrandstate *rstate)
+{
+    return build_tree (intree, ncount, dat, wcoord, (int *) NULL, rstate);
+}
+
+int CCkdtree_build_perm (CCkdtree *intree, int ncount, compass_data *dat,
+        double *wcoord, int *perm)
+{
+    return build_tree (intree, ncount, dat, wcoord, perm,
+                       (CCrandstate *) NULL);
+}
+
+static int build_tree (CCkdtree *intree, int ncount, compass_data *dat,
+        double *wcoord, int *perm, CCrandstate *rstate)
 {
     int i;
     int depth;
@@ -117,7 +143,7 @@ int CCkdtree_build (CCkdtree *intree, int ncount, compass_data *dat,
     if (!thetree->perm)
         return 1;
     for (i = 0; i < ncount; i++)
-        thetree->perm[i] = i;
+        thetree->perm[i] = (perm ? perm[i] : i);
 
     thetree->bucketptr = CC_SAFE_MALLOC (ncount, CCkdnode *);
     if (!thetree->bucketptr) {
@@ -232,8 +258,7 @@ static CCkdnode *build (int l, int u, int *depth, double *current_bnds_x,
         m = (l + u) / 2;
         switch (p->cutdim) {
         case 0:
-            CCutil_rselect (thetree->perm, l, u, m, datx, rstate);
-            p->cutval = datx[thetree->perm[m]];
+            p->cutval = findcutval (l, u, m, thetree, datx, rstate);
 
             savebnd = current_bnds_x[1];
             current_bnds_x[1] = p->cutval;
@@ -260,8 +285,7 @@ static CCkdnode *build (int l, int u, int *depth, double *current_bnds_x,
             break;
 
         case 1:
-            CCutil_rselect (thetree->perm, l, u, m, daty, rstate);
-            p->cutval = daty[thetree->perm[m]];
+            p->cutval = findcutval (l, u, m, thetree, daty, rstate);
 
             savebnd = current_bnds_y[1];
             current_bnds_y[1] = p->cutval;
@@ -287,8 +311,7 @@ static CCkdnode *build (int l, int u, int *depth, double *current_bnds_x,
 
             break;
         case 2:
-            CCutil_rselect (thetree->perm, l, u, m, datw, rstate);
-            p->cutval = datw[thetree->perm[m]];
+            p->cutval = findcutval (l, u, m, thetree, datw, rstate);
 
             p->loson = build (l, m, depth, current_bnds_x, current_bnds_y,
                               thetree, datx, daty, datw, rstate);
@@ -315,6 +338,30 @@ static CCkdnode *build (int l, int u, int *depth, double *current_bnds_x,
     return p;
 }
 
+/* Selects in perm[l..u] the m-l+1 nodes of smallest dat into perm[l..m] */
+/* and returns the cut, the largest of them. Without rstate, perm is    */
+/* that of an earlier build, already split at m, but whose perm[m] may  */
+/* have been moved by the splits of the sons, so the largest is looked  */
+/* for instead.                                                         */
+
+static double findcutval (int l, int u, int m, CCkdtree *thetree,
+        double *dat, CCrandstate *rstate)
+{
+    int i;
+    double val;
+
+    if (rstate != (CCrandstate *) NULL) {
+        CCutil_rselect (thetree->perm, l, u, m, dat, rstate);
+        return dat[thetree->perm[m]];
+    }
+    val = dat[thetree->perm[l]];
+    for (i = l + 1; i <= m; i++) {
+        if (dat[thetree->perm[i]] > val)
+            val = dat[thetree->perm[i]];
+    }
+    return val;
+}
+
 static unsigned char findmaxspread (int l, int u, CCkdtree *thetree,
         double *datx, double *daty, double *datw)
 {
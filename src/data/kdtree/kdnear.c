@@ -59,6 +59,16 @@
 /*      -kt is a pointer to a CCkdtree previously built by                  */
 /*       CCkdtree_build.                                                    */
 /*                                                                          */
+/*  int CCkdtree_node_k_nearest_mask (CCkdtree *kt, int ncount, int n,      */
+/*      int k, compass_data *dat, double *wcoord, int *list,                */
+/*      const int *mask)                                                    */
+/*    RETURNS the k nearest points to point n among the points i with       */
+/*     mask[i] != 0.                                                        */
+/*      -The tree is only read, so several threads may query it at the      */
+/*       same time with their own masks. Deleted points are still skipped.  */
+/*      -The search only prunes on distance, so it slows down when few      */
+/*       points are in the mask.                                            */
+/*                                                                          */
 /*  int CCkdtree_node_quadrant_k_nearest (CCkdtree *kt, int ncount,         */
 /*      int n, int k, compass_data *dat, double *wcoord, int *list,          */
 /*      CCrandstate *rstate)                                                */
@@ -148,7 +158,7 @@ static void
     node_k_nearest_work (CCkdtree *thetree, compass_data *dat, double *datw,
         CCkdnode *p, CCdheap *near_heap, int *heap_names, int *heap_count,
         int target, int num, shortedge *nearlist, double *worst_on_list,
-        CCkdbnds *box),
+        CCkdbnds *box, const int *mask),
     node_nearest_work (CCkdtree *thetree, compass_data *dat, double *datw,
          CCkdnode *p, int target, double *ndist, int *nnode);
 static int
@@ -160,7 +170,8 @@ static int
     q_run_it (CCkdtree *thetree, compass_data *dat, double *datw, int *llist,
          int *lcount, int *list, int target, int num, CCkdbnds *box),
     run_kdtree_node_k_nearest (CCkdtree *thetree, compass_data *dat,
-         double *datw, int *list, int target, int num, CCkdbnds *box),
+         double *datw, int *list, int target, int num, CCkdbnds *box,
+         const int *mask),
     ball_in_bounds (compass_data *dat, CCkdbnds *bnds, int n, double dist),
     fixed_radius_nearest_work (CCkdtree *thetree, CCkdnode *p,
          int (*doit_fn) (int, int, void *),
@@ -457,7 +468,7 @@ static int q_run_it (CCkdtree *thetree, compass_data *dat, double *datw,
     int i, j;
 
     if (run_kdtree_node_k_nearest (thetree, dat, datw, llist, target, num,
-                                   box))
+                                   box, (int *) NULL))
         return 1;
     for (i = 0; i < num; i++) {
         if (llist[i] != -1) {
@@ -495,14 +506,26 @@ int CCkdtree_node_k_nearest (CCkdtree *kt, int ncount, int n, int k,
 #endif
 
     rval = run_kdtree_node_k_nearest (thetree, dat, wcoord, list, n, k,
-                                      (CCkdbnds *) NULL);
+                                      (CCkdbnds *) NULL, (int *) NULL);
     if (newtree)
         CCkdtree_free (&localkt);
     return rval;
 }
 
+int CCkdtree_node_k_nearest_mask (CCkdtree *kt, int ncount, int n, int k,
+        compass_data *dat, double *wcoord, int *list, const int *mask)
+{
+    if (kt == (CCkdtree *) NULL) {
+        fprintf (stderr, "ERROR: CCkdtree_node_k_nearest_mask needs a CCkdtree\n");
+        return 1;
+    }
+    return run_kdtree_node_k_nearest (kt, dat, wcoord, list, n, k,
+                                      (CCkdbnds *) NULL, mask);
+}
+
 static int run_kdtree_node_k_nearest (CCkdtree *thetree, compass_data *dat,
-        double *datw, int *list, int target, int num, CCkdbnds *box)
+        double *datw, int *list, int target, int num, CCkdbnds *box,
+        const int *mask)
 {
     int i;
     CCkdnode *p, *lastp;
@@ -543,7 +566,7 @@ static int run_kdtree_node_k_nearest (CCkdtree *thetree, compass_data *dat,
     p = thetree->bucketptr[target];
     node_k_nearest_work (thetree, dat, datw, p, &near_heap, heap_names,
                          &heap_count, target, num, nearlist, &worst_on_list,
-                         box);
+                         box, mask);
     while (1) {
         lastp = p;
         p = p->father;
@@ -557,13 +580,13 @@ static int run_kdtree_node_k_nearest (CCkdtree *thetree, compass_data *dat,
                    if (box == (CCkdbnds *) NULL || p->cutval <= box->x[1])
                        node_k_nearest_work (thetree, dat, datw, p->hison,
                               &near_heap, heap_names, &heap_count, target,
-                              num, nearlist, &worst_on_list, box);
+                              num, nearlist, &worst_on_list, box, mask);
             } else {
                if (worst_on_list > dtrunc(-diff))
                    if (box == (CCkdbnds *) NULL || p->cutval >= box->x[0])
                        node_k_nearest_work (thetree, dat, datw, p->loson,
                               &near_heap, heap_names, &heap_count, target,
-                              num, nearlist, &worst_on_list, box);
+                              num, nearlist, &worst_on_list, box, mask);
             }
             break;
         case 1:
@@ -573,13 +596,13 @@ static int run_kdtree_node_k_nearest (CCkdtree *thetree, compass_data *dat,
                    if (box == (CCkdbnds *) NULL || p->cutval <= box->y[1])
                        node_k_nearest_work (thetree, dat, datw, p->hison,
                               &near_heap, heap_names, &heap_count, target,
-                              num, nearlist, &worst_on_list, box);
+                              num, nearlist, &worst_on_list, box, mask);
             } else {
                if (worst_on_list > dtrunc(-diff))
                    if (box == (CCkdbnds *) NULL || p->cutval >= box->y[0])
                        node_k_nearest_work (thetree, dat, datw, p->loson,
                               &near_heap, heap_names, &heap_count, target,
-                              num, nearlist, &worst_on_list, box);
+                              num, nearlist, &worst_on_list, box, mask);
             }
             break;
         case 2:
@@ -587,11 +610,11 @@ static int run_kdtree_node_k_nearest (CCkdtree *thetree, compass_data *dat,
                 if (worst_on_list > p->cutval + datw[target])
                     node_k_nearest_work (thetree, dat, datw, p->hison,
                               &near_heap, heap_names, &heap_count, target,
-                              num, nearlist, &worst_on_list, box);
+                              num, nearlist, &worst_on_list, box, mask);
             } else {
                 node_k_nearest_work (thetree, dat, datw, p->loson, &near_heap,
                               heap_names, &heap_count, target, num, nearlist,
-                              &worst_on_list, box);
+                              &worst_on_list, box, mask);
             }
             break;
         }
@@ -645,7 +668,7 @@ static int run_kdtree_node_k_nearest (CCkdtree *thetree, compass_data *dat,
 static void node_k_nearest_work (CCkdtree *thetree, compass_data *dat,
         double *datw, CCkdnode *p, CCdheap *near_heap, int *heap_names,
         int *heap_count, int target, int num, shortedge *nearlist,
-        double *worst_on_list, CCkdbnds *box)
+        double *worst_on_list, CCkdbnds *box, const int *mask)
 {
     int i, h, k;
     double val, thisx, thisdist;
@@ -653,7 +676,8 @@ static void node_k_nearest_work (CCkdtree *thetree, compass_data *dat,
     if (p->bucket) {
         if (num >= NEAR_HEAP_CUTOFF) {
             for (i = p->lopt; i <= p->hipt; i++) {
-                if (thetree->perm[i] != target) {
+                if (thetree->perm[i] != target &&
+                    (mask == (int *) NULL || mask[thetree->perm[i]])) {
                     if (box == (CCkdbnds *) NULL ||
                        (dat->x[thetree->perm[i]] >= box->x[0] &&
                         dat->x[thetree->perm[i]] <= box->x[1] &&
@@ -680,7 +704,8 @@ static void node_k_nearest_work (CCkdtree *thetree, compass_data *dat,
             }
         } else {
             for (i = p->lopt; i <= p->hipt; i++) {
-                if (thetree->perm[i] != target) {
+                if (thetree->perm[i] != target &&
+                    (mask == (int *) NULL || mask[thetree->perm[i]])) {
                     if (box == (CCkdbnds *) NULL ||
                        (dat->x[thetree->perm[i]] >= box->x[0] &&
                         dat->x[thetree->perm[i]] <= box->x[1] &&
@@ -708,22 +733,22 @@ static void node_k_nearest_work (CCkdtree *thetree, compass_data *dat,
             if (thisx < val) {
                 node_k_nearest_work (thetree, dat, datw, p->loson, near_heap,
                         heap_names, heap_count, target, num, nearlist,
-                        worst_on_list, box);
+                        worst_on_list, box, mask);
                 /* Truncation for floating point coords */
                 if (*worst_on_list > dtrunc(val - thisx))
                     if (box == (CCkdbnds *) NULL || val >= box->x[0])
                         node_k_nearest_work (thetree, dat, datw, p->hison,
                                near_heap, heap_names, heap_count, target,
-                               num, nearlist, worst_on_list, box);
+                               num, nearlist, worst_on_list, box, mask);
             } else {
                 node_k_nearest_work (thetree, dat, datw, p->hison, near_heap,
                                heap_names, heap_count, target, num, nearlist,
-                               worst_on_list, box);
+                               worst_on_list, box, mask);
                 if (*worst_on_list > dtrunc(thisx - val))
                     if (box == (CCkdbnds *) NULL || val <= box->x[1])
                         node_k_nearest_work (thetree, dat, datw, p->loson,
                                near_heap, heap_names, heap_count, target,
-                               num, nearlist, worst_on_list, box);
+                               num, nearlist, worst_on_list, box, mask);
             }
             break;
         case 1:
@@ -731,32 +756,32 @@ static void node_k_nearest_work (CCkdtree *thetree, compass_data *dat,
             if (thisx < val) {
                 node_k_nearest_work (thetree, dat, datw, p->loson, near_heap,
                                heap_names, heap_count, target, num, nearlist,
-                               worst_on_list, box);
+                               worst_on_list, box, mask);
                 if (*worst_on_list > dtrunc(val - thisx))
                     if (box == (CCkdbnds *) NULL || val >= box->y[0])
                         node_k_nearest_work (thetree, dat, datw, p->hison,
                                near_heap, heap_names, heap_count, target,
-                               num, nearlist, worst_on_list, box);
+                               num, nearlist, worst_on_list, box, mask);
             } else {
                 node_k_nearest_work (thetree, dat, datw, p->hison, near_heap,
                                heap_names, heap_count, target, num, nearlist,
-                               worst_on_list, box);
+                               worst_on_list, box, mask);
                 if (*worst_on_list > dtrunc(thisx - val))
                     if (box == (CCkdbnds *) NULL || val <= box->y[1])
                         node_k_nearest_work (thetree, dat, datw, p->loson,
                                near_heap, heap_names, heap_count, target,
-                               num, nearlist, worst_on_list, box);
+                               num, nearlist, worst_on_list, box, mask);
             }
             break;
         case 2:
             thisx = datw[target];
             node_k_nearest_work (thetree, dat, datw, p->loson, near_heap,
                                heap_names, heap_count, target, num, nearlist,
-                               worst_on_list, box);
+                               worst_on_list, box, mask);
             if (*worst_on_list > val + thisx)
                 node_k_nearest_work (thetree, dat, datw, p->hison, near_heap,
                                heap_names, heap_count, target, num, nearlist,
-                               worst_on_list, box);
+                               worst_on_list, box, mask);
             break;
         }
     }
@@ -66,6 +66,13 @@
 /*      compass_data *dat, int *outcycle, double *val, CCrandstate *rstate)  */
 /*    MISSING                                                               */
 /*                                                                          */
+/*  int CCkdtree_space_fill_order (int ncount, compass_data *dat,           */
+/*      int *outcyc)                                                        */
+/*    RETURNS the nodes in the order of the Platzman-Bartholdi space        */
+/*      filling curve through their x and y coordinates.                    */
+/*     -outcyc should point to an array of length at least ncount.          */
+/*     -Works with any norm having x and y (z is ignored).                  */
+/*                                                                          */
 /****************************************************************************/
 
 /****************************************************************************/
@@ -97,6 +104,9 @@ typedef struct faobj {
       CCutil_dat_edgelen ((n1), (n2), dat))
 
 
+#define SPACEFILL_GRID  (1 << 20)   /* integer side of the curve's square */
+#define SPACEFILL_BITS  30          /* levels of the curve (bits of keys) */
+
 static void
     add_primheap (CCdheap *prim_heap, CCkdtree *kt, int n, int *neighbor,
         compass_data *dat, double *datw),
@@ -892,22 +902,18 @@ CLEANUP:
     return rval;
 }
 
-#ifdef USE_SPACEFILL
-static int space_fill_curve (int ncount, compass_data *dat, int *outcyc,
-                             double *len)
+int CCkdtree_space_fill_order (int ncount, compass_data *dat, int *outcyc)
 {
     int i, h, M;
     int x, y, z;
     int k, nbits;
     int *th = (int *) NULL;
-    int *cyc = (int *) NULL;
-    double tx, ty, tM;
+    double tx, ty, tM, scale;
 
     /* From Platzman and Bartholdi, JACM 36 (1989) 719-737. */
 
-    if ((dat->norm & CC_NORM_SIZE_BITS) != CC_D2_NORM_SIZE) {
-        printf ("Need a 2-coordinate norm to use space filling curve\n");
-        fflush (stdout);
+    if (dat->x == (double *) NULL || dat->y == (double *) NULL) {
+        fprintf (stderr, "Need coordinates to use space filling curve\n");
         return 1;
     }
 
@@ -915,43 +921,33 @@ static int space_fill_curve (int ncount, compass_data *dat, int *outcyc,
     if (!th)
         return 1;
 
-    if (outcyc != (int *) NULL) {
-        cyc = outcyc;
-    } else {
-        cyc = CC_SAFE_MALLOC (ncount, int);
-        if (!cyc) {
-            CC_FREE (th, int);
-            return 1;
-        }
-    }
+    /* The coordinates are mapped to integers in [0, SPACEFILL_GRID], so  */
+    /* the order does not depend on their units.                          */
 
+    tx = dat->x[0];
+    ty = dat->y[0];
     tM = 0.0;
-    tx = 0.0;
-    ty = 0.0;
-
     for (i = 0; i < ncount; i++) {
-        cyc[i] = i;
+        outcyc[i] = i;
         if (dat->x[i] < tx)
             tx = dat->x[i];
-        else if (dat->x[i] > tM)
-            tM = dat->x[i];
-
         if (dat->y[i] < ty)
             ty = dat->y[i];
-        else if (dat->y[i] > tM)
-            tM = dat->y[i];
     }
+    for (i = 0; i < ncount; i++) {
+        if (dat->x[i] - tx > tM)
+            tM = dat->x[i] - tx;
+        if (dat->y[i] - ty > tM)
+            tM = dat->y[i] - ty;
+    }
+    scale = (tM > 0.0 ? SPACEFILL_GRID / tM : 1.0);
 
-    M = (int) (tM - tx - ty + 1.0);
-
-    nbits = 0;
-    while ((1 << nbits) < ncount)
-       nbits++;
-    nbits += 2;
+    M = SPACEFILL_GRID + 1;
+    nbits = SPACEFILL_BITS;
 
     for (i = 0; i < ncount; i++) {
-        x = (int) (dat->x[i] - tx);    /* To make coords nonnegative ints */
-        y = (int) (dat->y[i] - ty);
+        x = (int) ((dat->x[i] - tx) * scale);
+        y = (int) ((dat->y[i] - ty) * scale);
 
         h = 0;
         k = 1;
@@ -990,15 +986,45 @@ static int space_fill_curve (int ncount, compass_data *dat, int *outcyc,
         th[i] = h;
     }
 
-    CCutil_int_perm_quicksort (cyc, th, ncount);
+    CCutil_int_perm_quicksort (outcyc, th, ncount);
+
+    CC_FREE (th, int);
+    return 0;
+}
+
+#ifdef USE_SPACEFILL
+static int space_fill_curve (int ncount, compass_data *dat, int *outcyc,
+                             double *len)
+{
+    int i;
+    int *cyc = (int *) NULL;
+
+    if ((dat->norm & CC_NORM_SIZE_BITS) != CC_D2_NORM_SIZE) {
+        printf ("Need a 2-coordinate norm to use space filling curve\n");
+        fflush (stdout);
+        return 1;
+    }
+
+    if (outcyc != (int *) NULL) {
+        cyc = outcyc;
+    } else {
+        cyc = CC_SAFE_MALLOC (ncount, int);
+        if (!cyc)
+            return 1;
+    }
+
+    if (CCkdtree_space_fill_order (ncount, dat, cyc)) {
+        if (!outcyc)
+            CC_FREE (cyc, int);
+        return 1;
+    }
+
     *len = (double) CCutil_dat_edgelen (cyc[ncount - 1], cyc[0], dat);
     for (i = 1; i < ncount; i++)
         (*len) += CCutil_dat_edgelen (cyc[i - 1], cyc[i], dat);
     printf ("Spacefilling Curve Tour: %.2f\n", *len);
     fflush (stdout);
 
-    if (th)
-        CC_FREE (th, int);
     if (!outcyc && cyc)
         CC_FREE (cyc, int);
 
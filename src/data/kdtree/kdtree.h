@@ -58,6 +58,8 @@ void
 int
     CCkdtree_build (CCkdtree *kt, int ncount, compass_data *dat,
         double *wcoord, CCrandstate *rstate),
+    CCkdtree_build_perm (CCkdtree *kt, int ncount, compass_data *dat,
+        double *wcoord, int *perm),
     CCkdtree_k_nearest (CCkdtree *kt, int ncount, int k, compass_data *dat,
         double *wcoord, int wantlist, int *ocount, int **olist,
         int silent, CCrandstate *rstate),
@@ -66,6 +68,8 @@ int
         int **olist, int silent, CCrandstate *rstate),
     CCkdtree_node_k_nearest (CCkdtree *kt, int ncount, int n, int k,
         compass_data *dat, double *wcoord, int *list, CCrandstate *rstate),
+    CCkdtree_node_k_nearest_mask (CCkdtree *kt, int ncount, int n, int k,
+        compass_data *dat, double *wcoord, int *list, const int *mask),
     CCkdtree_node_quadrant_k_nearest (CCkdtree *kt, int ncount, int n, int k,
         compass_data *dat, double *wcoord, int *list, CCrandstate *rstate),
     CCkdtree_node_nearest (CCkdtree *kt, int n, compass_data *dat,
@@ -92,8 +96,23 @@ int
         int silent, CCrandstate *rstate),
     CCkdtree_3opt_tour (CCkdtree *kt, int ncount, compass_data *dat,
         int *incycle, int *outcycle, double *val, int silent,
+        CCrandstate *rstate),
+    CCkdtree_space_fill_order (int ncount, compass_data *dat, int *outcyc);
+
+/* CCkdtree_twoopt_tour and CCkdtree_3opt_tour compiled for one norm
+ * (kdtwoopt-<sfx>.c) */
+#define CC_KD_TWOOPT_VARIANT(sfx)                                            \
+int                                                                          \
+    CCkdtree_twoopt_tour_##sfx (CCkdtree *kt, int ncount, compass_data *dat, \
+        int *incycle, int *outcycle, double *val, int run_two_and_a_half_opt,\
+        int silent, CCrandstate *rstate),                                    \
+    CCkdtree_3opt_tour_##sfx (CCkdtree *kt, int ncount, compass_data *dat,   \
+        int *incycle, int *outcycle, double *val, int silent,                \
         CCrandstate *rstate);
 
+CC_KD_TWOOPT_VARIANT (euc)
+CC_KD_TWOOPT_VARIANT (ceil)
+
 
 #endif  /* __KDTREE_H */
 
@@ -0,0 +1,12 @@
+/****************************************************************************/
+/*                                                                          */
+/*  Kd-tree 2-opt and 3-opt compiled for the CEIL_2D norm (see             */
+/*  kdtwoopt.c).                                                            */
+/*                                                                          */
+/****************************************************************************/
+
+#define KD_NORM  ceil
+#define KD_NORM_LEN(a, b, dat)                                               \
+    CCdata_euclid_ceiling_len ((dat)->x, (dat)->y, a, b)
+
+#include "kdtwoopt.c"
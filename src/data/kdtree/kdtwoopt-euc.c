@@ -0,0 +1,10 @@
+/****************************************************************************/
+/*                                                                          */
+/*  Kd-tree 2-opt and 3-opt compiled for the EUC_2D norm (see kdtwoopt.c).  */
+/*                                                                          */
+/****************************************************************************/
+
+#define KD_NORM  euc
+#define KD_NORM_LEN(a, b, dat)  CCdata_euclid_len ((dat)->x, (dat)->y, a, b)
+
+#include "kdtwoopt.c"
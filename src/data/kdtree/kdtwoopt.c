@@ -52,6 +52,13 @@
 /*    RETURNS an approximately 3-opted tour.                                */
 /*      -kt can be NULL.                                                    */
 /*                                                                          */
+/*  int CCkdtree_twoopt_tour_<norm>, CCkdtree_3opt_tour_<norm>              */
+/*    RUN as CCkdtree_twoopt_tour and CCkdtree_3opt_tour, with the edge     */
+/*      length of one norm compiled in instead of called through            */
+/*      dat->edgelen. They are built from this file by kdtwoopt-<norm>.c,   */
+/*      which defines KD_NORM (the suffix) and KD_NORM_LEN (the length of   */
+/*      the edge (a, b) of dat).                                            */
+/*                                                                          */
 /****************************************************************************/
 
 /****************************************************************************/
@@ -66,9 +73,19 @@
 #include "machdefs.h"
 #include "util.h"
 #include "kdtree.h"
+#include "compass.h"
 #include "macrorus.h"
-
+#include "data/norms.h"
+
+#ifdef KD_NORM
+#define KD_CAT(f, sfx)   f ## _ ## sfx
+#define KD_XCAT(f, sfx)  KD_CAT (f, sfx)
+#define KD_NAME(f)       KD_XCAT (f, KD_NORM)
+#define Edgelen(a, b)  KD_NORM_LEN ((a), (b), dat)
+#else
+#define KD_NAME(f)       f
 #define Edgelen(a, b)  CCutil_dat_edgelen ((a), (b), dat)
+#endif
 #define ADD_TO_ACTIVE_QUEUE(n, ip, q) {                                    \
     if (!(q)->active[(n)]) {                                               \
         (q)->active[(n)] = 1;                                              \
@@ -162,9 +179,9 @@ static double
     cycle_length (int *cyc, int ncount, compass_data *dat);
 
 
-int CCkdtree_twoopt_tour (CCkdtree *kt, int ncount, compass_data *dat,
-        int *incycle, int *outcycle, double *val, int run_two_and_a_half_opt,
-        int silent, CCrandstate *rstate)
+int KD_NAME (CCkdtree_twoopt_tour) (CCkdtree *kt, int ncount,
+        compass_data *dat, int *incycle, int *outcycle, double *val,
+        int run_two_and_a_half_opt, int silent, CCrandstate *rstate)
 {
     CCkdtree localkt;
     int i;
@@ -322,9 +339,9 @@ static void twoopt_free_world (CCptrworld *intptr_world)
 }
 
 
-int CCkdtree_3opt_tour (CCkdtree *kt, int ncount, compass_data *dat,
-        int *incycle, int *outcycle, double *val, int silent,
-        CCrandstate *rstate)
+int KD_NAME (CCkdtree_3opt_tour) (CCkdtree *kt, int ncount,
+        compass_data *dat, int *incycle, int *outcycle, double *val,
+        int silent, CCrandstate *rstate)
 {
     CCkdtree localkt;
     int i;
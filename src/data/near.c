@@ -1,8 +1,15 @@
 #include "compass.h"
 #include "neigh.h"
+#include "xnear.h"
+#include "delaunay.h"
 #include "data/kdtree/kdtree.h"
 #include "tsp.h"
 #include "env.h"
+#include "util.h"
+
+#define NEIGH_CAND_FACTOR 2
+/* the candidate graph of the full problem keeps NEIGH_CAND_FACTOR*k
+ * neighbors per node, so that enough of them survive in a subproblem */
 
 static int call_nearest (compass_prob *prob, struct neigh_cp *neighcp);
 static int call_quadnearest (compass_prob *prob, struct neigh_cp *neighcp);
@@ -29,6 +36,12 @@ int compass_data_k_nearest (compass_prob *prob, struct neigh_cp *neighcp)
       ret = 1; goto done;
     }
     goto done;
+  case NEIGH_ALPHA:
+    if (compass_data_alpha_nearest (prob, neighcp))
+    { put_err_msg("data  :   compass_data_alpha_nearest failed.\n");
+      return 1;
+    }
+    goto done;
   default:
     put_err_msg(stderr, "data  :   invalid neigh_graph flag.\n");
     return 1;
@@ -141,10 +154,238 @@ static int call_delaunay (compass_prob *prob, struct neigh_cp *neighcp)
   return 0;
 }
 
+/***********************************************************************
+*  NAME
+*
+*  compass_data_cand_graph - build candidate graph of problem
+*
+*  SYNOPSIS
+*
+*  int compass_data_cand_graph(compass_prob *prob,
+*     struct neigh_cp *neighcp);
+*
+*  DESCRIPTION
+*
+*  The routine compass_data_cand_graph stores in prob->neighbeg and
+*  prob->neighlist the NEIGH_CAND_FACTOR*neighcp->k nearest neighbor
+*  graph of prob, each adjacency list sorted by edge length. This is the
+*  graph from which the routine compass_data_induced_k_nearest derives
+*  the neighbor graphs of the subproblems of prob.
+*
+*  RETURNS
+*
+*  The routine returns zero on success and non-zero otherwise. */
+
+int compass_data_cand_graph (compass_prob *prob, struct neigh_cp *neighcp)
+{ int i, j, d, k, n = prob->n, ecount, maxdeg;
+  int *elist = (int *) NULL, *beg, *list, *perm, *len, *tmp;
+  struct compass_data *data = prob->data;
+  k = NEIGH_CAND_FACTOR * neighcp->k;
+  if (k > n - 1)
+    k = n - 1;
+  if (neighcp->msg_lev >= COMPASS_MSG_ALL)
+    xprintf ("data  :  Generating %d-nearest candidate graph...\n", k);
+  if ((data->norm & CC_NORM_BITS) == CC_KD_NORM_TYPE)
+  { if (prob->kdtree->root == (CCkdnode *) NULL)
+      CCkdtree_build(prob->kdtree, n, data, (double *) NULL, prob->rstate_cc);
+    if (CCkdtree_k_nearest (prob->kdtree, n, k, data, (double *) NULL, 1,
+        &ecount, &elist, 1, prob->rstate_cc))
+    { put_err_msg("CCkdtree_k_nearest failed\n");
+      return 1;
+    }
+  }
+  else if ((data->norm & CC_NORM_BITS) == CC_X_NORM_TYPE)
+  { if (CCedgegen_x_k_nearest (n, k, data, (double *) NULL, 1, &ecount,
+        &elist, 1))
+    { put_err_msg("CCedgegen_x_k_nearest failed\n");
+      return 1;
+    }
+  }
+  else
+  { if (CCedgegen_junk_k_nearest (n, k, data, (double *) NULL, 1, &ecount,
+        &elist, 1))
+    { put_err_msg("CCedgegen_junk_k_nearest failed\n");
+      return 1;
+    }
+  }
+  beg = xcalloc(n+1, sizeof(int));
+  list = xcalloc(2*ecount+1, sizeof(int));
+  tmp = xcalloc(n, sizeof(int));
+  for (i = 0; i < n; i++)
+    tmp[i] = 0;
+  for (i = 0; i < 2*ecount; i++)
+    tmp[elist[i]]++;
+  beg[0] = 0;
+  maxdeg = 0;
+  for (i = 0; i < n; i++)
+  { if (tmp[i] > maxdeg)
+      maxdeg = tmp[i];
+    beg[i+1] = beg[i] + tmp[i];
+    tmp[i] = beg[i];
+  }
+  for (i = 0; i < ecount; i++)
+  { list[tmp[elist[2*i]]++] = elist[2*i+1];
+    list[tmp[elist[2*i+1]]++] = elist[2*i];
+  }
+  /* sort the adjacency lists, nearest first */
+  perm = xcalloc(maxdeg+1, sizeof(int));
+  len = xcalloc(maxdeg+1, sizeof(int));
+  for (i = 0; i < n; i++)
+  { d = beg[i+1] - beg[i];
+    for (j = 0; j < d; j++)
+    { perm[j] = j;
+      len[j] = CCutil_dat_edgelen(i, list[beg[i]+j], data);
+      tmp[j] = list[beg[i]+j];
+    }
+    CCutil_int_perm_quicksort(perm, len, d);
+    for (j = 0; j < d; j++)
+      list[beg[i]+j] = tmp[perm[j]];
+  }
+  xfree(perm);
+  xfree(len);
+  xfree(tmp);
+  xfree(elist);
+  prob->neighbeg = beg;
+  prob->neighlist = list;
+  return 0;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_data_induced_k_nearest - induce neighbor graph of subproblem
+*
+*  SYNOPSIS
+*
+*  int compass_data_induced_k_nearest(compass_prob *prob,
+*     compass_prob *subprob, struct neigh_cp *neighcp);
+*
+*  DESCRIPTION
+*
+*  The routine compass_data_induced_k_nearest stores in subprob->tsp the
+*  neighbor graph of subprob, which must have been built from prob with
+*  the routine compass_sub_prob. No spatial search is done: each node is
+*  joined to the neighcp->k nearest of its neighbors in the candidate
+*  graph of prob (see compass_data_cand_graph) which are in subprob.
+*
+*  If fewer than neighcp->k of them are in subprob, the list is topped up
+*  with the nearest nodes of subprob which are neighbors of those
+*  neighbors in the candidate graph, so at most (NEIGH_CAND_FACTOR*k)^2
+*  nodes are looked at. A node can then have fewer than k neighbors.
+*
+*  RETURNS
+*
+*  The routine returns zero on success and non-zero otherwise. */
+
+static int in_list (int *list, int cnt, int a)
+{ int i;
+  for (i = 0; i < cnt; i++)
+  { if (list[i] == a)
+      return 1;
+  }
+  return 0;
+}
+
+int compass_data_induced_k_nearest (compass_prob *prob, compass_prob *subprob,
+    struct neigh_cp *neighcp)
+{ int a, b, i, p, q, u, v, w, k, kc, ns, cnt, ncand, ecount;
+  int *beg = prob->neighbeg, *list = prob->neighlist;
+  int *nlist, *ncnt, *mark, *cand, *candlen, *perm;
+  struct compass_data *sub = subprob->data;
+  struct tsp_prob *tsp = subprob->tsp;
+  int *names = sub->orig_names, *pos = sub->orig_pos;
+  xassert(sub->orig == prob->data);
+  xassert(beg != (int *) NULL);
+  ns = subprob->n;
+  k = neighcp->k;
+  if (k > ns - 1)
+    k = ns - 1;
+  kc = NEIGH_CAND_FACTOR * neighcp->k;
+  if (neighcp->msg_lev >= COMPASS_MSG_ALL)
+    xprintf ("data  :  Inducing %d-nearest Neighbor Graph...", k);
+  tsp->ecount = 0;
+  tsp->elist = (int *) NULL;
+  if (k < 1)
+    return 0;
+  nlist = xcalloc(ns * k, sizeof(int));
+  ncnt = xcalloc(ns, sizeof(int));
+  mark = xcalloc(ns, sizeof(int));
+  cand = xcalloc(kc * kc, sizeof(int));
+  candlen = xcalloc(kc * kc, sizeof(int));
+  perm = xcalloc(kc * kc, sizeof(int));
+  for (a = 0; a < ns; a++)
+    mark[a] = -1;
+  for (a = 0; a < ns; a++)
+  { v = names[a];
+    mark[a] = a;
+    cnt = 0;
+    for (p = beg[v]; p < beg[v+1] && cnt < k; p++)
+    { b = pos[list[p]];
+      if (b >= 0 && mark[b] != a)
+      { mark[b] = a;
+        nlist[a*k + cnt++] = b;
+      }
+    }
+    if (cnt < k)
+    { /* bounded search two steps away in the candidate graph */
+      ncand = 0;
+      for (p = beg[v]; p < beg[v+1] && p < beg[v] + kc; p++)
+      { u = list[p];
+        for (q = beg[u]; q < beg[u+1] && q < beg[u] + kc; q++)
+        { w = pos[list[q]];
+          if (w >= 0 && mark[w] != a)
+          { mark[w] = a;
+            cand[ncand] = w;
+            candlen[ncand] = CCutil_dat_edgelen(a, w, sub);
+            perm[ncand] = ncand;
+            ncand++;
+          }
+        }
+      }
+      CCutil_int_perm_quicksort(perm, candlen, ncand);
+      for (i = 0; i < ncand && cnt < k; i++)
+        nlist[a*k + cnt++] = cand[perm[i]];
+    }
+    ncnt[a] = cnt;
+  }
+  /* an edge listed by both its ends is only taken from the smaller one */
+  ecount = 0;
+  for (a = 0; a < ns; a++)
+  { for (i = 0; i < ncnt[a]; i++)
+    { b = nlist[a*k + i];
+      if (a < b || !in_list(&nlist[b*k], ncnt[b], a))
+        ecount++;
+    }
+  }
+  tsp->elist = xcalloc(2*ecount+1, sizeof(int));
+  tsp->ecount = ecount;
+  ecount = 0;
+  for (a = 0; a < ns; a++)
+  { for (i = 0; i < ncnt[a]; i++)
+    { b = nlist[a*k + i];
+      if (a < b || !in_list(&nlist[b*k], ncnt[b], a))
+      { tsp->elist[2*ecount] = a;
+        tsp->elist[2*ecount+1] = b;
+        ecount++;
+      }
+    }
+  }
+  if (neighcp->msg_lev >= COMPASS_MSG_ALL)
+    xprintf (" %d edges\n", ecount);
+  xfree(nlist);
+  xfree(ncnt);
+  xfree(mark);
+  xfree(cand);
+  xfree(candlen);
+  xfree(perm);
+  return 0;
+}
+
 void compass_neigh_init_cp(struct neigh_cp *neighcp )
 { neighcp->msg_lev = COMPASS_MSG_ON;
   neighcp->tm_start = xtime();
   neighcp->neigh_graph = NEIGH_NEAREST;
   neighcp->k = 10;
+  neighcp->induced = 0;
   return;
 }
@@ -22,9 +22,44 @@ struct neigh_cp
 #define NEIGH_NEAREST 0
 #define NEIGH_QUADNEAREST 1
 #define NEIGH_DELAUNAY 2
+#define NEIGH_ALPHA 3
   /* Neighbor graph technique */
   int k;
   /* Number of k nearest */
+  int induced;
+  /* derive the neighbor graphs of subproblems from the candidate graph
+     of the full problem instead of computing them from scratch */
 };
 
+int compass_data_cand_graph(compass_prob *prob, struct neigh_cp *neighcp);
+/* build the candidate graph of prob (neighbeg, neighlist) */
+
+int compass_data_induced_k_nearest(compass_prob *prob, compass_prob *subprob,
+    struct neigh_cp *neighcp);
+/* derive the neighbor graph of subprob from the candidate graph of prob */
+
+int compass_data_alpha_nearest(compass_prob *prob, struct neigh_cp *neighcp);
+/* build the neighbor graph of the neighcp->k alpha-nearest neighbors */
+
+typedef struct compass_store compass_store;
+
+compass_store *compass_store_open(compass_prob *prob, const char *dir,
+    struct neigh_cp *neighcp);
+/* open the cache of the data derived from prob in directory dir */
+
+int compass_store_get_neigh(compass_store *store, compass_prob *prob);
+/* install the cached neighbor graph, kd-tree and candidate graph */
+
+void compass_store_put_neigh(compass_store *store, compass_prob *prob);
+/* record the neighbor graph, kd-tree and candidate graph of prob */
+
+int compass_store_get_tour(compass_store *store, compass_prob *prob);
+/* install the cached reference tour */
+
+void compass_store_put_tour(compass_store *store, compass_prob *prob);
+/* record the reference tour of prob */
+
+int compass_store_close(compass_store *store);
+/* write the cache file, if changed, and free the cache */
+
 #endif
@@ -0,0 +1,159 @@
+#ifndef NORMS_H
+#define NORMS_H
+
+#include <math.h>
+
+/* Edge lengths of the norms which the local searches can be compiled   */
+/* for (linkern-*.c, kdtwoopt-*.c). The edge length routines of data.c  */
+/* use the same functions, so the compiled variants give the same       */
+/* lengths as data->edgelen.                                            */
+
+static inline int CCdata_euclid_len (const double *x, const double *y,
+        int i, int j)
+{
+    double t1 = x[i] - x[j], t2 = y[i] - y[j];
+
+    return (int) (sqrt (t1 * t1 + t2 * t2) + 0.5);
+}
+
+static inline int CCdata_euclid_ceiling_len (const double *x,
+        const double *y, int i, int j)
+{
+    double t1 = x[i] - x[j], t2 = y[i] - y[j];
+
+    return (int) (ceil (sqrt (t1 * t1 + t2 * t2)));
+}
+
+static inline int CCdata_att_len (const double *x, const double *y,
+        int i, int j)
+{
+    double xd = x[i] - x[j];
+    double yd = y[i] - y[j];
+    double rij = sqrt ((xd * xd + yd * yd) / 10.0);
+    double tij = (double) (int) rij;
+
+    return (tij < rij ? (int) tij + 1 : (int) tij);
+}
+
+#define CCdata_GH_PI (3.141592)
+
+static inline double CCdata_geo_radians (double c)
+{
+    double deg = (double) (int) c;
+
+    return CCdata_GH_PI * (deg + 5.0 * (c - deg) / 3.0) / 180.0;
+}
+
+static inline int CCdata_geographic_rad_len (double lati, double latj,
+        double longi, double longj)
+{
+    double q1 = cos (longi - longj);
+    double q2 = cos (lati - latj);
+    double q3 = cos (lati + latj);
+
+    return (int) (6378.388 * acos (0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3))
+                  + 1.0);
+}
+
+static inline int CCdata_geographic_len (const double *x, const double *y,
+        int i, int j)
+{
+    return CCdata_geographic_rad_len (CCdata_geo_radians (x[i]),
+            CCdata_geo_radians (x[j]), CCdata_geo_radians (y[i]),
+            CCdata_geo_radians (y[j]));
+}
+
+static inline int CCdata_geom_rad_len (double lati, double latj,
+        double longi, double longj)
+{
+    double q1, q2, q3, q4, q5;
+
+    q1 = cos (latj) * sin(longi - longj);
+    q3 = sin((longi - longj)/2.0);
+    q4 = cos((longi - longj)/2.0);
+    q2 = sin(lati + latj) * q3 * q3 - sin(lati - latj) * q4 * q4;
+    q5 = cos(lati - latj) * q4 * q4 - cos(lati + latj) * q3 * q3;
+    return (int) (6378388.0 * atan2(sqrt(q1*q1 + q2*q2), q5) + 1.0);
+}
+
+/* The GEO and GEOM norms keep for each node its latitude and longitude */
+/* in radians (converted as in the length routines above) and their     */
+/* sines and cosines, so that a length only takes a few products and    */
+/* one acos (atan2). The cosines (sines) of the sums and differences    */
+/* of the angles are then off by a few units in the last place, so a    */
+/* length whose real value is within CCdata_GEO_TOL (in units of the    */
+/* norm, scaled by the conditioning of acos) of an integer is computed  */
+/* again with the formula above, and the lengths are the same.          */
+
+struct CCdata_geonode {
+    double lat, lon;          /* radians                                */
+    double sinlat, coslat;
+    double sinlon, coslon;
+    double sinhlon, coshlon;  /* of lon / 2, for the GEOM norm          */
+};
+
+#define CCdata_GEO_TOL (1e-13)
+
+static inline void CCdata_geonode_set (struct CCdata_geonode *g, double lat,
+        double lon)
+{
+    g->lat = lat;
+    g->lon = lon;
+    g->sinlat = sin (lat);
+    g->coslat = cos (lat);
+    g->sinlon = sin (lon);
+    g->coslon = cos (lon);
+    g->sinhlon = sin (lon / 2.0);
+    g->coshlon = cos (lon / 2.0);
+}
+
+static inline int CCdata_geographic_node_len (const struct CCdata_geonode *g,
+        int i, int j)
+{
+    const struct CCdata_geonode *a = g + i, *b = g + j;
+    double q1 = a->coslon * b->coslon + a->sinlon * b->sinlon;
+    double cc = a->coslat * b->coslat, ss = a->sinlat * b->sinlat;
+    double q2 = cc + ss, q3 = cc - ss;
+    double c = 0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3);
+    double s = 1.0 - c * c, v, t, tol;
+
+    if (s > 0.0) {
+        v = 6378.388 * acos (c) + 1.0;
+        t = v - floor (v);
+        tol = 1e-9 + 6378.388 * CCdata_GEO_TOL / sqrt (s);
+        if (t > tol && t < 1.0 - tol) {
+            return (int) v;
+        }
+    }
+    return CCdata_geographic_rad_len (a->lat, b->lat, a->lon, b->lon);
+}
+
+static inline int CCdata_geom_node_len (const struct CCdata_geonode *g,
+        int i, int j)
+{
+    const struct CCdata_geonode *a = g + i, *b = g + j;
+    double sdl = a->sinlon * b->coslon - a->coslon * b->sinlon;
+    double q3 = a->sinhlon * b->coshlon - a->coshlon * b->sinhlon;
+    double q4 = a->coshlon * b->coshlon + a->sinhlon * b->sinhlon;
+    double sc = a->sinlat * b->coslat, cs = a->coslat * b->sinlat;
+    double cc = a->coslat * b->coslat, ss = a->sinlat * b->sinlat;
+    double q1 = b->coslat * sdl;
+    double q2 = (sc + cs) * q3 * q3 - (sc - cs) * q4 * q4;
+    double q5 = (cc + ss) * q4 * q4 - (cc - ss) * q3 * q3;
+    double v = 6378388.0 * atan2 (sqrt (q1 * q1 + q2 * q2), q5) + 1.0;
+    double t = v - floor (v), tol = 1e-6 + 6378388.0 * CCdata_GEO_TOL;
+
+    if (t > tol && t < 1.0 - tol) {
+        return (int) v;
+    }
+    return CCdata_geom_rad_len (a->lat, b->lat, a->lon, b->lon);
+}
+
+/* adj is a lower triangular matrix as in data->adj */
+
+static inline int CCdata_matrix_len (int **adj, int i, int j)
+{
+    return (i > j ? adj[i][j] : adj[j][i]);
+}
+
+#endif  /* NORMS_H */
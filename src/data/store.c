@@ -0,0 +1,499 @@
+/***********************************************************************
+*  This code is part of Compass.
+*
+*  Compass is free software: you can redistribute it and/or modify it
+*  under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  Compass is distributed in the hope that it will be useful, but WITHOUT
+*  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+*  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+*  License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with Compass. If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include "machdefs.h"
+#include "compass.h"
+#include "neigh.h"
+#include "data/kdtree/kdtree.h"
+#include "tsp.h"
+#include "env.h"
+
+/* A cache file holds a store_header followed by the arrays it gives the
+ * sizes of, in this order: the edges of the neighbor graph, the kd-tree
+ * permutation, the candidate graph and the reference tour, as ints in
+ * the byte order of the machine which wrote it. */
+
+#define STORE_MAGIC    "COMPASSD"
+#define STORE_VERSION  1
+#define STORE_ORDER    0x01020304
+
+struct store_header
+{ char magic[8];
+  /* STORE_MAGIC */
+  int version;
+  /* STORE_VERSION */
+  int order;
+  /* STORE_ORDER, to detect a file of another byte order */
+  int n;
+  /* number of nodes */
+  int norm;
+  /* norm of the edge lengths */
+  int neigh_graph, k, induced;
+  /* parameters of the neighbor graph (see struct neigh_cp) */
+  unsigned char digest[32];
+  /* SHA256 digest of the coordinates or of the explicit matrix */
+  int ecount;
+  /* number of edges of the neighbor graph; -1 if not stored */
+  int nperm;
+  /* n if the kd-tree permutation is stored, 0 otherwise */
+  int ncand;
+  /* length of the candidate graph lists; -1 if not stored */
+  int ntour;
+  /* n if the reference tour is stored, 0 otherwise */
+  double tour_val;
+  /* length of the reference tour */
+};
+
+struct compass_store
+{ /* derived data of a problem, kept in a cache directory */
+  char *fname;
+  /* name of the cache file */
+  struct store_header h;
+  /* header of the cache file, with the sizes of the arrays below */
+  int *elist;
+  /* edges of the neighbor graph, 2*h.ecount ints */
+  int *perm;
+  /* perm array of the kd-tree, h.nperm ints */
+  int *neighbeg, *neighlist;
+  /* candidate graph, n+1 and h.ncand ints */
+  int *cycle;
+  /* reference tour, h.ntour ints */
+  int changed;
+  /* the cache file must be written */
+};
+
+static void store_digest (compass_prob *prob, unsigned char digest[32]);
+static int store_read (compass_store *store);
+static int store_write (compass_store *store);
+static int *store_copy (const int *a, int cnt);
+static void store_free (int **a);
+
+/***********************************************************************
+*  NAME
+*
+*  compass_store_open - open the cache of derived data of problem
+*
+*  SYNOPSIS
+*
+*  compass_store *compass_store_open(compass_prob *prob, const char *dir,
+*     struct neigh_cp *neighcp);
+*
+*  DESCRIPTION
+*
+*  The routine compass_store_open looks in the directory dir for the data
+*  derived from prob by earlier runs: the neighbor graph and candidate
+*  graph built with the parameters neighcp, the permutation of the kd-tree
+*  they were searched with, and the reference tour which calibrates the
+*  initial OP solutions. These only depend on the nodes, so the runs which
+*  solve the same problem with other settings do not build them again.
+*
+*  The cache file is named after the hash of prob, the parameters neighcp
+*  and the norm, and whether the nodes were renumbered (see the routine
+*  compass_spacefill_prob). It also holds a digest of the coordinates or
+*  of the explicit matrix, and is ignored if they are not those of prob.
+*
+*  The data are installed with the routines compass_store_get_neigh and
+*  compass_store_get_tour, and the ones computed instead are recorded with
+*  compass_store_put_neigh and compass_store_put_tour, to be written by
+*  compass_store_close.
+*
+*  RETURNS
+*
+*  The routine returns a pointer to the cache, which is empty if no valid
+*  cache file was found. */
+
+compass_store *compass_store_open (compass_prob *prob, const char *dir,
+    struct neigh_cp *neighcp)
+{ compass_store *store;
+  char hex[2*32+1];
+  int i;
+  store = xmalloc(sizeof(compass_store));
+  memset(store, 0, sizeof(compass_store));
+  for (i = 0; i < 32; i++)
+    sprintf(hex + 2*i, "%02x", prob->hash[i]);
+  store->fname = xmalloc(strlen(dir) + sizeof(hex) + 64);
+  sprintf(store->fname, "%s/%s-g%d-k%d-n%d%s%s.cache", dir, hex,
+      neighcp->neigh_graph, neighcp->k, prob->data->norm,
+      neighcp->induced ? "-i" : "",
+      prob->node_id != (int *) NULL ? "-r" : "");
+  memcpy(store->h.magic, STORE_MAGIC, sizeof(store->h.magic));
+  store->h.version = STORE_VERSION;
+  store->h.order = STORE_ORDER;
+  store->h.n = prob->n;
+  store->h.norm = prob->data->norm;
+  store->h.neigh_graph = neighcp->neigh_graph;
+  store->h.k = neighcp->k;
+  store->h.induced = neighcp->induced;
+  store_digest(prob, store->h.digest);
+  store->h.ecount = -1;
+  store->h.ncand = -1;
+  if (store_read(store) == 0)
+  { xprintf("Reading derived data from '%s'...\n", store->fname);
+    if (store->h.ecount >= 0)
+      xprintf("  Neighbor graph: %d edges\n", store->h.ecount);
+    if (store->h.ntour > 0)
+      xprintf("  Reference tour: %.0f\n", store->h.tour_val);
+  }
+  return store;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_store_get_neigh - install cached neighbor graph
+*
+*  SYNOPSIS
+*
+*  int compass_store_get_neigh(compass_store *store, compass_prob *prob);
+*
+*  DESCRIPTION
+*
+*  The routine compass_store_get_neigh stores in prob the neighbor graph
+*  (prob->tsp), the kd-tree and the candidate graph of the cache, as left
+*  by the routines compass_data_k_nearest and compass_data_cand_graph in
+*  the run which wrote it. The kd-tree is built again from its saved
+*  permutation (see CCkdtree_build_perm), so it has the same cuts, and no
+*  random numbers are drawn.
+*
+*  RETURNS
+*
+*  The routine returns non-zero if the graphs were installed, and zero if
+*  they are not in the cache. */
+
+int compass_store_get_neigh (compass_store *store, compass_prob *prob)
+{ struct tsp_prob *tsp = prob->tsp;
+  int n = prob->n;
+  if (store->h.ecount < 0)
+    return 0;
+  if (store->h.nperm > 0)
+  { if (prob->kdtree->root != (CCkdnode *) NULL)
+      CCkdtree_free(prob->kdtree);
+    if (CCkdtree_build_perm(prob->kdtree, n, prob->data, (double *) NULL,
+        store->perm))
+    { prob->kdtree->root = (CCkdnode *) NULL;
+      return 0;
+    }
+  }
+  tsp->ecount = store->h.ecount;
+  tsp->elist = store_copy(store->elist, 2*store->h.ecount);
+  if (store->h.ncand >= 0)
+  { prob->neighbeg = store_copy(store->neighbeg, n+1);
+    prob->neighlist = store_copy(store->neighlist, store->h.ncand);
+  }
+  return 1;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_store_put_neigh - record neighbor graph in cache
+*
+*  SYNOPSIS
+*
+*  void compass_store_put_neigh(compass_store *store, compass_prob *prob);
+*
+*  DESCRIPTION
+*
+*  The routine compass_store_put_neigh records in the cache the neighbor
+*  graph, the kd-tree permutation and the candidate graph (if built) of
+*  prob, just computed. */
+
+void compass_store_put_neigh (compass_store *store, compass_prob *prob)
+{ struct tsp_prob *tsp = prob->tsp;
+  int n = prob->n;
+  if (tsp->ecount < 0 || (tsp->ecount > 0 && tsp->elist == (int *) NULL))
+    return;
+  store_free(&store->elist);
+  store_free(&store->perm);
+  store_free(&store->neighbeg);
+  store_free(&store->neighlist);
+  store->h.ecount = tsp->ecount;
+  store->elist = store_copy(tsp->elist, 2*tsp->ecount);
+  store->h.nperm = 0;
+  if (prob->kdtree->root != (CCkdnode *) NULL)
+  { store->h.nperm = n;
+    store->perm = store_copy(prob->kdtree->perm, n);
+  }
+  store->h.ncand = -1;
+  if (prob->neighbeg != (int *) NULL)
+  { store->h.ncand = prob->neighbeg[n];
+    store->neighbeg = store_copy(prob->neighbeg, n+1);
+    store->neighlist = store_copy(prob->neighlist, store->h.ncand);
+  }
+  store->changed = 1;
+  return;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_store_get_tour - install cached reference tour
+*
+*  SYNOPSIS
+*
+*  int compass_store_get_tour(compass_store *store, compass_prob *prob);
+*
+*  DESCRIPTION
+*
+*  The routine compass_store_get_tour stores in prob->tsp->sol the tour of
+*  the cache, found by the run which wrote it.
+*
+*  RETURNS
+*
+*  The routine returns non-zero if the tour was installed, and zero if it
+*  is not in the cache. */
+
+int compass_store_get_tour (compass_store *store, compass_prob *prob)
+{ struct tsp_prob *tsp = prob->tsp;
+  if (store->h.ntour == 0)
+    return 0;
+  memcpy(tsp->sol->cycle, store->cycle, prob->n * sizeof(int));
+  tsp->sol->val = store->h.tour_val;
+  tsp->sol_stat = COMPASS_FEAS;
+  return 1;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_store_put_tour - record reference tour in cache
+*
+*  SYNOPSIS
+*
+*  void compass_store_put_tour(compass_store *store, compass_prob *prob);
+*
+*  DESCRIPTION
+*
+*  The routine compass_store_put_tour records in the cache the tour of
+*  prob->tsp->sol, if one was found. */
+
+void compass_store_put_tour (compass_store *store, compass_prob *prob)
+{ struct tsp_prob *tsp = prob->tsp;
+  if (tsp->sol->val >= 1e30)
+    return;
+  store_free(&store->cycle);
+  store->h.ntour = prob->n;
+  store->h.tour_val = tsp->sol->val;
+  store->cycle = store_copy(tsp->sol->cycle, prob->n);
+  store->changed = 1;
+  return;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_store_close - write and free the cache of derived data
+*
+*  SYNOPSIS
+*
+*  int compass_store_close(compass_store *store);
+*
+*  DESCRIPTION
+*
+*  The routine compass_store_close writes the cache file, if data were
+*  recorded in store, and frees store. The file is written under another
+*  name and then renamed, so that the runs sharing the directory never
+*  read a partial file.
+*
+*  RETURNS
+*
+*  The routine returns zero on success and non-zero if the cache file
+*  could not be written. */
+
+int compass_store_close (compass_store *store)
+{ int ret = 0;
+  if (store->changed)
+  { xprintf("Writing derived data to '%s'...\n", store->fname);
+    ret = store_write(store);
+    if (ret != 0)
+      xprintf("Unable to write '%s' - %s\n", store->fname, get_err_msg());
+  }
+  store_free(&store->elist);
+  store_free(&store->perm);
+  store_free(&store->neighbeg);
+  store_free(&store->neighlist);
+  store_free(&store->cycle);
+  xfree(store->fname);
+  xfree(store);
+  return ret;
+}
+
+/* the digest of the node data of prob: the coordinates, or the matrix of
+ * an explicit norm */
+static void store_digest (compass_prob *prob, unsigned char digest[32])
+{ compass_data *data = prob->data;
+  SHA256_CTX ctx;
+  size_t n = (size_t) data->n;
+  SHA256_Init(&ctx);
+  SHA256_Update(&ctx, &data->n, sizeof(int));
+  SHA256_Update(&ctx, &data->norm, sizeof(int));
+  if (data->x != (double *) NULL)
+    SHA256_Update(&ctx, data->x, n * sizeof(double));
+  if (data->y != (double *) NULL)
+    SHA256_Update(&ctx, data->y, n * sizeof(double));
+  if (data->z != (double *) NULL)
+    SHA256_Update(&ctx, data->z, n * sizeof(double));
+  if ((data->norm & CC_NORM_SIZE_BITS) == CC_MATRIX_NORM_SIZE
+      && data->adjspace != (int *) NULL)
+    SHA256_Update(&ctx, data->adjspace, n * (n + 1) / 2 * sizeof(int));
+  SHA256_Final(digest, &ctx);
+  return;
+}
+
+/* read (write) the size bytes of p in pieces an int can count */
+static int store_get (compass_file *fp, void *p, size_t size)
+{ size_t k;
+  int cnt;
+  for (k = 0; k < size; k += cnt)
+  { cnt = size - k < 1073741824 ? (int) (size - k) : 1073741824;
+    if (compass_read(fp, (char *) p + k, cnt) != cnt)
+      return 1;
+  }
+  return 0;
+}
+
+static int store_put (compass_file *fp, const void *p, size_t size)
+{ size_t k;
+  int cnt;
+  for (k = 0; k < size; k += cnt)
+  { cnt = size - k < 1073741824 ? (int) (size - k) : 1073741824;
+    if (compass_write(fp, (const char *) p + k, cnt) < 0)
+      return 1;
+  }
+  return 0;
+}
+
+/* read the cache file into store, if it is there and matches its header;
+ * return non-zero and leave store empty otherwise */
+static int store_read (compass_store *store)
+{ struct store_header h;
+  compass_file *fp;
+  size_t n = (size_t) store->h.n;
+  int ret = 1;
+  fp = compass_open(store->fname, "rb");
+  if (fp == NULL)
+    return 1;
+  if (store_get(fp, &h, sizeof(h)))
+    goto done;
+  if (memcmp(&h, &store->h, offsetof(struct store_header, ecount)) != 0)
+  { xprintf("Cache file '%s' ignored - not of this problem\n",
+        store->fname);
+    goto done;
+  }
+  if (h.ecount < -1 || (h.nperm != 0 && h.nperm != h.n) || h.ncand < -1
+      || (h.ntour != 0 && h.ntour != h.n))
+    goto bad;
+  if (h.ecount >= 0)
+  { store->elist = xcalloc(2*h.ecount+1, sizeof(int));
+    if (store_get(fp, store->elist, 2 * (size_t) h.ecount * sizeof(int)))
+      goto bad;
+  }
+  if (h.nperm > 0)
+  { store->perm = xcalloc(h.nperm, sizeof(int));
+    if (store_get(fp, store->perm, n * sizeof(int)))
+      goto bad;
+  }
+  if (h.ncand >= 0)
+  { store->neighbeg = xcalloc(h.n+1, sizeof(int));
+    store->neighlist = xcalloc(h.ncand+1, sizeof(int));
+    if (store_get(fp, store->neighbeg, (n + 1) * sizeof(int))
+        || store_get(fp, store->neighlist, (size_t) h.ncand * sizeof(int))
+        || store->neighbeg[h.n] != h.ncand)
+      goto bad;
+  }
+  if (h.ntour > 0)
+  { store->cycle = xcalloc(h.ntour, sizeof(int));
+    if (store_get(fp, store->cycle, n * sizeof(int)))
+      goto bad;
+  }
+  store->h = h;
+  ret = 0;
+  goto done;
+bad:
+  xprintf("Cache file '%s' ignored - truncated or invalid\n",
+      store->fname);
+  store_free(&store->elist);
+  store_free(&store->perm);
+  store_free(&store->neighbeg);
+  store_free(&store->neighlist);
+  store_free(&store->cycle);
+done:
+  compass_close(fp);
+  return ret;
+}
+
+static int store_write (compass_store *store)
+{ compass_file *fp;
+  char *tmp, *dir, *p;
+  size_t n = (size_t) store->h.n;
+  int ret = 1;
+  /* create the cache directory, if it is not there */
+  dir = xmalloc(strlen(store->fname) + 1);
+  strcpy(dir, store->fname);
+  p = strrchr(dir, '/');
+  *p = '\0';
+  if (dir[0] != '\0')
+    mkdir(dir, 0777);
+  xfree(dir);
+  tmp = xmalloc(strlen(store->fname) + 32);
+  sprintf(tmp, "%s.%d.tmp", store->fname, (int) getpid());
+  fp = compass_open(tmp, "wb");
+  if (fp == NULL)
+    goto done;
+  if (store_put(fp, &store->h, sizeof(store->h))
+      || (store->h.ecount >= 0 && store_put(fp, store->elist,
+         2 * (size_t) store->h.ecount * sizeof(int)))
+      || (store->h.nperm > 0 && store_put(fp, store->perm,
+         n * sizeof(int)))
+      || (store->h.ncand >= 0 && (store_put(fp, store->neighbeg,
+         (n + 1) * sizeof(int)) || store_put(fp, store->neighlist,
+         (size_t) store->h.ncand * sizeof(int))))
+      || (store->h.ntour > 0 && store_put(fp, store->cycle,
+         n * sizeof(int))))
+  { compass_close(fp);
+    goto fail;
+  }
+  if (compass_close(fp) != 0)
+    goto fail;
+  if (rename(tmp, store->fname) != 0)
+  { put_err_msg(strerror(errno));
+    goto fail;
+  }
+  store->changed = 0;
+  ret = 0;
+  goto done;
+fail:
+  remove(tmp);
+done:
+  xfree(tmp);
+  return ret;
+}
+
+/* a copy of the cnt ints of a */
+static int *store_copy (const int *a, int cnt)
+{ int *b = xcalloc(cnt+1, sizeof(int));
+  memcpy(b, a, (size_t) cnt * sizeof(int));
+  return b;
+}
+
+/* free *a, if any */
+static void store_free (int **a)
+{ if (*a != (int *) NULL)
+    xfree(*a);
+  *a = (int *) NULL;
+  return;
+}
@@ -133,6 +133,7 @@
 #include "compass.h"
 #include "machdefs.h"
 #include "neigh.h"
+#include "xnear.h"
 #include "env.h"
 #include "util.h"
 #include "macrorus.h"
@@ -162,6 +163,8 @@ static void
         int nearnum, int *nodenames),
     insert (int n, int m, shortedge *nearlist, compass_data *dat,
         double *wcoord),
+    insert_len (int n, int m, int thisdist, shortedge *nearlist,
+        double *wcoord),
     x_quicksort (int *list, double *x, int l, int u);
 static int
     run_x_k_nearest (int ncount, int num, compass_data *dat, double *wcoord,
@@ -603,10 +606,13 @@ int CCedgegen_x_node_nearest (CCxnear *xn, int ncount, int ni, char *marks)
 static void insert (int n, int m, shortedge *nearlist, compass_data *dat,
                     double *wcoord)
 {
-    int i;
-    int thisdist;
+    insert_len (n, m, CCutil_dat_edgelen (n, m, dat), nearlist, wcoord);
+}
 
-    thisdist = CCutil_dat_edgelen  ( n, m, dat);
+static void insert_len (int n, int m, int thisdist, shortedge *nearlist,
+                        double *wcoord)
+{
+    int i;
 
     if (wcoord != (double *) NULL)
         thisdist += (wcoord[n] + wcoord[m]);
@@ -625,6 +631,7 @@ int CCedgegen_junk_node_k_nearest (compass_data *dat, double *wcoord, int n,
         int nearnum, int ncount, int *list)
 {
     int i, j, ntotal;
+    int *len = (int *) NULL;
     shortedge *nearlist = (shortedge *) NULL;
 
     nearlist = xalloc (nearnum + 1, sizeof(shortedge));
@@ -634,12 +641,15 @@ int CCedgegen_junk_node_k_nearest (compass_data *dat, double *wcoord, int n,
         nearlist[i].length = BIGDOUBLE;
     nearlist[nearnum].length = -BIGDOUBLE;
 
+    len = xalloc (ncount, sizeof(int));
+    compass_data_edgelen_range (dat, n, 0, ncount, len);
     for (j = n - 1; j >= 0; j--) {
-        insert (n, j, nearlist, dat, wcoord);
+        insert_len (n, j, len[j], nearlist, wcoord);
     }
     for (j = n + 1; j < ncount; j++) {
-        insert (n, j, nearlist, dat, wcoord);
+        insert_len (n, j, len[j], nearlist, wcoord);
     }
+    xfree (len);
 
     ntotal = 0;
     for (i = 0; i < nearnum; i++) {
@@ -0,0 +1,55 @@
+/****************************************************************************/
+/*                                                                          */
+/*  This file is part of CONCORDE                                           */
+/*                                                                          */
+/*  (c) Copyright 1995--1999 by David Applegate, Robert Bixby,              */
+/*  Vasek Chvatal, and William Cook                                         */
+/*                                                                          */
+/*  Permission is granted for academic research use.  For other uses,       */
+/*  contact the authors for licensing options.                              */
+/*                                                                          */
+/*  Use at your own risk.  We make no guarantees about the                  */
+/*  correctness or usefulness of this code.                                 */
+/*                                                                          */
+/****************************************************************************/
+
+#ifndef __XNEAR_H
+#define __XNEAR_H
+
+#include "neigh.h"
+
+int
+    CCedgegen_x_k_nearest (int ncount, int num, compass_data *dat,
+        double *wcoord, int wantlist, int *ecount, int **elist, int silent),
+    CCedgegen_x_quadrant_k_nearest (int ncount, int num, compass_data *dat,
+        double *wcoord, int wantlist, int *ecount, int **elist, int silent),
+    CCedgegen_junk_k_nearest (int ncount, int num, compass_data *dat,
+        double *wcoord, int wantlist, int *ecount, int **elist, int silent),
+    CCedgegen_x_node_quadrant_k_nearest (CCxnear *xn, int ni, int nearnum,
+        int ncount, int *list),
+    CCedgegen_x_node_k_nearest (CCxnear *xn, int ni, int nearnum, int ncount,
+        int *list),
+    CCedgegen_x_node_nearest (CCxnear *xn, int ncount, int ni, char *marks),
+    CCedgegen_junk_node_k_nearest (compass_data *dat, double *wcoord, int n,
+        int nearnum, int ncount, int *list),
+    CCedgegen_junk_node_nearest (compass_data *dat, double *wcoord, int ncount,
+        int n, char *marks),
+    CCedgegen_x_nearest_neighbor_tour (int ncount, int start,
+        compass_data *dat, int *outcycle, double *val),
+    CCedgegen_x_greedy_tour (int ncount, compass_data *dat, int *outcycle,
+        double *val, int ecount, int *elist, int silent),
+    CCedgegen_x_qboruvka_tour (int ncount, compass_data *dat, int *outcycle,
+        double *val, int ecount, int *elist, int silent),
+    CCedgegen_junk_nearest_neighbor_tour (int ncount, int start,
+        compass_data *dat, int *outcycle, double *val, int silent),
+    CCedgegen_junk_greedy_tour (int ncount, compass_data *dat, int *outcycle,
+        double *val, int ecount, int *elist, int silent),
+    CCedgegen_junk_qboruvka_tour (int ncount, compass_data *dat,
+        int *outcycle, double *val, int ecount, int *elist, int silent),
+    CCedgegen_xnear_build (int ncount, compass_data *dat, double *wcoord,
+        CCxnear *xn);
+
+void
+    CCedgegen_xnear_free (CCxnear *xn);
+
+#endif
@@ -40,6 +40,8 @@
 static void *dma(const char *func, void *ptr, size_t size)
 {     ENV *env = get_env_ptr();
       MBD *mbd;
+      /* the block list is shared by all threads */
+      xlock();
       if (ptr == NULL)
       {  /* new memory block will be allocated */
          mbd = NULL;
@@ -68,6 +70,7 @@ static void *dma(const char *func, void *ptr, size_t size)
          env->mem_total -= mbd->size;
          if (size == 0)
          {  /* free the memory block */
+            xunlock();
             free(mbd);
             return NULL;
          }
@@ -99,6 +102,7 @@ static void *dma(const char *func, void *ptr, size_t size)
       env->mem_total += size;
       if (env->mem_tpeak < env->mem_total)
          env->mem_tpeak = env->mem_total;
+      xunlock();
       return (char *)mbd + MBD_SIZE;
 }
 
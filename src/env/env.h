@@ -251,6 +251,22 @@ void *xdlsym(void *h, const char *symbol);
 void xdlclose(void *h);
 /* close dynamically linked library */
 
+#define xlock compass_lock
+void compass_lock(void);
+/* acquire environment lock */
+
+#define xunlock compass_unlock
+void compass_unlock(void);
+/* release environment lock */
+
+int compass_ncpus(void);
+/* determine number of processors */
+
+#define xparallel compass_parallel
+int compass_parallel(int nthreads, int count,
+      void (*func)(void *info, int tid, int k), void *info);
+/* run parallel loop */
+
 #endif
 
 /* eof */
@@ -33,6 +33,7 @@
 
 void compass_puts(const char *s)
 {     ENV *env = get_env_ptr();
+      xlock();
       /* if terminal output is disabled, do nothing */
       if (!env->term_out)
          goto skip;
@@ -49,7 +50,8 @@ void compass_puts(const char *s)
       {  fputs(s, env->tee_file);
          fflush(env->tee_file);
       }
-skip: return;
+skip: xunlock();
+      return;
 }
 
 /***********************************************************************
@@ -69,6 +71,7 @@ skip: return;
 void compass_printf(const char *fmt, ...)
 {     ENV *env = get_env_ptr();
       va_list arg;
+      xlock();
       /* if terminal output is disabled, do nothing */
       if (!env->term_out)
          goto skip;
@@ -80,7 +83,8 @@ void compass_printf(const char *fmt, ...)
       va_end(arg);
       /* write the formatted output on the terminal */
       compass_puts(env->term_buf);
-skip: return;
+skip: xunlock();
+      return;
 }
 
 /***********************************************************************
@@ -100,6 +104,7 @@ skip: return;
 
 void compass_vprintf(const char *fmt, va_list arg)
 {     ENV *env = get_env_ptr();
+      xlock();
       /* if terminal output is disabled, do nothing */
       if (!env->term_out)
          goto skip;
@@ -109,7 +114,8 @@ void compass_vprintf(const char *fmt, va_list arg)
       assert(strlen(env->term_buf) < TBUF_SIZE);
       /* write the formatted output on the terminal */
       compass_puts(env->term_buf);
-skip: return;
+skip: xunlock();
+      return;
 }
 
 /***********************************************************************
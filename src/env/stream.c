@@ -15,8 +15,16 @@
 *  along with Compass. If not, see <http://www.gnu.org/licenses/>.
 ***********************************************************************/
 
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
 #include "env.h"
 #include "zlib.h"
+#include <pthread.h>
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
 
 struct compass_file
 {     /* sequential stream descriptor */
@@ -36,10 +44,68 @@ struct compass_file
 #define IOWRT  0x08 /* output stream */
 #define IOEOF  0x10 /* end of file */
 #define IOERR  0x20 /* input/output error */
+#define IOZSTD 0x40 /* zstd compressed file */
+#define IOPIPE 0x80 /* input decompressed by a thread */
+      void *file;
+      /* pointer to underlying control object; the decompression pipe
+         for compressed input */
+};
+
+/* A compressed file is read by a decompression thread, which fills the
+ * blocks of a pipe in turn while the stream reads the previous ones, so
+ * that the decompression overlaps the parsing of the data. */
+
+#define PIPE_NUM  4
+/* number of blocks of the pipe */
+#define PIPE_SIZE 1048576
+/* size of a block, in bytes */
+
+struct pipe
+{     /* decompression pipe of a compressed input stream */
+      int flag;
+      /* IOGZIP or IOZSTD */
       void *file;
-      /* pointer to underlying control object */
+      /* gzFile of a gzipped file; FILE of a zstd compressed file */
+#ifdef HAVE_LIBZSTD
+      ZSTD_DStream *zds;
+      /* zstd decompression context */
+      ZSTD_inBuffer in;
+      /* compressed data read from the file and not decompressed yet */
+      size_t in_size;
+      /* size of the buffer in.src */
+      size_t zret;
+      /* value of the last call to ZSTD_decompressStream which consumed
+         or produced data; zero at the end of a frame */
+#endif
+      char *blk[PIPE_NUM];
+      /* blocks of decompressed data */
+      int len[PIPE_NUM];
+      /* number of bytes in the blocks */
+      int head;
+      /* next block to be filled by the thread */
+      int tail;
+      /* next block to be read by the stream */
+      int count;
+      /* number of filled blocks not yet released by the stream */
+      int busy;
+      /* the stream reads block tail, which is not released yet */
+      int done;
+      /* the thread has stopped (end of file, error or stop) */
+      int stop;
+      /* the stream is closed; the thread must stop */
+      char msg[256];
+      /* error message, if the thread stopped on an error */
+      pthread_t thread;
+      pthread_mutex_t mutex;
+      pthread_cond_t cond;
+      /* signalled when a block is filled or released, or the thread
+         stops */
 };
 
+static struct pipe *pipe_open(const char *name, int flag);
+static int pipe_read(struct pipe *p, char **ptr);
+static int pipe_close(struct pipe *p);
+
 /***********************************************************************
 *  NAME
 *
@@ -64,7 +130,10 @@ struct compass_file
 *
 *  If the specified filename is ended with ".gz", it is assumed that
 *  the file is in gzipped format. In this case the file is compressed
-*  or decompressed by the I/O routines "on the fly".
+*  or decompressed by the I/O routines "on the fly". An input file ended
+*  with ".zst" is likewise decompressed as zstd, if the library was built
+*  with it, and cannot be opened otherwise. A compressed input file is
+*  decompressed by a thread, ahead of the reads of the stream.
 *
 *  The parameter mode points to a string, which indicates the open mode
 *  and should be one of the following:
@@ -113,14 +182,29 @@ compass_file *compass_open(const char *name, const char *mode)
       }
       else
       {  char *ext = strrchr(name, '.');
-         if (ext == NULL || strcmp(ext, ".gz") != 0)
+#ifndef HAVE_LIBZSTD
+         if (!(flag & IOWRT) && ext != NULL && strcmp(ext, ".zst") == 0)
+         {  put_err_msg("zstd support not compiled in");
+            return NULL;
+         }
+#endif
+         if (!(flag & IOWRT) && ext != NULL && (strcmp(ext, ".gz") == 0
+#ifdef HAVE_LIBZSTD
+            || strcmp(ext, ".zst") == 0
+#endif
+            ))
+         {  flag |= IOPIPE | (strcmp(ext, ".gz") == 0 ? IOGZIP : IOZSTD);
+            file = pipe_open(name, flag & (IOGZIP | IOZSTD));
+            if (file == NULL)
+               return NULL;
+         }
+         else if (ext == NULL || strcmp(ext, ".gz") != 0)
          {  file = fopen(name, mode);
             if (file == NULL)
             {  put_err_msg(strerror(errno));
                return NULL;
             }
          }
-#if 0
          else
          {  flag |= IOGZIP;
             if (strcmp(mode, "r") == 0)
@@ -137,7 +221,6 @@ compass_file *compass_open(const char *name, const char *mode)
                return NULL;
             }
          }
-#endif
       }
       f = talloc(1, compass_file);
       f->base = talloc(BUFSIZ, char);
@@ -228,38 +311,31 @@ int compass_read(compass_file *f, void *buf, int nnn)
       for (nrd = 0; nrd < nnn; nrd += cnt)
       {  if (f->cnt == 0)
          {  /* buffer is empty; fill it */
+            char *ptr = f->base;
             if (f->flag & IONULL)
                cnt = 0;
-            else if (!(f->flag & IOGZIP))
-            {  cnt = fread(f->base, 1, f->size, (FILE *)(f->file));
-               if (ferror((FILE *)(f->file)))
+            else if (f->flag & IOPIPE)
+            {  /* the next block of the pipe is read in place */
+               cnt = pipe_read((struct pipe *)(f->file), &ptr);
+               if (cnt < 0)
                {  f->flag |= IOERR;
-                  put_err_msg(strerror(errno));
                   return EOF;
                }
             }
-#if 0
             else
-            {  int errnum;
-               const char *msg;
-               cnt = gzread((gzFile)(f->file), f->base, f->size);
-               if (cnt < 0)
+            {  cnt = fread(f->base, 1, f->size, (FILE *)(f->file));
+               if (ferror((FILE *)(f->file)))
                {  f->flag |= IOERR;
-                  msg = gzerror((gzFile)(f->file), &errnum);
-                  if (errnum == Z_ERRNO)
-                     put_err_msg(strerror(errno));
-                  else
-                     put_err_msg(msg);
+                  put_err_msg(strerror(errno));
                   return EOF;
                }
             }
-#endif
             if (cnt == 0)
             {  if (nrd == 0)
                   f->flag |= IOEOF;
                break;
             }
-            f->ptr = f->base;
+            f->ptr = ptr;
             f->cnt = cnt;
          }
          cnt = nnn - nrd;
@@ -324,7 +400,6 @@ static int do_flush(compass_file *f)
                return EOF;
             }
          }
-#if 0
          else
          {  int errnum;
             const char *msg;
@@ -338,7 +413,6 @@ static int do_flush(compass_file *f)
                return EOF;
             }
          }
-#endif
       }
       f->ptr = f->base;
       f->cnt = 0;
@@ -447,6 +521,10 @@ int compass_close(compass_file *f)
       }
       if (f->flag & (IONULL | IOSTD))
          ;
+      else if (f->flag & IOPIPE)
+      {  if (pipe_close((struct pipe *)(f->file)) != 0)
+            ret = EOF;
+      }
       else if (!(f->flag & IOGZIP))
       {  if (fclose((FILE *)(f->file)) != 0)
          {  if (ret == 0)
@@ -455,7 +533,6 @@ int compass_close(compass_file *f)
             }
          }
       }
-#if 0
       else
       {  int errnum;
          errnum = gzclose((gzFile)(f->file));
@@ -478,10 +555,236 @@ int compass_close(compass_file *f)
          }
 #endif
       }
-#endif
       tfree(f->base);
       tfree(f);
       return ret;
 }
 
+/***********************************************************************
+*  pipe_fill - decompress next block
+*
+*  This routine decompresses into the block buf the next PIPE_SIZE bytes
+*  of the file of the pipe p, or fewer at the end of the file. It is run
+*  by the decompression thread.
+*
+*  The routine returns the number of bytes stored in buf, zero at the end
+*  of the file, or a negative value if an error occurs; the error message
+*  is then stored in p->msg. */
+
+static int pipe_fill(struct pipe *p, char *buf)
+{     if (p->flag & IOGZIP)
+      {  int cnt, errnum;
+         const char *msg;
+         cnt = gzread((gzFile)(p->file), buf, PIPE_SIZE);
+         if (cnt < 0)
+         {  msg = gzerror((gzFile)(p->file), &errnum);
+            strncpy(p->msg, errnum == Z_ERRNO ? strerror(errno) : msg,
+               sizeof(p->msg) - 1);
+            return -1;
+         }
+         return cnt;
+      }
+#ifdef HAVE_LIBZSTD
+      else
+      {  ZSTD_outBuffer out;
+         size_t ret, pos, ipos;
+         out.dst = buf;
+         out.size = PIPE_SIZE;
+         out.pos = 0;
+         while (out.pos < out.size)
+         {  if (p->in.pos == p->in.size)
+            {  /* read more compressed data */
+               p->in.size = fread((void *)p->in.src, 1, p->in_size,
+                  (FILE *)(p->file));
+               p->in.pos = 0;
+               if (ferror((FILE *)(p->file)))
+               {  strncpy(p->msg, strerror(errno), sizeof(p->msg) - 1);
+                  return -1;
+               }
+            }
+            pos = out.pos, ipos = p->in.pos;
+            ret = ZSTD_decompressStream(p->zds, &out, &p->in);
+            if (ZSTD_isError(ret))
+            {  strncpy(p->msg, ZSTD_getErrorName(ret), sizeof(p->msg) - 1);
+               return -1;
+            }
+            if (out.pos != pos || p->in.pos != ipos)
+               p->zret = ret;
+            else if (p->in.size == 0)
+            {  /* end of file, and nothing left in the decoder */
+               if (p->zret != 0)
+               {  strcpy(p->msg, "truncated zstd file");
+                  return -1;
+               }
+               break;
+            }
+         }
+         return (int)out.pos;
+      }
+#endif
+      return 0;
+}
+
+/***********************************************************************
+*  pipe_run - decompression thread
+*
+*  This routine fills the free blocks of the pipe in turn, until the end
+*  of the file, an error, or the stream is closed. */
+
+static void *pipe_run(void *arg)
+{     struct pipe *p = arg;
+      int k, cnt;
+      for (;;)
+      {  pthread_mutex_lock(&p->mutex);
+         while (p->count == PIPE_NUM && !p->stop)
+            pthread_cond_wait(&p->cond, &p->mutex);
+         k = p->head;
+         if (p->stop)
+         {  pthread_mutex_unlock(&p->mutex);
+            break;
+         }
+         pthread_mutex_unlock(&p->mutex);
+         /* block k is not read by the stream until it is counted */
+         cnt = pipe_fill(p, p->blk[k]);
+         pthread_mutex_lock(&p->mutex);
+         if (cnt > 0)
+         {  p->len[k] = cnt;
+            p->head = (k + 1) % PIPE_NUM;
+            p->count++;
+         }
+         else
+            p->done = (cnt < 0 ? 2 : 1);
+         pthread_cond_broadcast(&p->cond);
+         pthread_mutex_unlock(&p->mutex);
+         if (cnt <= 0)
+            break;
+      }
+      return NULL;
+}
+
+/***********************************************************************
+*  pipe_open - open decompression pipe
+*
+*  This routine opens the compressed file name, in gzip (flag = IOGZIP)
+*  or zstd (flag = IOZSTD) format, and starts its decompression thread.
+*
+*  The routine returns a pointer to the pipe, or NULL if the file cannot
+*  be opened. */
+
+static struct pipe *pipe_open(const char *name, int flag)
+{     struct pipe *p;
+      int k;
+      p = talloc(1, struct pipe);
+      memset(p, 0, sizeof(struct pipe));
+      p->flag = flag;
+      if (flag & IOGZIP)
+      {  p->file = gzopen(name, "rb");
+         if (p->file == NULL)
+         {  put_err_msg(strerror(errno));
+            tfree(p);
+            return NULL;
+         }
+         gzbuffer((gzFile)(p->file), 131072);
+      }
+#ifdef HAVE_LIBZSTD
+      else
+      {  p->file = fopen(name, "rb");
+         if (p->file == NULL)
+         {  put_err_msg(strerror(errno));
+            tfree(p);
+            return NULL;
+         }
+         p->zds = ZSTD_createDStream();
+         if (p->zds == NULL)
+            xerror("compass_open: unable to create zstd context\n");
+         ZSTD_initDStream(p->zds);
+         p->in_size = ZSTD_DStreamInSize();
+         p->in.src = talloc((int)p->in_size, char);
+         p->in.size = p->in.pos = 0;
+      }
+#endif
+      for (k = 0; k < PIPE_NUM; k++)
+         p->blk[k] = talloc(PIPE_SIZE, char);
+      pthread_mutex_init(&p->mutex, NULL);
+      pthread_cond_init(&p->cond, NULL);
+      if (pthread_create(&p->thread, NULL, pipe_run, p) != 0)
+         xerror("compass_open: unable to create thread\n");
+      return p;
+}
+
+/***********************************************************************
+*  pipe_read - read next block from decompression pipe
+*
+*  This routine releases the block of the pipe p read before, if any,
+*  waits for the next block to be filled and stores in *ptr a pointer to
+*  it, which is valid until the next call.
+*
+*  The routine returns the number of bytes in the block, zero at the end
+*  of the file, or a negative value if a decompression error occurred. */
+
+static int pipe_read(struct pipe *p, char **ptr)
+{     int cnt;
+      pthread_mutex_lock(&p->mutex);
+      if (p->busy)
+      {  p->busy = 0;
+         p->tail = (p->tail + 1) % PIPE_NUM;
+         p->count--;
+         pthread_cond_broadcast(&p->cond);
+      }
+      while (p->count == 0 && !p->done)
+         pthread_cond_wait(&p->cond, &p->mutex);
+      if (p->count > 0)
+      {  *ptr = p->blk[p->tail];
+         cnt = p->len[p->tail];
+         p->busy = 1;
+      }
+      else if (p->done == 2)
+      {  put_err_msg(p->msg);
+         cnt = -1;
+      }
+      else
+         cnt = 0;
+      pthread_mutex_unlock(&p->mutex);
+      return cnt;
+}
+
+/***********************************************************************
+*  pipe_close - close decompression pipe
+*
+*  This routine stops the decompression thread of the pipe p, closes its
+*  file and frees the pipe.
+*
+*  The routine returns zero on success and non-zero otherwise. */
+
+static int pipe_close(struct pipe *p)
+{     int k, ret = 0;
+      pthread_mutex_lock(&p->mutex);
+      p->stop = 1;
+      pthread_cond_broadcast(&p->cond);
+      pthread_mutex_unlock(&p->mutex);
+      pthread_join(p->thread, NULL);
+      pthread_cond_destroy(&p->cond);
+      pthread_mutex_destroy(&p->mutex);
+      if (p->flag & IOGZIP)
+      {  if (gzclose((gzFile)(p->file)) != Z_OK)
+         {  put_err_msg("gzclose failed");
+            ret = EOF;
+         }
+      }
+#ifdef HAVE_LIBZSTD
+      else
+      {  ZSTD_freeDStream(p->zds);
+         tfree((void *)p->in.src);
+         if (fclose((FILE *)(p->file)) != 0)
+         {  put_err_msg(strerror(errno));
+            ret = EOF;
+         }
+      }
+#endif
+      for (k = 0; k < PIPE_NUM; k++)
+         tfree(p->blk[k]);
+      tfree(p);
+      return ret;
+}
+
 /* eof */
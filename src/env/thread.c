@@ -0,0 +1,210 @@
+/***********************************************************************
+*  This code is part of Compass.
+*
+*  Compass is free software: you can redistribute it and/or modify it
+*  under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  Compass is distributed in the hope that it will be useful, but WITHOUT
+*  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+*  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+*  License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with Compass. If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include "env.h"
+#include <pthread.h>
+#include <unistd.h>
+
+static pthread_once_t env_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t env_mutex;
+/* recursive mutex protecting the environment block (memory book-keeping
+ * and terminal output buffer) when several threads are running */
+
+static void init_env_mutex(void)
+{     pthread_mutexattr_t attr;
+      pthread_mutexattr_init(&attr);
+      pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+      pthread_mutex_init(&env_mutex, &attr);
+      pthread_mutexattr_destroy(&attr);
+      return;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_lock - acquire environment lock
+*
+*  SYNOPSIS
+*
+*  void compass_lock(void);
+*
+*  DESCRIPTION
+*
+*  The routine compass_lock acquires the lock which serializes access to
+*  the Compass environment block. The lock is recursive, so a thread
+*  which already holds it may acquire it again. */
+
+void compass_lock(void)
+{     pthread_once(&env_once, init_env_mutex);
+      pthread_mutex_lock(&env_mutex);
+      return;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_unlock - release environment lock
+*
+*  SYNOPSIS
+*
+*  void compass_unlock(void);
+*
+*  DESCRIPTION
+*
+*  The routine compass_unlock releases the lock previously acquired by
+*  the routine compass_lock. */
+
+void compass_unlock(void)
+{     pthread_mutex_unlock(&env_mutex);
+      return;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_ncpus - determine number of processors
+*
+*  SYNOPSIS
+*
+*  int compass_ncpus(void);
+*
+*  RETURNS
+*
+*  The routine compass_ncpus returns the number of processors currently
+*  online, or 1 if this number cannot be determined. */
+
+int compass_ncpus(void)
+{     long ncpus = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+      ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+      if (ncpus < 1)
+         ncpus = 1;
+      if (ncpus > INT_MAX)
+         ncpus = INT_MAX;
+      return (int)ncpus;
+}
+
+struct job
+{     /* parallel loop descriptor shared by all worker threads */
+      void (*func)(void *info, int tid, int k);
+      /* routine to be called for every item */
+      void *info;
+      /* transit pointer (cookie) passed to the routine func */
+      int count;
+      /* number of items */
+      int next;
+      /* next item to be processed */
+      pthread_mutex_t mutex;
+      /* mutex protecting the field next */
+};
+
+struct worker
+{     /* worker thread descriptor */
+      struct job *job;
+      /* parallel loop being processed */
+      int tid;
+      /* worker ordinal number, 0 <= tid < nthreads */
+};
+
+static void *run_worker(void *arg)
+{     struct worker *w = arg;
+      struct job *job = w->job;
+      int k;
+      for (;;)
+      {  pthread_mutex_lock(&job->mutex);
+         k = job->next++;
+         pthread_mutex_unlock(&job->mutex);
+         if (k >= job->count)
+            break;
+         job->func(job->info, w->tid, k);
+      }
+      return NULL;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_parallel - run parallel loop
+*
+*  SYNOPSIS
+*
+*  int compass_parallel(int nthreads, int count,
+*     void (*func)(void *info, int tid, int k), void *info);
+*
+*  DESCRIPTION
+*
+*  The routine compass_parallel calls func(info, tid, k) once for every
+*  item k = 0, 1, ..., count-1. The items are distributed dynamically
+*  among nthreads threads, the calling thread being one of them; tid is
+*  the ordinal number of the thread which processes item k and may be
+*  used by func to select thread-local scratch storage.
+*
+*  If nthreads is not positive, the number of processors online is used.
+*  The number of threads is never greater than count. With one thread
+*  the items are processed in increasing order by the calling thread.
+*
+*  The routine func must not depend on the order in which the items are
+*  processed, and may only call Compass routines which do not modify
+*  data shared with other items.
+*
+*  RETURNS
+*
+*  The routine compass_parallel returns the number of threads used. */
+
+int compass_parallel(int nthreads, int count,
+      void (*func)(void *info, int tid, int k), void *info)
+{     struct job job;
+      struct worker *w;
+      pthread_t *thread;
+      int t, k;
+      if (count < 1)
+         return 0;
+      if (nthreads < 1)
+         nthreads = compass_ncpus();
+      if (nthreads > count)
+         nthreads = count;
+      if (nthreads == 1)
+      {  for (k = 0; k < count; k++)
+            func(info, 0, k);
+         return 1;
+      }
+      job.func = func;
+      job.info = info;
+      job.count = count;
+      job.next = 0;
+      pthread_mutex_init(&job.mutex, NULL);
+      w = talloc(nthreads, struct worker);
+      thread = talloc(nthreads, pthread_t);
+      for (t = 0; t < nthreads; t++)
+      {  w[t].job = &job;
+         w[t].tid = t;
+      }
+      for (t = 1; t < nthreads; t++)
+      {  if (pthread_create(&thread[t], NULL, run_worker, &w[t]) != 0)
+            xerror("compass_parallel: unable to create thread\n");
+      }
+      run_worker(&w[0]);
+      for (t = 1; t < nthreads; t++)
+         pthread_join(thread[t], NULL);
+      pthread_mutex_destroy(&job.mutex);
+      tfree(thread);
+      tfree(w);
+      return nthreads;
+}
+
+/* eof */
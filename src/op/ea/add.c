@@ -19,7 +19,6 @@
 #include "op.h"
 #include "env.h"
 #include "data/kdtree/kdtree.h"
-#include <gsl/gsl_vector.h>
 
 #define BIGDOUBLE (1e30)
 #define Edgelen(data, n1, n2)  CCutil_dat_edgelen (n1, n2, data)
@@ -29,125 +28,165 @@ typedef struct neighbour {
     int *node;
 } neighbour;
 
-typedef struct position {
-    int prev;
-    int next;
-    double cost;
-} position;
+typedef struct op_addpos position;
 
 static void
-  get_node_3_nearest (CCkdtree *kt, int ncount, compass_data *data, int scount, int node, int *selected,
-      struct neighbour *neighbour, int first, CCrandstate *rstate),
+  get_node_3_nearest (CCkdtree *kt, int ncount, compass_data *data, int node, int *selected,
+      struct neighbour *neighbour, int *len),
   get_best_position (compass_data *data, int scount, int *genotype, int node, struct neighbour *neighbour,
-    struct position *pos);
+    struct op_addpos *pos),
+  add_heap_update (CCdheap *heap, char *inheap, int node, double addvalue);
+
+static int
+  add_new_nearest (compass_data *data, int node, int nodesel,
+    struct op_eawork *work),
+  add_near_ball (int target, int node, void *info);
+
+static void
+  add_near_set (compass_data *data, int node, struct op_eawork *work),
+  add_near_link (struct op_eawork *work, int s),
+  add_near_unlink (struct op_eawork *work, int s),
+  add_mark (struct op_eawork *work, int *cnt, int node);
+
+struct near_ball
+{ compass_data *data;
+  int *selected;
+  struct op_eawork *work;
+  int cnt;
+};
+
+/* Insert unvisited nodes, best score/cost ratio first, while the tour
+ * length stays within cost_limit. The best insertion of every unvisited
+ * node is kept in a heap keyed by the ratio. After an insertion only
+ * the nodes whose 3 nearest visited nodes change, or which have the
+ * predecessor of the inserted node among them (its tour edge is gone),
+ * are evaluated again. The former are the nodes nearer to the inserted
+ * node than to their farthest near node: with a kd-tree they are looked
+ * for in the ball around the inserted node whose radius is the largest
+ * such length, kept in a second heap; otherwise every unvisited node is
+ * checked with the length to the inserted node only. The latter are on
+ * the list of the nodes holding the predecessor. Nodes which do not fit
+ * are taken out of the heap until their insertion changes, since the
+ * length only grows. The heaps and the lists are kept in the work
+ * arrays of the calling thread. */
 
 int OPadd_operator (CCkdtree *kt, int ncount, compass_prob *prob,
-    int *scount, int *selected, int *sposition, int *cycle, int *genotype, double *val,
-    double cost_limit, CCrandstate *rstate)
+    int *scount, int *selected, int *sposition, int *cycle, int *genotype, int *pred,
+    double *val, double cost_limit, struct op_eawork *work)
 {
-    int rval;
-    int i, j, prev, next;
+    int i, j, k, s, prev, full, cnt;
     int nodesel, nodeprev, nodenext;
-    int first, completed;
-    double len, cost, best, addvalue;
-    struct neighbour *neighbour = (struct neighbour *) NULL;
-    struct position *pos = (struct position *) NULL;
-
-    neighbour = xcalloc (ncount, sizeof(struct neighbour));
-
-    for (i = 1; i < ncount; i++) {
-      if (!selected[i]) {
-        struct neighbour *nodeneigh = &(neighbour[i]);
-        nodeneigh->this=i;
-        nodeneigh->node = xcalloc(4, sizeof(int));
-      }
-    }
+    double len, cost;
+    int *nearspace = work->near;
+    char *inheap = work->inheap;
+    struct neighbour nb;
+    struct near_ball ball;
+    struct op_addpos *pos = work->pos;
+    CCdheap *heap = &work->heap, *farheap = &work->farheap;
 
     if (ncount < 3) {
         fprintf (stderr, "Cannot find tour in an %d node graph\n", ncount);
         return 1;
     }
 
-  if (kt->root != (CCkdtree *) NULL) {
-
-      CCkdtree_undelete_all (kt, ncount);
-      for (i = 0; i < ncount; i++) {
-        if (!selected[i])
-          CCkdtree_delete (kt, i);
-      }
+    heap->size = 0;
+    for (i = 0; i < ncount; i++) {
+      inheap[i] = 0;
+      work->mark[i] = 0;
     }
 
     len = *val;
-    completed = 0;
-    first = 1;
-
-    pos = xcalloc(1, sizeof(struct position));
-
-    do {
-
-      best = -BIGDOUBLE;
-      //best = BIGDOUBLE;
-      for (i = 1; i < ncount; i++) {
-        if (!selected[i]) {
-          struct neighbour *nodeneigh = &neighbour[i];
-          get_node_3_nearest (kt, ncount, prob->data, *scount, i, selected, nodeneigh, first, rstate);
-          get_best_position (prob->data, *scount, genotype, i, nodeneigh, pos);
-
-#if 1
-          if (pos->cost <= cost_limit - len )
-            addvalue = prob->op->s[i]/pos->cost;
-          else
-            addvalue = -BIGDOUBLE;
-
-          if ( addvalue > best) {
-            nodesel   = i;
-            nodeprev  = pos->prev;
-            nodenext  = pos->next;
-            cost = pos->cost;
-            best = addvalue;
+    full = 1;
+
+    while (*scount < ncount) {
+
+      /* with up to 3 visited nodes the positions depend on scount, so
+       * every node is evaluated from scratch; the near lengths and lists
+       * are needed from the next insertion on */
+      if (full) {
+        farheap->size = 0;
+        for (i = 0; i < ncount; i++)
+          work->revhead[i] = -1;
+        for (i = 1; i < ncount; i++) {
+          if (!selected[i]) {
+            nb.this = i;
+            nb.node = nearspace + 4 * i;
+            get_node_3_nearest (kt, ncount, prob->data, i, selected, &nb,
+                work->len);
+            if (*scount >= 3)
+              add_near_set (prob->data, i, work);
+            get_best_position (prob->data, *scount, genotype, i, &nb, &pos[i]);
+            add_heap_update (heap, inheap, i, prob->op->s[i]/pos[i].cost);
           }
         }
       }
 
-      if ( best > -BIGDOUBLE ) {
-#else
-          if (pos->cost < best) {
-            nodesel   = i;
-            nodeprev  = pos->prev;
-            nodenext  = pos->next;
-            best = pos->cost;
-          }
+      nodesel = -1;
+      while ((i = CCutil_dheap_deletemin (heap)) != -1) {
+        inheap[i] = 0;
+        if (pos[i].cost <= cost_limit - len) {
+          nodesel = i;
+          break;
         }
       }
-
-      if ( best < BIGDOUBLE ) {
-#endif
-
-        genotype[nodeprev] = nodesel;
-        genotype[nodesel] = nodenext;
-        selected[nodesel] = 1;
-        *scount +=1;
-
-        if (kt->root != (CCkdtree *) NULL)
-          CCkdtree_undelete (kt, nodesel);
-
-        for (i=0; i<ncount; i++)
-        { if (!selected[i])
-          { struct neighbour *nodeneigh = &(neighbour[i]);
-            nodeneigh->node[3] = nodesel;
-          }
+      if (nodesel == -1)
+        break;
+
+      nodeprev = pos[nodesel].prev;
+      nodenext = pos[nodesel].next;
+      cost = pos[nodesel].cost;
+
+      genotype[nodeprev] = nodesel;
+      genotype[nodesel] = nodenext;
+      pred[nodesel] = nodeprev;
+      pred[nodenext] = nodesel;
+      selected[nodesel] = 1;
+      *scount +=1;
+
+      len += cost;
+
+      full = (*scount <= 3);
+      if (full)
+        continue;
+
+      /* nodesel no longer holds near nodes */
+      for (k = 0; k < 3; k++)
+        add_near_unlink (work, 4 * nodesel + k);
+      CCutil_dheap_delete (farheap, nodesel);
+
+      cnt = 0;
+      for (s = work->revhead[nodeprev]; s != -1; s = work->revnext[s])
+        add_mark (work, &cnt, s / 4);
+
+      if (kt->root != (CCkdnode *) NULL) {
+        if ((i = CCutil_dheap_findmin (farheap)) != -1) {
+          ball.data = prob->data;
+          ball.selected = selected;
+          ball.work = work;
+          ball.cnt = cnt;
+          CCkdtree_fixed_radius_nearest (kt, prob->data, (double *) NULL,
+              nodesel, -farheap->key[i], add_near_ball, &ball);
+          cnt = ball.cnt;
         }
-
-        len += cost;
-        first = 0;
-        struct neighbour *nodeneigh = &(neighbour[nodesel]);
-        xfree(nodeneigh->node);
-
       } else {
-        completed = 1;
+        for (i = 1; i < ncount; i++) {
+          if (!selected[i] && add_new_nearest (prob->data, i, nodesel, work))
+            add_mark (work, &cnt, i);
+        }
       }
 
-    } while (completed == 0 && *scount < ncount);
+      /* in increasing order, so that the heap changes do not depend on
+       * how the nodes were found */
+      CCutil_int_array_quicksort (work->list, cnt);
+      for (j = 0; j < cnt; j++) {
+        i = work->list[j];
+        work->mark[i] = 0;
+        nb.this = i;
+        nb.node = nearspace + 4 * i;
+        get_best_position (prob->data, *scount, genotype, i, &nb, &pos[i]);
+        add_heap_update (heap, inheap, i, prob->op->s[i]/pos[i].cost);
+      }
+    }
 
   prev=0;
   for (i = 0; i < *scount; i++) {
@@ -167,54 +206,32 @@ int OPadd_operator (CCkdtree *kt, int ncount, compass_prob *prob,
   }
 
   *val = len;
-
-  if (kt->root != (CCkdtree *) NULL)
-   CCkdtree_undelete_all (kt, ncount);
-
-  for (i = 1; i < ncount; i++)
-  { if (!selected[i]) {
-      struct neighbour *nodeneigh = &(neighbour[i]);
-      xfree(nodeneigh->node);
-    }
-  }
-  tfree(neighbour);
-  xfree(pos);
   return 0;
 }
 
 void OPadd_node (CCkdtree *kt, int ncount, compass_data *data, int node,
-    int *scount, int *selected, int *sposition, int *cycle, int *genotype, double *len,
-    CCrandstate *rstate)
+    int *scount, int *selected, int *sposition, int *cycle, int *genotype, int *pred,
+    double *len, struct op_eawork *work)
 { int i, j, prev, next;
   double cost;
-  struct neighbour *neighbour = (struct neighbour *) NULL;
-  struct position *pos = (struct position *) NULL;
+  int neighnodes[4];
+  struct neighbour _neighbour, *neighbour = &_neighbour;
+  struct op_addpos _pos, *pos = &_pos;
 
-  neighbour = xcalloc(1, sizeof(struct neighbour));
   neighbour->this = node;
-  neighbour->node = xcalloc(ncount, sizeof(int));
+  neighbour->node = neighnodes;
 
   if (ncount < 3) {
       fprintf (stderr, "Cannot find tour in an %d node graph\n", ncount);
   }
 
-  if (kt->root != (CCkdtree *) NULL) {
-
-      CCkdtree_undelete_all (kt, ncount);
-    for (i = 1; i < ncount; i++) {
-      if (!selected[i])
-        CCkdtree_delete (kt, i);
-    }
-
-  }
-
-  pos = xcalloc(1, sizeof(struct position));
-
-  get_node_3_nearest (kt, ncount, data, *scount, node, selected, neighbour, 1, rstate);
+  get_node_3_nearest (kt, ncount, data, node, selected, neighbour, work->len);
   get_best_position (data, *scount, genotype, node, neighbour, pos);
 
   genotype[pos->prev] = node;
   genotype[node] = pos->next;
+  pred[node] = pos->prev;
+  pred[pos->next] = node;
   *len += pos->cost;
   selected[node] = 1;
   *scount +=1;
@@ -225,90 +242,149 @@ void OPadd_node (CCkdtree *kt, int ncount, compass_data *data, int node,
     prev = genotype[prev];
   }
   xassert(prev == 0);
-  for (i = *scount; i < ncount; i++)
-    cycle[i] = -1;
 
-  j=0;
-  for (i = 0; i < ncount; i++) {
-    if (selected[i]) {
-      sposition[j] = i;
-      j++;
-    }
-  }
+  for (j = *scount - 1; j > 0 && sposition[j-1] > node; j--)
+    sposition[j] = sposition[j-1];
+  sposition[j] = node;
 
-CLEANUP:
+}
 
-  if (kt->root != (CCkdtree *) NULL) {
-      CCkdtree_undelete_all (kt, ncount);
-  }
+/* the 3 nearest selected nodes of node, nearest first; without a
+ * kd-tree the lengths from node are read into len[0..ncount-1] and
+ * scanned once, ties going to the lower node */
+static void get_node_3_nearest (CCkdtree *kt, int ncount, compass_data *data, int node, int *selected,
+    struct neighbour *neighbour, int *len)
+{
+  int i, k, m, near[3];
+  double d, dist[3];
 
-  xfree(neighbour->node);
-  xfree(neighbour);
-  xfree(pos);
+  if (kt->root != (CCkdtree *) NULL)
+  { CCkdtree_node_k_nearest_mask (kt, ncount, node, 3, data, (double *) NULL, neighbour->node, selected);
+  }
+  else
+  { compass_data_edgelen_range (data, node, 0, ncount, len);
+    m = 0;
+    for (i=0; i<ncount;i++)
+    { d = selected[i] ? (double) len[i] : BIGDOUBLE;
+      if (m == 3 && d >= dist[2])
+        continue;
+      for (k = m < 3 ? m : 2; k > 0 && d < dist[k-1]; k--)
+      { near[k] = near[k-1];
+        dist[k] = dist[k-1];
+      }
+      near[k] = i;
+      dist[k] = d;
+      if (m < 3)
+        m++;
+    }
+    neighbour->node[0] = near[0];
+    neighbour->node[1] = near[1];
+    neighbour->node[2] = near[2];
+  }
+}
 
+/* record the lengths to the near nodes of the unvisited node, link it
+ * to their lists and key it in farheap */
+static void add_near_set (compass_data *data, int node,
+    struct op_eawork *work)
+{ int k, *neard = work->neard + 4 * node, far;
+  compass_data_edgelen_list (data, node, 3, work->near + 4 * node, neard);
+  far = neard[0];
+  for (k = 0; k < 3; k++)
+  { add_near_link (work, 4 * node + k);
+    if (neard[k] > far)
+      far = neard[k];
+  }
+  work->farheap.key[node] = (double) -far;
+  CCutil_dheap_insert (&work->farheap, node);
 }
 
-static void get_node_3_nearest (CCkdtree *kt, int ncount, compass_data *data, int scount, int node, int *selected,
-    struct neighbour *neighbour, int first, CCrandstate *rstate)
-{
-  int i;
+/* put slot s on the list of the near node it holds */
+static void add_near_link (struct op_eawork *work, int s)
+{ int u = work->near[s];
+  work->revprev[s] = -1;
+  work->revnext[s] = work->revhead[u];
+  if (work->revhead[u] != -1)
+    work->revprev[work->revhead[u]] = s;
+  work->revhead[u] = s;
+}
 
-  if (first || scount < 3 || kt->root != (CCkdtree *) NULL)
-  { if (kt->root != (CCkdtree *) NULL)
-    { CCkdtree_node_k_nearest (kt, ncount, node, 3, data, (double *) NULL, neighbour->node, rstate);
-    }
-    else
-    { size_t *indices = (size_t *) NULL;
-      indices = xmalloc (3 * sizeof(size_t));
-      gsl_vector *tempdist = gsl_vector_alloc(ncount);
-
-      for (i=0; i<ncount;i++)
-      { if (selected[i])
-        { gsl_vector_set (tempdist, i, (double) Edgelen (data, node, i));
-        }
-        else
-        { gsl_vector_set (tempdist, i, BIGDOUBLE);
-        }
-      }
+/* take slot s off the list of the near node it holds */
+static void add_near_unlink (struct op_eawork *work, int s)
+{ if (work->revprev[s] == -1)
+    work->revhead[work->near[s]] = work->revnext[s];
+  else
+    work->revnext[work->revprev[s]] = work->revnext[s];
+  if (work->revnext[s] != -1)
+    work->revprev[work->revnext[s]] = work->revprev[s];
+}
 
-      gsl_sort_vector_smallest_index (indices, 3, tempdist);
+/* update the 3 nearest visited nodes of node (in any order) after
+ * nodesel has been visited, from the length to nodesel alone; return 1
+ * if they changed */
+static int add_new_nearest (compass_data *data, int node, int nodesel,
+    struct op_eawork *work)
+{ int k, far, d, *neard = work->neard + 4 * node;
+  far = 0;
+  for (k = 1; k < 3; k++)
+  { if (neard[k] > neard[far])
+      far = k;
+  }
+  d = Edgelen (data, node, nodesel);
+  if (d >= neard[far])
+    return 0;
+  add_near_unlink (work, 4 * node + far);
+  work->near[4 * node + far] = nodesel;
+  neard[far] = d;
+  add_near_link (work, 4 * node + far);
+  for (k = 0; k < 3; k++)
+  { if (neard[k] > d)
+      d = neard[k];
+  }
+  CCutil_dheap_changekey (&work->farheap, node, (double) -d);
+  return 1;
+}
 
-      neighbour->node[0] = (int) indices[0];
-      neighbour->node[1] = (int) indices[1];
-      neighbour->node[2] = (int) indices[2];
+/* CCkdtree_fixed_radius_nearest callback: node is within the ball around
+ * the inserted node target */
+static int add_near_ball (int target, int node, void *info)
+{ struct near_ball *ball = info;
+  if (!ball->selected[node] &&
+      add_new_nearest (ball->data, node, target, ball->work))
+    add_mark (ball->work, &ball->cnt, node);
+  return 0;
+}
 
-      xfree(indices);
-      gsl_vector_free(tempdist);
+/* append node to the nodes to evaluate again, once */
+static void add_mark (struct op_eawork *work, int *cnt, int node)
+{ if (work->mark[node])
+    return;
+  work->mark[node] = 1;
+  work->list[(*cnt)++] = node;
+}
 
+/* set the heap key of node to its insertion ratio addvalue */
+static void add_heap_update (CCdheap *heap, char *inheap, int node,
+    double addvalue)
+{ if (addvalue != addvalue)
+  { /* 0/0, never inserted */
+    if (inheap[node])
+    { CCutil_dheap_delete (heap, node);
+      inheap[node] = 0;
     }
+    return;
   }
+  if (inheap[node])
+    CCutil_dheap_changekey (heap, node, -addvalue);
   else
-  { size_t *indices = (size_t *) NULL;
-    indices = xmalloc (3 * sizeof(size_t));
-    gsl_vector *tempdist = gsl_vector_alloc(ncount);
-
-    for (i=0; i<ncount; i++)
-    { if (i == neighbour->node[0] || i == neighbour->node[1] ||
-          i == neighbour->node[2] || i == neighbour->node[3] )
-      { gsl_vector_set (tempdist, i, (double) Edgelen (data, node, i));
-      }
-      else
-      { gsl_vector_set (tempdist, i, BIGDOUBLE);
-      }
-    }
-
-    gsl_sort_vector_smallest_index (indices, 3, tempdist);
-    neighbour->node[0] = (int) indices[0];
-    neighbour->node[1] = (int) indices[1];
-    neighbour->node[2] = (int) indices[2];
-
-    xfree(indices);
-    gsl_vector_free(tempdist);
+  { heap->key[node] = -addvalue;
+    CCutil_dheap_insert (heap, node);
+    inheap[node] = 1;
   }
 }
 
 static void get_best_position (compass_data *data, int scount, int *genotype, int node, struct neighbour *nodeneigh,
-    struct position *pos)
+    struct op_addpos *pos)
 {
   int prev, next;
   double cost, best = BIGDOUBLE;
@@ -16,17 +16,35 @@
 ***********************************************************************/
 
 #include "compass.h"
+#include "util.h"
 #include "env.h"
+#include "op.h"
 
 #define BIGDOUBLE (1e30)
 
+static double
+    drop_eval (compass_data *data, double *scores, int prev, int node, int next,
+        double *cost);
+
+static void
+    drop_fix_tour (int ncount, int oldcount, int scount, int *selected,
+        int *sposition, int *cycle, int *genotype);
+
+/* Drop visited nodes, worst score/detour ratio first, until the tour
+ * length is within cost_limit. The candidates are kept in a heap keyed
+ * by the ratio; dropping a node only changes the detour of its two tour
+ * neighbours, which are found through pred, so each step costs
+ * O(log scount). The heap is the one of the work arrays of the calling
+ * thread, emptied on entry. */
+
 int OPdrop_operator ( int ncount, compass_data *data,
-    int *scount, int *selected, int *sposition, int *cycle, int *genotype, double *val,
-    double *scores, double cost_limit, CCrandstate *rstate)
+    int *scount, int *selected, int *sposition, int *cycle, int *genotype, int *pred,
+    double *val, double *scores, double cost_limit, CCrandstate *rstate,
+    struct op_eawork *work)
 {
-    double len, worst, tcost, cost, greedyeval;
-    int i, j, prev, next;
-    int nodesel, nodeprev, nodenext;
+    double len, cost;
+    int v, prev, next, nodesel, oldcount;
+    CCdheap *heap = &work->heap;
 
     if (ncount < 4) {
         fprintf (stderr, "Cannot drop nodes in an %d node tour\n", ncount);
@@ -34,109 +52,118 @@ int OPdrop_operator ( int ncount, compass_data *data,
     }
 
     len = *val;
+    if (len <= cost_limit)
+      return 0;
 
+    heap->size = 0;
+    for (v = genotype[0]; v != 0; v = genotype[v]) {
+      heap->key[v] = drop_eval (data, scores, pred[v], v, genotype[v], NULL);
+      CCutil_dheap_insert (heap, v);
+    }
+
+    oldcount = *scount;
     while ( len > cost_limit) {
-      worst = BIGDOUBLE;
-      for (i = 1; i < ncount; i++)
-      { if (selected[i])
-        { for (j = 0; j < ncount; j++)
-          { if (genotype[j] == i)
-              prev = j;
-          }
-          next = genotype[i];
-
-          tcost = (double) (CCutil_dat_edgelen(prev, i, data) +
-              CCutil_dat_edgelen(i,next, data) -
-              CCutil_dat_edgelen (prev, next, data));
-
-          if (scores[i]!=0)
-            greedyeval =  (double) scores[i] / tcost;
-          else
-            greedyeval = -BIGDOUBLE;
-
-          if (greedyeval < worst) {
-            nodesel   = i;
-            nodeprev  = prev;
-            nodenext  = next;
-            worst     = greedyeval;
-            cost     =  tcost;
-          }
-        }
-      }
-
-      genotype[nodeprev] = nodenext;
+      nodesel = CCutil_dheap_deletemin (heap);
+      if (nodesel == -1)
+        break;
+      prev = pred[nodesel];
+      next = genotype[nodesel];
+      drop_eval (data, scores, prev, nodesel, next, &cost);
+
+      genotype[prev] = next;
+      pred[next] = prev;
       genotype[nodesel] = nodesel;
+      pred[nodesel] = nodesel;
 
       selected[nodesel] = 0;
       *scount -=1;
 
       len -= cost;
 
+      if (prev != 0)
+        CCutil_dheap_changekey (heap, prev,
+            drop_eval (data, scores, pred[prev], prev, next, NULL));
+      if (next != 0)
+        CCutil_dheap_changekey (heap, next,
+            drop_eval (data, scores, prev, next, genotype[next], NULL));
     }
 
-  prev=0;
-  for (i = 0; i < *scount; i++) {
-    cycle[i] = prev;
-    prev = genotype[prev];
-  }
-  xassert(prev == 0);
-  for (i = *scount; i < ncount; i++)
-    cycle[i] = -1;
+    drop_fix_tour (ncount, oldcount, *scount, selected, sposition, cycle,
+        genotype);
 
-  j=0;
-  for (i = 0; i < ncount; i++) {
-    if (selected[i]) {
-      sposition[j] = i;
-      j++;
-    }
-  }
-
-  *val = len;
+    *val = len;
+    return 0;
 }
 
 void OPdrop_node (int ncount, compass_data *data, int node,
-    int *scount, int *selected, int *sposition, int *cycle, int *genotype, double *len,
-    CCrandstate *rstate)
+    int *scount, int *selected, int *sposition, int *cycle, int *genotype, int *pred,
+    double *len, CCrandstate *rstate)
 {
 
-  int i, j, prev, next;
+  int prev, next, oldcount;
   double cost;
 
   if (ncount < 4) {
     fprintf (stderr, "Cannot drop nodes in an %d node tour\n", ncount);
   }
 
-  for (j = 0; j < ncount; j++) {
-    if (genotype[j] == node)
-      prev = j;
-  }
+  prev = pred[node];
   next = genotype[node];
 
   cost = (double) (compass_get_edge_len(prev, node, data) +  compass_get_edge_len(node,next, data) -  compass_get_edge_len (prev, next, data));
 
   genotype[prev] = next;
+  pred[next] = prev;
   genotype[node] = node;
+  pred[node] = node;
 
   selected[node] = 0;
+  oldcount = *scount;
   *scount -=1;
 
+  drop_fix_tour (ncount, oldcount, *scount, selected, sposition, cycle,
+      genotype);
+
+  *len -= cost;
+
+}
+
+/* return the greedy value of dropping node from between prev and next,
+ * that is its score over the length saved (nodes without score come
+ * first); if cost is not NULL the length saved is stored in *cost */
+static double drop_eval (compass_data *data, double *scores, int prev,
+    int node, int next, double *cost)
+{ double tcost;
+  tcost = (double) (CCutil_dat_edgelen(prev, node, data) +
+      CCutil_dat_edgelen(node, next, data) -
+      CCutil_dat_edgelen (prev, next, data));
+  if (cost != NULL)
+    *cost = tcost;
+  if (scores[node] != 0)
+    return (double) scores[node] / tcost;
+  return -BIGDOUBLE;
+}
+
+/* rebuild cycle from genotype and remove the dropped nodes from
+ * sposition; only the first oldcount entries were in use */
+static void drop_fix_tour (int ncount, int oldcount, int scount,
+    int *selected, int *sposition, int *cycle, int *genotype)
+{ int i, j, prev;
   prev=0;
-  for (i = 0; i < *scount; i++) {
+  for (i = 0; i < scount; i++) {
     cycle[i] = prev;
     prev = genotype[prev];
   }
   xassert(prev == 0);
-  for (i = *scount; i < ncount; i++)
+  for (i = scount; i < oldcount; i++)
     cycle[i] = -1;
 
   j=0;
-  for (i = 0; i < ncount; i++) {
-    if (selected[i]) {
-      sposition[j] = i;
-      j++;
-    }
+  for (i = 0; i < oldcount; i++) {
+    if (selected[sposition[i]])
+      sposition[j++] = sposition[i];
   }
-
-  *len -= cost;
-
+  xassert(j == scount);
+  for (i = scount; i < oldcount; i++)
+    sposition[i] = ncount;
 }
@@ -17,15 +17,37 @@
 
 #include "compass.h"
 #include "rng.h"
+#include "util.h"
 #include "env.h"
 #include "tsp.h"
+#include "tsp/linkern/linkern.h"
 #include "op.h"
+#include <gsl/gsl_rng.h>
+
+struct pop_job
+{ /* d2d phase processed in parallel over the individuals */
+  op_population *pop;
+  struct op_cp *opcp;
+  struct op_eaws *ws;
+  CCutil_edgehash *fixhash;
+  /* if not NULL, number of elite tours using each edge */
+  int fixmin;
+  /* edges used by at least fixmin elite tours are fixed */
+};
 
 static void
 op_improve_lenght_pop ( compass_prob *prob, op_population *pop,
-    struct tsp_cp *tspcp),
+    struct op_cp *opcp, struct op_eaws *ws),
+op_improve_lenght_sol ( void *info, int tid, int i),
+op_count_elite_edges ( op_population *pop, CCutil_edgehash *h,
+    struct op_eacp *eacp, int *fixmin),
 op_check_feasibility_pop ( compass_prob *prob, op_population *pop,
-    struct op_cp *opcp);
+    struct op_cp *opcp, struct op_eaws *ws),
+op_check_feasibility_sol ( void *info, int tid, int i),
+op_breed_batch ( compass_prob *prob, op_population *pop,
+    struct op_cp *opcp, struct op_eaws *ws),
+op_breed_child ( void *info, int tid, int k),
+op_reset_worker ( struct op_eaws *ws, int tid, int i);
 
 /***********************************************************************
 *  NAME
@@ -74,12 +96,9 @@ int compass_op_solve_ea (compass_prob *prob, op_population *pop, struct op_cp *o
   double time_elapsed;
   struct op_prob *op = prob->op;
   struct op_eacp *eacp = opcp->eacp;
-  int *parent = pop->parent;
-  op_solution *child;
+  struct op_eaws *ws;
   op_solution *best_sol ;
-  parent = xcalloc( eacp->nparsel, sizeof(int));
-  child = xcalloc(1, sizeof(op_solution));
-  compass_op_init_sol(prob, child);
+  ws = compass_op_ea_create_ws(prob, pop, opcp, eacp->nthreads);
   eacp->tm_start = xtime();
   //compass_op_init_sol(prob, best_sol);
 /*----------------------------------------------------------------------------*/
@@ -90,27 +109,8 @@ int compass_op_solve_ea (compass_prob *prob, op_population *pop, struct op_cp *o
 /*----------------------------------------------------------------------------*/
 /* Main Loop */
   for (eacp->it=1; eacp->it< eacp->it_lim +1;eacp->it++)
-  { if (eacp->it   % eacp->d2d != 0)
-    { compass_op_choose_sol (prob, op->population, eacp->nparsel, parent, opcp);
-      compass_op_crossover (prob, op->population, child, parent, eacp);
-      if (rng_unif_01(prob->rstate) < eacp->pmut)
-        compass_op_mutate_sol( prob, child, eacp);
-      if ( pop->worst_val < child->val)
-      { compass_op_set_pop_sol (prob, op->population, child,
-          op->population->worst_ind);
-        compass_op_update_pop ( op->population);
-      }
-      compass_op_erase_sol(prob, child);
-    }
-    else
-    {
-      if ( eacp->len_improve1)
-        op_improve_lenght_pop (prob, op->population, opcp->tspcp);
-      op_check_feasibility_pop(prob, op->population, opcp);
-      if ( eacp->len_improve2)
-        op_improve_lenght_pop (prob, op->population, opcp->tspcp);
-      compass_op_update_pop(op->population);
-      best_sol = &op->population->solution[op->population->best_ind];
+  { if (compass_op_ea_step (prob, op->population, ws, eacp->it, opcp))
+    { best_sol = &op->population->solution[op->population->best_ind];
       compass_op_copy_sol(prob, best_sol, op->sol);
       if (eacp->msg_lev >= COMPASS_MSG_ON)
         xprintf("op   | EA :  %d it : best %.0f : worst %.0f (%.2f sec) \n",
@@ -127,9 +127,8 @@ int compass_op_solve_ea (compass_prob *prob, op_population *pop, struct op_cp *o
   }
 /*----------------------------------------------------------------------------*/
 cleanup:
-  xfree(parent);
-  compass_op_delete_sol(child);
 done:
+  compass_op_ea_delete_ws(ws);
   eacp->tm_end = xtime();
   compass_op_copy_sol(prob, op->sol, eacp->best);
   op->sol_stat = COMPASS_FEAS;
@@ -138,64 +137,453 @@ done:
 }
 
 
+/***********************************************************************
+*  NAME
+*
+*  compass_op_ea_step - perform one iteration of the EA
+*
+*  SYNOPSIS
+*
+*  int compass_op_ea_step(compass_prob *prob, op_population *pop,
+*     struct op_eaws *ws, int it, struct op_cp *opcp);
+*
+*  DESCRIPTION
+*
+*  The routine compass_op_ea_step performs the iteration it of the EA on
+*  the population pop. If it is not a multiple of eacp->d2d, a child is
+*  bred from parents selected from pop, mutated with probability pmut,
+*  and replaces the worst individual if it is better. In batch mode
+*  (eacp->batch > 1) ws->batch children are bred concurrently instead,
+*  and merged into pop in a single replacement step. Otherwise the
+*  whole population is improved and made feasible; the individuals are
+*  processed in parallel by ws->nthreads threads.
+*
+*  The work storage ws must be created for pop with the routine
+*  compass_op_ea_create_ws.
+*
+*  RETURNS
+*
+*  The routine returns non-zero if the iteration was a d2d generation
+*  and zero otherwise. */
+
+int compass_op_ea_step (compass_prob *prob, op_population *pop,
+    struct op_eaws *ws, int it, struct op_cp *opcp)
+{ struct op_eacp *eacp = opcp->eacp;
+  op_solution *child = ws->child;
+  int *parent = ws->parent;
+  if (it % eacp->d2d != 0 && ws->batch > 1)
+  { op_breed_batch (prob, pop, opcp, ws);
+    return 0;
+  }
+  if (it % eacp->d2d != 0)
+  { compass_op_choose_sol (prob, pop, eacp->nparsel, parent, opcp,
+        &ws->work[0]);
+    compass_op_crossover (prob, pop, child, parent, &ws->work[0]);
+    if (rng_unif_01(prob->rstate) < eacp->pmut)
+      compass_op_mutate_sol( prob, child, eacp, &ws->work[0]);
+    if ( pop->worst_val < child->val)
+    { /* the child takes the place of the worst individual, whose
+       * arrays are reused for the next child */
+      compass_op_swap_sol (child, &pop->solution[pop->worst_ind]);
+      compass_op_update_pop (pop);
+    }
+    compass_op_erase_sol(prob, child);
+    return 0;
+  }
+  if ( eacp->len_improve1)
+    op_improve_lenght_pop (prob, pop, opcp, ws);
+  op_check_feasibility_pop(prob, pop, opcp, ws);
+  if ( eacp->len_improve2)
+    op_improve_lenght_pop (prob, pop, opcp, ws);
+  compass_op_update_pop(pop);
+  return 1;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_op_ea_create_ws - create EA work storage
+*
+*  SYNOPSIS
+*
+*  struct op_eaws *compass_op_ea_create_ws(compass_prob *prob,
+*     op_population *pop, struct op_cp *opcp, int nthreads);
+*
+*  DESCRIPTION
+*
+*  The routine compass_op_ea_create_ws allocates the work storage used
+*  by the routine compass_op_ea_step on the population pop, including a
+*  problem view and a TSP sub-problem for each of nthreads threads, and
+*  the children of a batch if opcp->eacp->batch > 1. If nthreads is not
+*  positive, one thread per processor is used.
+*
+*  RETURNS
+*
+*  The routine returns a pointer to the work storage created. */
+
+struct op_eaws *compass_op_ea_create_ws(compass_prob *prob,
+    op_population *pop, struct op_cp *opcp, int nthreads)
+{ struct op_eaws *ws;
+  int t, k;
+  ws = xmalloc(sizeof(struct op_eaws));
+  ws->child = xcalloc(1, sizeof(op_solution));
+  compass_op_init_sol(prob, ws->child);
+  ws->parent = xcalloc(opcp->eacp->nparsel, sizeof(int));
+  ws->batch = opcp->eacp->batch;
+  ws->children = NULL;
+  ws->bparent = NULL;
+  ws->bperm = NULL;
+  ws->bval = NULL;
+  if (ws->batch > 1)
+  { ws->children = xcalloc(ws->batch, sizeof(op_solution *));
+    for (k = 0; k < ws->batch; k++)
+    { ws->children[k] = xcalloc(1, sizeof(op_solution));
+      compass_op_init_sol(prob, ws->children[k]);
+    }
+    ws->bparent = xcalloc(ws->batch * opcp->eacp->nparsel, sizeof(int));
+    ws->bperm = xcalloc(ws->batch, sizeof(int));
+    ws->bval = xcalloc(ws->batch, sizeof(double));
+  }
+  if (nthreads < 1)
+    nthreads = compass_ncpus();
+  if (nthreads > pop->size && nthreads > ws->batch)
+    nthreads = (pop->size > ws->batch ? pop->size : ws->batch);
+  ws->nthreads = nthreads;
+  ws->wprob = xcalloc(nthreads, sizeof(compass_prob *));
+  ws->tspprob = xcalloc(nthreads, sizeof(compass_prob *));
+  ws->lkctx = xcalloc(nthreads, sizeof(CClk_ctx *));
+  ws->work = talloc(nthreads, struct op_eawork);
+  for (t = 0; t < nthreads; t++)
+  { ws->wprob[t] = xmalloc(sizeof(compass_prob));
+    if (compass_worker_prob(prob, ws->wprob[t], prob->seed))
+      xerror("%s", get_err_msg());
+    ws->tspprob[t] = xmalloc(sizeof(compass_prob));
+    compass_init_prob(ws->tspprob[t]);
+    ws->lkctx[t] = CClinkern_ctx_alloc();
+    if (ws->lkctx[t] == NULL)
+      xerror("compass_op_ea_create_ws: unable to create LK context\n");
+    compass_op_ea_init_work(&ws->work[t], prob->n, pop->size, opcp->eacp->nparsel);
+  }
+  ws->size = pop->size;
+  ws->seed = xcalloc(pop->size > ws->batch ? pop->size : ws->batch,
+      sizeof(int));
+  return ws;
+}
+
+void compass_op_ea_delete_ws(struct op_eaws *ws)
+{ int t;
+  for (t = 0; t < ws->nthreads; t++)
+  { compass_delete_worker_prob(ws->wprob[t]);
+    xfree(ws->wprob[t]);
+    compass_delete_prob(ws->tspprob[t]);
+    CClinkern_ctx_free(ws->lkctx[t]);
+    compass_op_ea_delete_work(&ws->work[t]);
+  }
+  tfree(ws->work);
+  xfree(ws->wprob);
+  xfree(ws->tspprob);
+  xfree(ws->lkctx);
+  xfree(ws->seed);
+  xfree(ws->parent);
+  if (ws->batch > 1)
+  { for (t = 0; t < ws->batch; t++)
+      compass_op_delete_sol(ws->children[t]);
+    xfree(ws->children);
+    xfree(ws->bparent);
+    xfree(ws->bperm);
+    xfree(ws->bval);
+  }
+  compass_op_delete_sol(ws->child);
+  xfree(ws);
+  return;
+}
+
 /**********************************************************************/
 static void op_improve_lenght_pop ( compass_prob *prob, op_population *pop,
-    struct tsp_cp *tspcp)
+    struct op_cp *opcp, struct op_eaws *ws)
 /**********************************************************************/
 { int i;
-  compass_prob *tspprob = xmalloc(sizeof(compass_prob));
-  compass_init_prob(tspprob);
-
+  struct pop_job job;
+  CCutil_edgehash fixhash;
+  xassert(pop->size <= ws->size);
   for (i = 0; i < pop->size; i++)
-  { op_solution *opsol = &pop->solution[i];
-    compass_sub_prob ( prob, tspprob, opsol->selected);
-    compass_tsp_init_prob(tspprob);
-    tsp_solution *tspsol = tspprob->tsp->sol;
-    //compass_tsp_init_sol(tspprob, tspsol);
+    ws->seed[i] = CCutil_lprand(prob->rstate_cc);
+  job.pop = pop;
+  job.opcp = opcp;
+  job.ws = ws;
+  job.fixhash = NULL;
+  if (opcp->eacp->fix_share > 0.0 &&
+      opcp->tspcp->local_search == TSP_LINKERN_LS)
+  { op_count_elite_edges(pop, &fixhash, opcp->eacp, &job.fixmin);
+    job.fixhash = &fixhash;
+  }
+  xparallel(ws->nthreads, pop->size, op_improve_lenght_sol, &job);
+  if (job.fixhash != NULL)
+    CCutil_edgehash_free(&fixhash);
+  return;
+}
+
+/* count in h the tours of the best quarter of pop using each edge, and
+ * set fixmin to the number of them an edge must be in to be fixed */
+static void op_count_elite_edges ( op_population *pop, CCutil_edgehash *h,
+    struct op_eacp *eacp, int *fixmin)
+{ int m, v, u, count, nelite, ecount;
+  op_solution *sol;
+  nelite = pop->size / 4;
+  if (nelite < 2)
+    nelite = pop->size;
+  ecount = 0;
+  for (m = 0; m < nelite; m++)
+    ecount += pop->solution[pop->rankperm[pop->size - 1 - m]].ns;
+  if (CCutil_edgehash_init(h, ecount + 1))
+    xerror("op_count_elite_edges: out of memory\n");
+  for (m = 0; m < nelite; m++)
+  { sol = &pop->solution[pop->rankperm[pop->size - 1 - m]];
+    if (sol->ns < 3)
+      continue;
+    v = 0;
+    do
+    { u = sol->genotype[v];
+      CCutil_edgehash_find(h, v, u, &count);
+      if (CCutil_edgehash_set(h, v, u, count + 1))
+        xerror("op_count_elite_edges: out of memory\n");
+      v = u;
+    } while (v != 0);
+  }
+  *fixmin = (int) ceil(eacp->fix_share * nelite);
+  if (*fixmin < 1)
+    *fixmin = 1;
+  return;
+}
 
-    compass_convert_sol_op2tsp(prob, opsol, tspsol );
+static void op_improve_lenght_sol ( void *info, int tid, int i)
+{ struct pop_job *job = info;
+  struct tsp_cp *tspcp = job->opcp->tspcp;
+  compass_prob *prob = job->ws->wprob[tid];
+  compass_prob *tspprob = job->ws->tspprob[tid];
+  op_solution *opsol = &job->pop->solution[i];
+  int *flist = job->ws->work[tid].flist;
+  int fcount;
+  if (job->opcp->eacp->len_repair && opsol->ntouched == 0 &&
+      tspcp->local_search != TSP_NO_LS)
+    return; /* the tour is unchanged since it was last improved */
+  op_reset_worker(job->ws, tid, i);
+  compass_sub_prob ( prob, tspprob, opsol->selected);
+  compass_tsp_init_prob(tspprob);
+  tsp_solution *tspsol = tspprob->tsp->sol;
+  //compass_tsp_init_sol(tspprob, tspsol);
 
+  compass_convert_sol_op2tsp(tspprob, opsol, tspsol );
+
+  if (tspcp->neighcp->induced)
+    compass_data_induced_k_nearest (prob, tspprob, tspcp->neighcp );
+  else
     compass_data_k_nearest (tspprob, tspcp->neighcp );
-    if ( tspcp->local_search == TSP_NO_LS)
-    { if (tspcp->msg_lev >= COMPASS_MSG_ALL)
-        xprintf("tsp  :  - Skipping local seach...\n");
-    }
-    else
-    { if (tspcp->msg_lev >= COMPASS_MSG_ALL)
-      { xprintf("\n");
-      xprintf("tsp  :  - Starting local seach...\n");
+  fcount = 0;
+  if (job->fixhash != NULL && opsol->ns >= 3)
+  { /* the tour edges shared by the elite are fixed */
+    int v = 0, u, count;
+    int *orig_pos = tspprob->data->orig_pos;
+    do
+    { u = opsol->genotype[v];
+      CCutil_edgehash_find(job->fixhash, v, u, &count);
+      if (count >= job->fixmin)
+      { flist[2*fcount]   = orig_pos[v];
+        flist[2*fcount+1] = orig_pos[u];
+        fcount++;
       }
-      compass_tsp_local_search(tspprob, tspsol, tspcp);
-    }
-
-    if (tspsol->val < opsol->length )
-    { if (tspcp->msg_lev >= COMPASS_MSG_ON)
-        xprintf("op    :  Tour length improved.\n");
-      compass_convert_sol_tsp2op(prob, tspsol, opsol, opsol->selected);
+      v = u;
+    } while (v != 0);
+  }
+  if (tspcp->local_search == TSP_LINKERN_LS &&
+      CClinkern_ctx_fixedges(job->ws->lkctx[tid], tspprob->n,
+          fcount < tspprob->n ? fcount : 0, flist))
+    xerror("op_improve_lenght_sol: unable to fix edges\n");
+  if ( tspcp->local_search == TSP_NO_LS || fcount == tspprob->n)
+  { if (tspcp->msg_lev >= COMPASS_MSG_ALL)
+      xprintf("tsp  :  - Skipping local seach...\n");
+  }
+  else if (job->opcp->eacp->len_repair && opsol->ntouched >= 0)
+  { /* the tour was improved before the add/drop phase; search only
+     * from the nodes it added or reconnected, which are still visited */
+    int k, nactive = 0;
+    int *orig_pos = tspprob->data->orig_pos;
+    for (k = 0; k < opsol->ntouched; k++)
+    { if (orig_pos[opsol->touched[k]] >= 0)
+        opsol->touched[nactive++] = orig_pos[opsol->touched[k]];
     }
-    if (tspcp->msg_lev >= COMPASS_MSG_ALL)
-    {
-      xprintf (" imp %d: nv: %d, length %.0f, fitness %.0f\n",
-              i, opsol->ns, opsol->length, opsol->val);
+    compass_tsp_repair(tspprob, tspsol, tspcp, job->ws->lkctx[tid],
+        nactive, opsol->touched);
+    opsol->ntouched = 0;
+  }
+  else
+  { if (tspcp->msg_lev >= COMPASS_MSG_ALL)
+    { xprintf("\n");
+    xprintf("tsp  :  - Starting local seach...\n");
     }
-    compass_tsp_delete_prob(tspprob);
-    compass_erase_prob(tspprob);
+    compass_tsp_local_search(tspprob, tspsol, tspcp, job->ws->lkctx[tid]);
+    opsol->ntouched = 0;
+  }
+
+  if (tspsol->val < opsol->length )
+  { if (tspcp->msg_lev >= COMPASS_MSG_ON)
+      xprintf("op    :  Tour length improved.\n");
+    compass_convert_sol_tsp2op(prob, tspprob, tspsol, opsol);
+  }
+  if (tspcp->msg_lev >= COMPASS_MSG_ALL)
+  {
+    xprintf (" imp %d: nv: %d, length %.0f, fitness %.0f\n",
+            i, opsol->ns, opsol->length, opsol->val);
   }
-  compass_delete_prob(tspprob);
+  compass_tsp_delete_prob(tspprob);
   return;
 }
 
 
 /**********************************************************************/
 static void op_check_feasibility_pop ( compass_prob *prob, op_population *pop,
-    struct op_cp *opcp)
+    struct op_cp *opcp, struct op_eaws *ws)
 /**********************************************************************/
 { int i;
-
+  struct pop_job job;
+  xassert(pop->size <= ws->size);
   for (i = 0; i < pop->size; i++)
-  { op_solution *opsol = &pop->solution[i];
-    compass_op_fit_solution(prob, opsol, opcp);
+    ws->seed[i] = CCutil_lprand(prob->rstate_cc);
+  job.pop = pop;
+  job.opcp = opcp;
+  job.ws = ws;
+  xparallel(ws->nthreads, pop->size, op_check_feasibility_sol, &job);
+  return;
+}
+
+static void op_check_feasibility_sol ( void *info, int tid, int i)
+{ struct pop_job *job = info;
+  compass_prob *prob = job->ws->wprob[tid];
+  op_solution *opsol = &job->pop->solution[i];
+  op_reset_worker(job->ws, tid, i);
+  compass_op_fit_solution(prob, opsol, job->opcp, &job->ws->work[tid]);
+  return;
+}
+
+/* allocate the operator work arrays of one thread */
+void compass_op_ea_init_work ( struct op_eawork *work, int n, int pop_size,
+    int nparsel)
+{ int i;
+  work->index = xcalloc(pop_size, sizeof(int));
+  for (i = 0; i < pop_size; i++)
+    work->index[i] = i;
+  work->presel = xcalloc(nparsel, sizeof(int));
+  work->nsel = xcalloc(nparsel, sizeof(int));
+  work->prob = xcalloc(nparsel, sizeof(double));
+  work->loc = xcalloc(n, sizeof(int));
+  work->selnodes = talloc(n, struct op_selnode);
+  work->inter1 = xcalloc(n, sizeof(int));
+  work->inter2 = xcalloc(n, sizeof(int));
+  work->unvisited = xcalloc(n, sizeof(int));
+  work->flist = xcalloc(2 * n, sizeof(int));
+  work->oldnext = xcalloc(n, sizeof(int));
+  if (CCutil_dheap_init(&work->heap, n))
+    xerror("compass_op_ea_init_work: unable to create heap\n");
+  work->inheap = xcalloc(n, sizeof(char));
+  work->near = xcalloc(4 * n, sizeof(int));
+  work->pos = talloc(n, struct op_addpos);
+  work->len = xcalloc(n, sizeof(int));
+  work->neard = xcalloc(4 * n, sizeof(int));
+  if (CCutil_dheap_init(&work->farheap, n))
+    xerror("compass_op_ea_init_work: unable to create heap\n");
+  work->revhead = xcalloc(n, sizeof(int));
+  work->revnext = xcalloc(4 * n, sizeof(int));
+  work->revprev = xcalloc(4 * n, sizeof(int));
+  work->list = xcalloc(n, sizeof(int));
+  work->mark = xcalloc(n, sizeof(char));
+  return;
+}
+
+void compass_op_ea_delete_work ( struct op_eawork *work)
+{ xfree(work->index);
+  xfree(work->presel);
+  xfree(work->nsel);
+  xfree(work->prob);
+  xfree(work->loc);
+  tfree(work->selnodes);
+  xfree(work->inter1);
+  xfree(work->inter2);
+  xfree(work->unvisited);
+  xfree(work->flist);
+  xfree(work->oldnext);
+  CCutil_dheap_free(&work->heap);
+  xfree(work->inheap);
+  xfree(work->near);
+  tfree(work->pos);
+  xfree(work->len);
+  xfree(work->neard);
+  CCutil_dheap_free(&work->farheap);
+  xfree(work->revhead);
+  xfree(work->revnext);
+  xfree(work->revprev);
+  xfree(work->list);
+  xfree(work->mark);
+  return;
+}
+
+/* breed ws->batch children concurrently and merge them into pop */
+static void op_breed_batch ( compass_prob *prob, op_population *pop,
+    struct op_cp *opcp, struct op_eaws *ws)
+{ int j, k;
+  int *perm = ws->bperm;
+  double *values = ws->bval;
+  struct pop_job job;
+  for (k = 0; k < ws->batch; k++)
+    ws->seed[k] = CCutil_lprand(prob->rstate_cc);
+  job.pop = pop;
+  job.opcp = opcp;
+  job.ws = ws;
+  xparallel(ws->nthreads, ws->batch, op_breed_child, &job);
+  /* the best children replace the worst individuals, as long as they
+   * are better; pop->rankperm still ranks pop in increasing order */
+  for (k = 0; k < ws->batch; k++)
+  { perm[k] = k;
+    values[k] = ws->children[k]->val;
   }
+  CCutil_double_perm_quicksort (perm, values, ws->batch);
+  for (j = 0, k = ws->batch - 1; k >= 0 && j < pop->size; j++, k--)
+  { op_solution *child = ws->children[perm[k]];
+    op_solution *worst = &pop->solution[pop->rankperm[j]];
+    if (worst->val >= child->val)
+      break;
+    compass_op_swap_sol(child, worst);
+  }
+  if (j > 0)
+    compass_op_update_pop (pop);
+  for (k = 0; k < ws->batch; k++)
+    compass_op_erase_sol(prob, ws->children[k]);
+  return;
+}
+
+static void op_breed_child ( void *info, int tid, int k)
+{ struct pop_job *job = info;
+  struct op_eaws *ws = job->ws;
+  struct op_eacp *eacp = job->opcp->eacp;
+  compass_prob *prob = ws->wprob[tid];
+  op_solution *child = ws->children[k];
+  int *parent = &ws->bparent[k * eacp->nparsel];
+  op_reset_worker(ws, tid, k);
+  compass_op_choose_sol (prob, job->pop, eacp->nparsel, parent, job->opcp,
+      &ws->work[tid]);
+  compass_op_crossover (prob, job->pop, child, parent, &ws->work[tid]);
+  if (rng_unif_01(prob->rstate) < eacp->pmut)
+    compass_op_mutate_sol( prob, child, eacp, &ws->work[tid]);
+  return;
+}
+
+/* bring the problem view of thread tid to the same state before
+ * processing individual (or child) i, whichever ones it processed
+ * before */
+static void op_reset_worker ( struct op_eaws *ws, int tid, int i)
+{ compass_prob *prob = ws->wprob[tid];
+  CCutil_sprand(ws->seed[i], prob->rstate_cc);
+  gsl_rng_set(prob->rstate_gsl, ws->seed[i]);
+  rng_init_rand(prob->rstate, ws->seed[i]);
   return;
 }
 
@@ -224,10 +612,18 @@ void compass_op_init_eacp(struct op_eacp *eacp)
   eacp->it = 0;
   eacp->pop_size = 100;
   eacp->d2d = 50;
+  eacp->nthreads = 0;
+  eacp->batch = 1;
   eacp->nparsel = 10;
   eacp->pmut = 0.01;
   eacp->len_improve1 = 1;
   eacp->len_improve2 = 0;
+  eacp->len_repair = 1;
+  eacp->fix_share = 0.0;
+  eacp->nislands = 1;
+  eacp->migr_it = 0;
+  eacp->migr_size = 1;
+  eacp->migr_topo = OP_MIGR_RING;
   eacp->best = xcalloc(1, sizeof(op_solution));
   return;
 }
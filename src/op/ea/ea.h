@@ -31,9 +31,158 @@ struct op_eacp
   int pop_size;
   int len_improve1;
   int len_improve2;
+  int len_repair;           /* improve the tours changed by the add/drop
+                               phase only around the changed nodes */
+  double fix_share;         /* tour edges shared by this fraction of the
+                               elite are fixed for Lin-Kernighan (0 off) */
   double pmut;
   int nparsel;
   double pinit;
   int d2d;
+  int nthreads;             /* number of threads (0 means all) */
+  int batch;                /* children bred per iteration */
+  int nislands;             /* number of islands (populations) */
+  int migr_it;              /* migration interval (0 means d2d) */
+  int migr_size;            /* number of elites sent per migration */
+  int migr_topo;            /* migration topology: */
+#define OP_MIGR_RING     0    /* island i sends to island i+1 */
+#define OP_MIGR_ALL      1    /* every island sends to all others */
   struct op_solution *best;
 };
+
+struct op_selnode
+{ /* crossover record of a node visited by both parents */
+  int node;                 /* node number */
+  int nextsel1;             /* next common node in parent 1 */
+  int prevsel1;             /* previous common node in parent 1 */
+  int nextsel2;             /* next common node in parent 2 */
+  int prevsel2;             /* previous common node in parent 2 */
+  int beg1;                 /* inter1[beg1..beg1+ninter1-1] are the nodes */
+  int ninter1;              /* between node and nextsel1 in parent 1 */
+  int beg2;                 /* inter2[beg2..beg2+ninter2-1] are the nodes */
+  int ninter2;              /* between node and nextsel2 in parent 2 */
+  int degree;               /* number of distinct unvisited neighbours */
+  int visited;
+  int upos;                 /* position in the list of unvisited nodes */
+};
+
+struct op_addpos
+{ /* best insertion of an unvisited node by the add operator */
+  int prev;                 /* between prev */
+  int next;                 /* and next */
+  double cost;              /* length increase */
+};
+
+struct op_eawork
+{ /* work arrays of the EA operators, allocated once per thread so that
+     breeding a child does not allocate memory */
+  int *index;
+  /* index[i] = i, i = 0..pop_size-1, for preselection */
+  int *presel;
+  /* preselected individuals, presel[0..nparsel-1] */
+  int *nsel;
+  /* nsel[i] is the number of times presel[i] is selected */
+  double *prob;
+  /* prob[i] is the reproductive probability of presel[i] */
+  int *loc;
+  /* crossover: loc[v] is the compact index of common node v */
+  struct op_selnode *selnodes;
+  /* crossover: records of the common nodes, selnodes[0..n-1] */
+  int *inter1, *inter2;
+  /* crossover: nodes between common nodes in each parent */
+  int *unvisited;
+  /* crossover: list of unvisited common nodes */
+  int *flist;
+  /* improvement: fixed edges of the tour, flist[0..2*n-1] */
+  int *oldnext;
+  /* fitting: successors of the tour before the add/drop phase */
+  CCdheap heap;
+  /* add and drop operators: candidate nodes keyed by their ratio */
+  char *inheap;
+  /* add operator: inheap[v] is set if node v is in heap */
+  int *near;
+  /* add operator: near[4*v..4*v+2] are the 3 nearest visited nodes of
+     the unvisited node v */
+  int *neard;
+  /* add operator: neard[4*v+k] is the length of the edge from v to
+     near[4*v+k] */
+  CCdheap farheap;
+  /* add operator: unvisited nodes keyed by minus the length to their
+     farthest near node */
+  int *revhead;
+  int *revnext;
+  int *revprev;
+  /* add operator: the unvisited nodes holding the visited node u in
+     near are the nodes s/4 of the slots s on the list revhead[u],
+     revnext[s], ...; revprev[s] is -1 at the head */
+  int *list;
+  char *mark;
+  /* add operator: the nodes to evaluate again after an insertion,
+     list[0..] with mark[v] set for each; mark is cleared after use */
+  struct op_addpos *pos;
+  /* add operator: pos[v] is the best insertion of the unvisited node v */
+  int *len;
+  /* add operator: lengths of the edges from one node, len[0..n-1], read
+     when there is no kd-tree */
+};
+
+struct op_eaws
+{ /* EA work storage */
+  struct op_solution *child;
+  /* child bred by crossover */
+  int *parent;
+  /* parents chosen by selection, parent[0..nparsel-1] */
+  int batch;
+  /* number of children bred per iteration in batch mode */
+  struct op_solution **children;
+  /* children[k] is the k-th child of a batch, k = 0..batch-1 */
+  int *bparent;
+  /* bparent[k*nparsel..(k+1)*nparsel-1] are the parents of children[k] */
+  int *bperm;
+  double *bval;
+  /* bperm[0..batch-1] ranks the children of a batch by their values
+     bval[0..batch-1] */
+  int nthreads;
+  /* number of threads used in the d2d phase and in batch mode */
+  struct compass_prob **wprob;
+  /* wprob[t] is the problem view used by thread t, with private RNG
+     streams */
+  struct compass_prob **tspprob;
+  /* tspprob[t] is the TSP sub-problem used by thread t */
+  struct CClk_ctx **lkctx;
+  /* lkctx[t] is the Lin-Kernighan context of thread t, reused for the
+     sub-problems of all individuals */
+  int size;
+  /* population size */
+  struct op_eawork *work;
+  /* work[t] are the operator work arrays of thread t */
+  int *seed;
+  /* seed[i] seeds the random streams while processing individual (or
+     child) i, so that results do not depend on the number of threads */
+};
+
+struct compass_prob;
+struct op_population;
+struct op_cp;
+
+struct op_eaws *compass_op_ea_create_ws(struct compass_prob *prob,
+    struct op_population *pop, struct op_cp *opcp, int nthreads);
+/* create EA work storage */
+
+void compass_op_ea_delete_ws(struct op_eaws *ws);
+/* delete EA work storage */
+
+void compass_op_ea_init_work(struct op_eawork *work, int n, int pop_size,
+    int nparsel);
+/* allocate operator work arrays */
+
+void compass_op_ea_delete_work(struct op_eawork *work);
+/* free operator work arrays */
+
+int compass_op_ea_step(struct compass_prob *prob, struct op_population *pop,
+    struct op_eaws *ws, int it, struct op_cp *opcp);
+/* run one generation of the EA on pop */
+
+int compass_op_solve_ea_islands(struct compass_prob *prob,
+    struct op_population *pop, struct op_cp *opcp);
+/* solve OP problem with an island EA */
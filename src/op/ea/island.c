@@ -0,0 +1,281 @@
+/***********************************************************************
+*  This code is part of Compass.
+*
+*  Compass is free software: you can redistribute it and/or modify it
+*  under the terms of the GNU General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  Compass is distributed in the hope that it will be useful, but WITHOUT
+*  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+*  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+*  License for more details.
+*
+*  You should have received a copy of the GNU General Public License
+*  along with Compass. If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include "compass.h"
+#include "util.h"
+#include "env.h"
+#include "tsp.h"
+#include "op.h"
+
+struct island
+{ /* island (sub-population) evolved by one thread at a time */
+  compass_prob *prob;
+  /* thread-private view of the problem with its own RNG streams */
+  struct op_prob *op;
+  /* private copy of the OP object pointing to the island population */
+  op_population *pop;
+  /* island population */
+  struct op_eaws *ws;
+  /* EA work storage; islands already run in parallel, so the d2d phase
+     of each island is done by a single thread */
+  op_solution *best;
+  /* best individual after the last d2d generation */
+  int stop;
+  /* set when the stopping percentile has been reached */
+};
+
+struct archipelago
+{ /* common storage passed to the island routines */
+  compass_prob *prob;
+  /* master problem object */
+  struct op_cp *opcp;
+  /* control parameters */
+  struct island *isl;
+  /* islands, isl[0], ..., isl[nislands-1] */
+  int nislands;
+  /* number of islands */
+  int it_beg, it_end;
+  /* iterations it_beg, ..., it_end are done in the current epoch */
+};
+
+static void
+  island_start (void *info, int tid, int k),
+  island_epoch (void *info, int tid, int k),
+  island_migrate (struct archipelago *csa);
+
+static int
+  island_stop (struct op_cp *opcp, op_population *pop);
+
+/***********************************************************************
+*  NAME
+*
+*  compass_op_solve_ea_islands - solve OP problem with an island EA
+*
+*  SYNOPSIS
+*
+*  int compass_op_solve_ea_islands(compass_prob *prob,
+*     op_population *pop, struct op_cp *opcp);
+*
+*  DESCRIPTION
+*
+*  The routine compass_op_solve_ea_islands runs eacp->nislands copies of
+*  the evolutionary algorithm, each one on its own population and with
+*  its own random number streams. The first island starts from the
+*  population pop, the remaining ones build their own initial
+*  populations.
+*
+*  The islands are evolved concurrently, one thread per island, for
+*  eacp->migr_it iterations (an epoch). At the end of every epoch the
+*  eacp->migr_size best individuals of each island replace the worst
+*  ones of its neighbours, if they are better. With the topology
+*  OP_MIGR_RING island i sends its elites to island i+1 (mod nislands);
+*  with OP_MIGR_ALL every island sends its elites to all other islands.
+*
+*  Migration is done by the calling thread between epochs, so the result
+*  only depends on the seed and not on thread scheduling.
+*
+*  As in the single population EA, the best individual of an island is
+*  only taken after a d2d generation, when the population is feasible.
+*  On exit the best of these individuals is stored in prob->op->sol.
+*
+*  RETURNS
+*
+*  The routine returns zero on success and non-zero otherwise. */
+
+int compass_op_solve_ea_islands (compass_prob *prob, op_population *pop,
+    struct op_cp *opcp)
+{ int ret = 0;
+  int k, it, best, migr_it, nstop;
+  struct op_prob *op = prob->op;
+  struct op_eacp *eacp = opcp->eacp;
+  struct archipelago _csa, *csa = &_csa;
+  struct island *isl;
+  csa->prob = prob;
+  csa->opcp = opcp;
+  csa->nislands = eacp->nislands;
+  csa->isl = talloc(csa->nislands, struct island);
+  migr_it = (eacp->migr_it > 0 ? eacp->migr_it : eacp->d2d);
+  eacp->tm_start = xtime();
+  /* set up islands; seeds are drawn from the master stream to make the
+   * run reproducible */
+  for (k = 0; k < csa->nislands; k++)
+  { isl = &csa->isl[k];
+    isl->prob = talloc(1, compass_prob);
+    if (compass_worker_prob(prob, isl->prob,
+        CCutil_lprand(prob->rstate_cc)))
+    { xprintf("op   : Unable to set up island %d\n", k);
+      xerror("%s", get_err_msg());
+    }
+    isl->op = talloc(1, struct op_prob);
+    *isl->op = *op;
+    isl->op->sol = NULL;
+    isl->prob->op = isl->op;
+    isl->pop = xmalloc(sizeof(op_population));
+    compass_op_init_pop(prob, isl->pop, pop->size);
+    isl->pop->stop_per = pop->stop_per;
+    isl->op->population = isl->pop;
+    isl->ws = compass_op_ea_create_ws(isl->prob, isl->pop, opcp, 1);
+    isl->best = xcalloc(1, sizeof(op_solution));
+    compass_op_init_sol(prob, isl->best);
+    isl->stop = 0;
+  }
+  for (k = 0; k < pop->size; k++)
+    compass_op_copy_sol(prob, &pop->solution[k],
+        &csa->isl[0].pop->solution[k]);
+  compass_op_update_pop(csa->isl[0].pop);
+  compass_op_copy_sol(prob, op->sol, csa->isl[0].best);
+  if (eacp->msg_lev >= COMPASS_MSG_ON)
+    xprintf("op   | EA : %d islands, migration every %d it\n",
+        csa->nislands, migr_it);
+  xparallel(csa->nislands, csa->nislands - 1, island_start, csa);
+/*----------------------------------------------------------------------------*/
+/* Main Loop */
+  for (it = 0; it < eacp->it_lim; it = csa->it_end)
+  { csa->it_beg = it + 1;
+    csa->it_end = (eacp->it_lim - it > migr_it ? it + migr_it : eacp->it_lim);
+    xparallel(csa->nislands, csa->nislands, island_epoch, csa);
+    eacp->it = csa->it_end;
+    best = 0, nstop = 0;
+    for (k = 0; k < csa->nislands; k++)
+    { if (csa->isl[k].best->val > csa->isl[best].best->val)
+        best = k;
+      if (csa->isl[k].stop)
+        nstop++;
+    }
+    compass_op_copy_sol(prob, csa->isl[best].best, op->sol);
+    if (eacp->msg_lev >= COMPASS_MSG_ON)
+      xprintf("op   | EA :  %d it : best %.0f (island %d) (%.2f sec) \n",
+          eacp->it, op->sol->val, best, xdifftime(xtime(),eacp->tm_start));
+    if (nstop == csa->nislands)
+      break;
+    if (xdifftime(xtime(),opcp->tm_start) > opcp->tm_lim ||
+        xdifftime(xtime(),eacp->tm_start) > eacp->tm_lim )
+      break;
+    if (csa->it_end < eacp->it_lim)
+      island_migrate(csa);
+  }
+/*----------------------------------------------------------------------------*/
+  for (k = 0; k < csa->nislands; k++)
+  { isl = &csa->isl[k];
+    compass_op_ea_delete_ws(isl->ws);
+    compass_op_delete_sol(isl->best);
+    compass_op_delete_pop(isl->pop);
+    xfree(isl->op);
+    compass_delete_worker_prob(isl->prob);
+    xfree(isl->prob);
+  }
+  tfree(csa->isl);
+  eacp->tm_end = xtime();
+  compass_op_copy_sol(prob, op->sol, eacp->best);
+  op->sol_stat = COMPASS_FEAS;
+  return ret;
+}
+
+/* build the initial population of island k+1 (island 0 inherits the
+ * population of the caller) */
+static void island_start (void *info, int tid, int k)
+{ struct archipelago *csa = info;
+  struct island *isl = &csa->isl[k+1];
+  xassert(tid == tid);
+  compass_op_start_population(isl->prob, isl->pop, csa->opcp);
+  compass_op_copy_sol(isl->prob, &isl->pop->solution[isl->pop->best_ind],
+      isl->best);
+  return;
+}
+
+/* evolve island k for the iterations of the current epoch */
+static void island_epoch (void *info, int tid, int k)
+{ struct archipelago *csa = info;
+  struct island *isl = &csa->isl[k];
+  struct op_cp *opcp = csa->opcp;
+  struct op_eacp *eacp = opcp->eacp;
+  int it;
+  xassert(tid == tid);
+  if (isl->stop)
+    return;
+  for (it = csa->it_beg; it <= csa->it_end; it++)
+  { if (compass_op_ea_step (isl->prob, isl->pop, isl->ws, it, opcp))
+    { compass_op_copy_sol(isl->prob, &isl->pop->solution[isl->pop->best_ind],
+          isl->best);
+      if (eacp->msg_lev >= COMPASS_MSG_ALL)
+        xprintf("op   | EA :  %d it : island %d : best %.0f : worst %.0f\n",
+            it, k, isl->pop->best_val, isl->pop->worst_val);
+      if (island_stop(opcp, isl->pop))
+      { isl->stop = 1;
+        break;
+      }
+      if (xdifftime(xtime(),opcp->tm_start) > opcp->tm_lim ||
+          xdifftime(xtime(),eacp->tm_start) > eacp->tm_lim )
+        break;
+    }
+  }
+  return;
+}
+
+static int island_stop (struct op_cp *opcp, op_population *pop)
+{ return opcp->stop_pop && pop->best_val == pop->stop_val;
+}
+
+/* send the elites of every island to its neighbours */
+static void island_migrate (struct archipelago *csa)
+{ compass_prob *prob = csa->prob;
+  struct op_eacp *eacp = csa->opcp->eacp;
+  int n = csa->nislands;
+  int i, j, m, msize;
+  op_solution **elite, *sol;
+  op_population *dst;
+  msize = eacp->migr_size;
+  if (msize > csa->isl[0].pop->size)
+    msize = csa->isl[0].pop->size;
+  if (msize < 1)
+    return;
+  /* take a snapshot first, so that an individual never travels more
+   * than one hop per migration */
+  elite = xcalloc(n * msize, sizeof(op_solution *));
+  for (i = 0; i < n; i++)
+  { op_population *src = csa->isl[i].pop;
+    for (m = 0; m < msize; m++)
+    { sol = elite[i * msize + m] = xcalloc(1, sizeof(op_solution));
+      compass_op_init_sol(prob, sol);
+      compass_op_copy_sol(prob,
+          &src->solution[src->rankperm[src->size - 1 - m]], sol);
+    }
+  }
+  for (i = 0; i < n; i++)
+  { for (j = 0; j < n; j++)
+    { if (j == i)
+        continue;
+      if (eacp->migr_topo == OP_MIGR_RING && j != (i + 1) % n)
+        continue;
+      dst = csa->isl[j].pop;
+      for (m = 0; m < msize; m++)
+      { sol = elite[i * msize + m];
+        if (dst->worst_val < sol->val)
+        { compass_op_set_pop_sol(prob, dst, sol, dst->worst_ind);
+          compass_op_update_pop(dst);
+          csa->isl[j].stop = island_stop(csa->opcp, dst);
+        }
+      }
+    }
+  }
+  for (m = 0; m < n * msize; m++)
+    compass_op_delete_sol(elite[m]);
+  xfree(elite);
+  return;
+}
+
+/* eof */
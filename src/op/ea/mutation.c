@@ -20,47 +20,48 @@
 #include "op.h"
 #include "gsl/gsl_rng.h"
 
+/* append v to the nodes of sol whose tour edges changed, as
+ * compass_op_fit_solution does */
+static void mutate_touch (compass_prob *prob, op_solution *sol, int v)
+{ if (sol->ntouched < 0)
+    return;
+  if (sol->ntouched == prob->n)
+    sol->ntouched = -1;
+  else
+    sol->touched[sol->ntouched++] = v;
+  return;
+}
+
 /******************************************************************************/
 void compass_op_mutate_sol (compass_prob *prob, op_solution *sol,
-    struct op_eacp *eacp)
+    struct op_eacp *eacp, struct op_eawork *work)
 /******************************************************************************/
-{ int i, node;
-  int *candidates, *change, *indexes, *scount;
-  double runif;
+{ int node, prev, next;
 
-    change = xcalloc ( 1, sizeof(int ));
-    if (!change) {
-      goto cleanup;
-    }
-    candidates = xcalloc (prob->n-1, sizeof(int));
-    if (!candidates) {
-      goto cleanup;
-    }
-    for (i = 1; i < prob->n; i++)
-    {
-      candidates[i-1] = i;
-    }
-
-    gsl_ran_choose (prob->rstate_gsl, change, 1, candidates, prob->n-1, sizeof (int));
-    node= (int) change[0];
+    /* any node but the depot, chosen uniformly */
+    node = 1 + (int) gsl_rng_uniform_int (prob->rstate_gsl, prob->n-1);
 
     if (sol->selected[node]) {
+      prev = sol->pred[node];
+      next = sol->genotype[node];
       OPdrop_node (prob->n, prob->data, node,
-      &sol->ns, sol->selected, sol->sposition, sol->cycle, sol->genotype, &sol->length,
-      prob->rstate_cc);
+      &sol->ns, sol->selected, sol->sposition, sol->cycle, sol->genotype, sol->pred,
+      &sol->length, prob->rstate_cc);
       sol->val -= prob->op->s[node];
+      /* prev and next are joined */
+      mutate_touch (prob, sol, prev);
+      mutate_touch (prob, sol, next);
     } else {
       OPadd_node (prob->kdtree, prob->n, prob->data, node,
-      &sol->ns, sol->selected, sol->sposition, sol->cycle, sol->genotype, &sol->length,
-      prob->rstate_cc);
+      &sol->ns, sol->selected, sol->sposition, sol->cycle, sol->genotype, sol->pred,
+      &sol->length, work);
       sol->val += prob->op->s[node];
+      /* node is inserted between its new neighbours */
+      mutate_touch (prob, sol, sol->pred[node]);
+      mutate_touch (prob, sol, node);
+      mutate_touch (prob, sol, sol->genotype[node]);
     }
 
-cleanup:
-    xfree (change);
-    xfree (candidates);
   return;
 
 }
-
-
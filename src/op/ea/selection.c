@@ -24,33 +24,16 @@
 
 /******************************************************************************/
 void compass_op_choose_sol (compass_prob *prob, op_population *pop,
-    int nparsel, int *parents, struct op_cp *opcp)
+    int nparsel, int *parents, struct op_cp *opcp, struct op_eawork *work)
 /******************************************************************************/
 { int i, parent;
   double min=BIGDOUBLE;
   int sum=0;
-  double *reproductive_probs, *tprobs;
-  int *preselected, *selected;
-  int *indexes;
-  reproductive_probs = xcalloc (nparsel, sizeof(double));
-  if (!reproductive_probs)
-    goto cleanup;
-  tprobs = xcalloc (nparsel, sizeof(double));
-  if (!tprobs)
-    goto cleanup;
-  selected = xcalloc (nparsel, sizeof(int));
-  if (!selected)
-    goto cleanup;
-  preselected = xcalloc (nparsel, sizeof(int));
-  if (!preselected)
-    goto cleanup;
-  indexes = xcalloc ( pop->size, sizeof(int));
-  if (!indexes)
-    goto cleanup;
-  for (i = 0; i < pop->size; i++)
-    indexes[i] = i;
-  gsl_ran_choose (prob->rstate_gsl, preselected, nparsel, indexes, pop->size,
-      sizeof (int));
+  double *reproductive_probs = work->prob;
+  int *preselected = work->presel;
+  int *selected = work->nsel;
+  gsl_ran_choose (prob->rstate_gsl, preselected, nparsel, work->index,
+      pop->size, sizeof (int));
   for (i=0; i< nparsel; i++)
   {  op_solution *sol = &pop->solution[preselected[i]];
     if (sol->val < min )
@@ -58,11 +41,11 @@ void compass_op_choose_sol (compass_prob *prob, op_population *pop,
   }
   // We add 1 to ensure that are not null.
   for (i=0; i< nparsel; i++)
-    tprobs[i] = pop->solution[preselected[i]].val - min +1;
+    reproductive_probs[i] = pop->solution[preselected[i]].val - min +1;
   for (i=0; i< nparsel; i++)
-    sum += tprobs[i];
+    sum += reproductive_probs[i];
   for (i=0; i< nparsel; i++)
-    reproductive_probs[i] = tprobs[i]/ sum;
+    reproductive_probs[i] = reproductive_probs[i]/ sum;
   gsl_ran_multinomial(prob->rstate_gsl, nparsel, 2, reproductive_probs, selected);
   parent=0;
   for (i=0; i< nparsel; i++)
@@ -76,11 +59,5 @@ void compass_op_choose_sol (compass_prob *prob, op_population *pop,
     }
     if (parent==2) break;
   }
-cleanup:
-  xfree(reproductive_probs);
-  xfree(tprobs);
-  xfree(selected);
-  xfree(preselected);
-  xfree(indexes);
   return;
 }
@@ -24,8 +24,11 @@
 int compass_op_start_cycle ( compass_prob *opprob, struct op_solution *opsol,
     int *selected, struct tsp_cp *tspcp)
 /*****************************************************************************/
-{ int ret = 0;
+{ int ret = 0, i;
   compass_prob *tspprob = xmalloc(sizeof(compass_prob));
+  /* the node selection leaves stale entries in sposition */
+  for (i = opsol->ns; i < opprob->n; i++)
+    opsol->sposition[i] = opprob->n;
   compass_init_prob(tspprob);
   compass_sub_prob ( opprob, tspprob, selected);
   compass_tsp_init_prob(tspprob);
@@ -33,9 +36,9 @@ int compass_op_start_cycle ( compass_prob *opprob, struct op_solution *opsol,
   if (tspprob->kdtree == (CCkdtree *) NULL)
     xprintf("kdtree_start null\n");
   tsp_solution *tspsol = tspprob->tsp->sol;
-  compass_convert_sol_op2tsp(opprob, opsol, tspsol );
+  compass_convert_sol_op2tsp(tspprob, opsol, tspsol );
   compass_tsp_solve(tspprob, tspcp);
-  compass_convert_sol_tsp2op(opprob, tspsol, opsol, selected);
+  compass_convert_sol_tsp2op(opprob, tspprob, tspsol, opsol);
   compass_tsp_delete_prob(tspprob);
   compass_delete_prob(tspprob);
   return ret;
@@ -43,7 +46,7 @@ int compass_op_start_cycle ( compass_prob *opprob, struct op_solution *opsol,
 
 /*****************************************************************************/
 int compass_op_start_solution ( compass_prob *prob, op_solution *sol,
-    struct op_cp *opcp)
+    struct op_cp *opcp, struct op_eawork *work)
 /*****************************************************************************/
 { int ret = 0;
 
@@ -59,7 +62,7 @@ int compass_op_start_solution ( compass_prob *prob, op_solution *sol,
   else
     ret =1;
 
-  compass_op_fit_solution(prob, sol, opcp);
+  compass_op_fit_solution(prob, sol, opcp, work);
 
   return ret;
 }
@@ -70,21 +73,26 @@ int compass_op_start_population ( compass_prob *prob, op_population *pop,
 /*****************************************************************************/
 { int ret = 0;
   int i;
+  struct op_eawork work;
+  compass_op_ea_init_work(&work, prob->n, pop->size, opcp->eacp->nparsel);
   xprintf ("op   : > Population size: %d\n", pop->size);
   for (i = 0; i < pop->size; i++)
   { op_solution *sol = &pop->solution[i];
     compass_op_erase_sol(prob, sol);
-    compass_op_start_solution(prob, sol, opcp);
+    compass_op_start_solution(prob, sol, opcp, &work);
     if (opcp->msg_lev >= COMPASS_MSG_ALL)
     { xprintf(" %d: nvis: %d, length %.0f, value %.0f\n",
           i, sol->ns, sol->length, sol->val);
     }
     if (xdifftime(xtime(), opcp->tm_start) > opcp->tm_lim )
-    { pop->size = opcp->pop_size = i+1;
+    { /* opcp may be shared by the islands building their populations
+       * concurrently, so only pop is truncated */
+      pop->size = i+1;
       break;
     }
   }
   compass_op_update_pop(pop);
+  compass_op_ea_delete_work(&work);
 
 done:
   return ret;
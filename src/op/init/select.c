@@ -206,22 +206,26 @@ static void select_bernoulli ( compass_prob *prob, op_solution *sol,
 }
 
 #define BIGDOUBLE (1e30)
-#define Edgelen(data, n1, n2)  CCutil_dat_edgelen (n1, n2, data)
 
 /**********************************************************************/
 void compass_op_select_best3nodes (compass_prob *prob, op_solution *sol,
     struct op_cp *opcp)
 /**********************************************************************/
-{ int i, j, v1, v2;
+{ int i, j, v1, v2, *len0, *leni;
   double best_len, best_val, tmp_val, tmp_len;
   struct op_prob *op = prob->op;
 
+  /* len0[j] is the length of (0,j), leni[j] that of (i,j), j > i */
+  len0 = xcalloc(prob->n, sizeof(int));
+  leni = xcalloc(prob->n, sizeof(int));
+  compass_data_edgelen_range(prob->data, 0, 0, prob->n, len0);
   best_len= -BIGDOUBLE;
   best_val= -BIGDOUBLE;
   for(i=1;i<prob->n;i++)
-  { for(j=i+1;j<prob->n;j++){
+  { compass_data_edgelen_range(prob->data, i, i+1, prob->n, leni + i+1);
+    for(j=i+1;j<prob->n;j++){
       tmp_val = op->s[0]+op->s[i]+op->s[j];
-      tmp_len = Edgelen(prob->data,0,i)+Edgelen(prob->data,0,j)+Edgelen(prob->data,i,j);
+      tmp_len = len0[i]+len0[j]+leni[j];
       if( tmp_len < op->d0 && tmp_val > best_val )
       { best_val=tmp_val;
         best_len=tmp_len;
@@ -236,6 +240,8 @@ void compass_op_select_best3nodes (compass_prob *prob, op_solution *sol,
     }
   }
 
+  xfree(len0);
+  xfree(leni);
   if(best_val== -BIGDOUBLE)
     return;
 
@@ -245,11 +251,16 @@ void compass_op_select_best3nodes (compass_prob *prob, op_solution *sol,
   sol->selected[v2] = 1;
 
   for (i=0; i<prob->n; i++)
-    sol->genotype[i] = i;
+  { sol->genotype[i] = i;
+    sol->pred[i] = i;
+  }
 
   sol->genotype[0] = v1;
   sol->genotype[v1] = v2;
   sol->genotype[v2] = 0;
+  sol->pred[v1] = 0;
+  sol->pred[v2] = v1;
+  sol->pred[0] = v2;
 
   sol->cycle[0] = 0;
   sol->cycle[1] = v1;
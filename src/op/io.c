@@ -20,6 +20,9 @@
 #include "op.h"
 #include "util.h"
 #include "env.h"
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 struct compass_file
 {     /* sequential stream descriptor */
@@ -79,48 +82,377 @@ static void warning( const char *fname, const char *fmt, const int count, ...)
  return;
 }
 
-/***********************************************************************
-*  NAME
-*
-*  compass_read_prob - read Orienteering Problem data in LIB format
-*
-*  SYNOPSIS
-*
-*  int compass_read_prob(compass_prob *prob, int fmt, const op_opcp *parm,
-*     const char *fname);
-*
-*  DESCRIPTION
-*
-*  The routine compass_read_op_prob reads Orienteering Problem data in LIB
-*  format from a text file.
-*
-*  The parameter fmt specifies the file format:
-*
-*  FMT_LIB_FILE - LIB format;
-*  FMT_MPS_FILE - free (modern) MPS format.
-*
-*  The parameter parm is a pointer to the structure op_opcp, which specifies
-*  control parameters used by the routine. If parm is NULL, the routine uses
-*  default settings.
-*
-*  The character string fname specifies a name of the text file to be read.
-*
-*  Note that before reading data the current content of the problem object is
-*  completely erased with the routine compass_erase_op_prob.
-*
-*  RETURNS
-*
-*  If the operation was successful, the routine compass_read_prob returns zero.
-*  Otherwise, it prints an error message and returns non-zero. */
+/* The LIB file is read as a whole, mapped in memory if it is a regular
+ * file, and parsed in one pass: the header lines are processed as they
+ * were by fgets (at most LIB_LINE-1 bytes each), and the numbers of the
+ * sections are scanned like fscanf would, without the stdio calls. */
+
+#define LIB_LINE 254
+
+typedef struct lib_text lib_text;
+
+struct lib_text
+{ /* text of a LIB file */
+  const char *ptr;
+  /* next byte to be read */
+  const char *end;
+  /* end of the text */
+  int line;
+  /* number of the line of ptr */
+};
+
+static int lib_getline (lib_text *t, char *buf, int size)
+{ /* read the next line into buf, like fgets */
+  int k = 0;
+  if (t->ptr >= t->end)
+    return 0;
+  while (k < size - 1 && t->ptr < t->end)
+  { buf[k++] = *t->ptr;
+    if (*t->ptr++ == '\n')
+    { t->line++;
+      break;
+    }
+  }
+  buf[k] = '\0';
+  return 1;
+}
+
+static int lib_skip (lib_text *t)
+{ /* skip white space; zero at end of text */
+  while (t->ptr < t->end && isspace((unsigned char) *t->ptr))
+  { if (*t->ptr == '\n')
+      t->line++;
+    t->ptr++;
+  }
+  return t->ptr < t->end;
+}
+
+static const char *lib_atoi (const char *p, const char *end, int *val)
+{ /* convert the integer at p, like fscanf "%d" after the white space;
+   * the end of the integer, or NULL if there is none */
+  int neg = 0;
+  long long v = 0;
+  if (p < end && (*p == '+' || *p == '-'))
+  { neg = (*p == '-');
+    p++;
+  }
+  if (p >= end || !isdigit((unsigned char) *p))
+    return NULL;
+  while (p < end && isdigit((unsigned char) *p))
+  { if (v < INT_MAX)
+      v = 10 * v + (*p - '0');
+    p++;
+  }
+  *val = (int) (neg ? -v : v);
+  return p;
+}
+
+static int lib_int (lib_text *t, int *val)
+{ /* scan an integer, like fscanf "%d"; non-zero if there is none */
+  const char *p;
+  if (!lib_skip(t))
+    return 1;
+  p = lib_atoi(t->ptr, t->end, val);
+  if (p == NULL)
+    return 1;
+  t->ptr = p;
+  return 0;
+}
+
+static int lib_num (lib_text *t, double *val)
+{ /* scan a number, like fscanf "%lf"; non-zero if there is none. A
+   * decimal with at most 19 significant digits whose mantissa and power
+   * of ten are both exact doubles is converted with one correctly
+   * rounded product or quotient, the other numbers by strtod */
+  static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+      1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+      1e18, 1e19, 1e20, 1e21, 1e22 };
+  const char *p, *end = t->end;
+  unsigned long long m = 0;
+  int neg = 0, nd = 0, digits = 0, e = 0, x = 0, xneg = 0;
+  if (!lib_skip(t))
+    return 1;
+  p = t->ptr;
+  if (*p == '+' || *p == '-')
+  { neg = (*p == '-');
+    p++;
+  }
+  for (; p < end && isdigit((unsigned char) *p); p++, digits++)
+  { if (m != 0 || *p != '0')
+    { if (nd++ < 19)
+        m = 10 * m + (*p - '0');
+      else
+        e++;
+    }
+  }
+  if (p < end && *p == '.')
+  { for (p++; p < end && isdigit((unsigned char) *p); p++, digits++)
+    { if (m != 0 || *p != '0')
+      { if (nd++ < 19)
+        { m = 10 * m + (*p - '0');
+          e--;
+        }
+      }
+      else
+        e--;
+    }
+  }
+  if (digits > 0 && p < end && (*p == 'e' || *p == 'E'))
+  { const char *q = p + 1;
+    if (q < end && (*q == '+' || *q == '-'))
+    { xneg = (*q == '-');
+      q++;
+    }
+    if (q < end && isdigit((unsigned char) *q))
+    { for (; q < end && isdigit((unsigned char) *q); q++)
+      { if (x < 10000)
+          x = 10 * x + (*q - '0');
+      }
+      e += (xneg ? -x : x);
+      p = q;
+    }
+  }
+  if (digits > 0 && nd <= 19 && m <= ((unsigned long long) 1 << 53)
+      && e >= -22 && e <= 22 && (p >= end
+      || !(isalnum((unsigned char) *p) || *p == '.')))
+  { double v = (double) m;
+    v = (e < 0 ? v / pow10[-e] : v * pow10[e]);
+    *val = (neg ? -v : v);
+    t->ptr = p;
+    return 0;
+  }
+  /* anything else: hexadecimal, inf, nan, long mantissas, ... */
+  { char tok[128], *q;
+    int k;
+    for (k = 0, p = t->ptr; k < (int) sizeof(tok) - 1 && p < end
+        && !isspace((unsigned char) *p); k++, p++)
+      tok[k] = *p;
+    tok[k] = '\0';
+    *val = strtod(tok, &q);
+    if (q == tok)
+      return 1;
+    t->ptr += q - tok;
+  }
+  return 0;
+}
+
+/* The EDGE_WEIGHT_SECTION is stored straight into the lower triangular
+ * matrix data->adj, whatever its format: the entry of row r and column
+ * c of the section is the length of the edge {r, c}, kept in adj[r][c]
+ * for a LOWER_DIAG_ROW and in adj[c][r] for the upper formats; of a
+ * FULL_MATRIX, only the entries with c >= r are kept, as before.
+ *
+ * The section is cut at white space into chunks of about LIB_CHUNK
+ * bytes, whose numbers are first counted in parallel, so that every
+ * chunk knows the entry of its first number and is converted by its
+ * own thread. A section which is not all plain integers is read again
+ * sequentially by lib_int, which stops where fscanf did. */
 
-static int read_lib( compass_prob *prob, compass_file *fp)
+#define LIB_CHUNK (1 << 20)
+/* bytes per chunk */
+#define LIB_CHUNKS 1024
+/* at most as many chunks */
+
+struct lib_matrix
+{ /* edge weight section converted in chunks */
+  int **adj;
+  /* data->adj */
+  int n;
+  /* number of nodes */
+  int form;
+  /* MATRIX_LOWER_DIAG_ROW, ..., MATRIX_FULL_MATRIX */
+  const char *beg;
+  /* first byte of the section */
+  const char **cut;
+  /* chunk k is the text from cut[k] to cut[k+1] */
+  long long *first;
+  /* number of numbers in chunk k while counting; then the number of the
+     entry of its first number */
+  int *lines;
+  /* number of newlines in chunk k */
+  int bad;
+  /* set if some number is not a plain integer */
+};
+
+static void lib_row (int n, int form, int r, int *c0, int *c1)
+{ /* row r of the section has the entries of columns c0, ..., c1-1 */
+  *c0 = (form == MATRIX_UPPER_ROW ? r + 1 :
+      form == MATRIX_UPPER_DIAG_ROW ? r : 0);
+  *c1 = (form == MATRIX_LOWER_DIAG_ROW ? r + 1 : n);
+  return;
+}
+
+static void lib_count_chunk (void *info, int tid, int k)
+{ /* count the numbers starting in chunk k, and its newlines */
+  struct lib_matrix *m = info;
+  const char *p = m->cut[k], *end = m->cut[k+1];
+  long long cnt = 0;
+  int lines = 0, ws = (p == m->beg || isspace((unsigned char) p[-1]));
+  xassert(tid == tid);
+  for (; p < end; p++)
+  { if (isspace((unsigned char) *p))
+    { if (*p == '\n')
+        lines++;
+      ws = 1;
+    }
+    else
+    { if (ws)
+        cnt++;
+      ws = 0;
+    }
+  }
+  m->first[k] = cnt;
+  m->lines[k] = lines;
+  return;
+}
+
+static void lib_matrix_chunk (void *info, int tid, int k)
+{ /* convert the numbers of chunk k into the matrix */
+  struct lib_matrix *m = info;
+  const char *p = m->cut[k], *end = m->cut[k+1];
+  long long e = m->first[k];
+  int r, c, c0 = 0, c1 = 0, val;
+  xassert(tid == tid);
+  for (r = 0; r < m->n; r++)
+  { lib_row(m->n, m->form, r, &c0, &c1);
+    if (e < c1 - c0)
+      break;
+    e -= c1 - c0;
+  }
+  c = c0 + (int) e;
+  for (;;)
+  { while (p < end && isspace((unsigned char) *p))
+      p++;
+    if (p >= end)
+      break;
+    p = lib_atoi(p, end, &val);
+    if (p == NULL || (p < end && !isspace((unsigned char) *p)))
+    { m->bad = 1;
+      break;
+    }
+    if (m->form == MATRIX_LOWER_DIAG_ROW)
+      m->adj[r][c] = val;
+    else if (c >= r)
+      m->adj[c][r] = val;
+    if (++c == c1)
+    { do
+      { r++;
+        lib_row(m->n, m->form, r, &c0, &c1);
+      } while (c0 >= c1 && r < m->n);
+      c = c0;
+    }
+  }
+  return;
+}
+
+static int lib_matrix (compass_data *data, int n, int form, lib_text *t)
+{ /* read the edge weight section into data->adj; non-zero if there is
+   * a number missing */
+  struct lib_matrix m;
+  const char *p;
+  size_t len = t->end - t->ptr;
+  long long need, cnt;
+  int k, r, c, c0, c1, val, ws, nchunks;
+  if (form == MATRIX_UPPER_ROW)
+  { for (r = 0; r < n; r++)
+      data->adj[r][r] = 0;
+  }
+  need = (long long) n * (n + 1) / 2;
+  if (form == MATRIX_UPPER_ROW)
+    need -= n;
+  else if (form == MATRIX_FULL_MATRIX)
+    need = (long long) n * n;
+  nchunks = (len / LIB_CHUNK < LIB_CHUNKS ? (int) (len / LIB_CHUNK) + 1 :
+      LIB_CHUNKS);
+  m.adj = data->adj;
+  m.n = n;
+  m.form = form;
+  m.beg = t->ptr;
+  m.cut = talloc(nchunks + 1, const char *);
+  m.first = talloc(nchunks, long long);
+  m.lines = talloc(nchunks, int);
+  m.bad = 0;
+  m.cut[0] = t->ptr;
+  for (k = 1; k < nchunks; k++)
+  { p = t->ptr + (size_t) ((double) len * k / nchunks);
+    if (p < m.cut[k-1])
+      p = m.cut[k-1];
+    while (p < t->end && !isspace((unsigned char) *p))
+      p++;
+    m.cut[k] = p;
+  }
+  m.cut[nchunks] = t->end;
+  xparallel(0, nchunks, lib_count_chunk, &m);
+  /* find the chunk of the last entry, and end the section after it */
+  for (k = 0, cnt = 0; k < nchunks; k++)
+  { long long num = m.first[k];
+    m.first[k] = cnt;
+    if (cnt + num >= need)
+      break;
+    cnt += num;
+  }
+  if (k < nchunks)
+  { p = m.cut[k];
+    ws = (p == m.beg || isspace((unsigned char) p[-1]));
+    m.lines[k] = 0;
+    for (cnt = need - cnt; cnt > 0; p++)
+    { if (isspace((unsigned char) *p))
+      { if (*p == '\n')
+          m.lines[k]++;
+        ws = 1;
+      }
+      else
+      { if (ws)
+          cnt--;
+        ws = 0;
+      }
+    }
+    if (need > 0)
+    { while (p < t->end && !isspace((unsigned char) *p))
+        p++;
+    }
+    m.cut[k+1] = p;
+    nchunks = k + 1;
+    xparallel(0, nchunks, lib_matrix_chunk, &m);
+    if (!m.bad)
+    { for (k = 0; k < nchunks; k++)
+        t->line += m.lines[k];
+      t->ptr = p;
+    }
+  }
+  else
+    m.bad = 1;
+  tfree(m.cut);
+  tfree(m.first);
+  tfree(m.lines);
+  if (!m.bad)
+    return 0;
+  /* not all plain integers, or too few: read them one by one */
+  for (r = 0; r < n; r++)
+  { lib_row(n, form, r, &c0, &c1);
+    for (c = c0; c < c1; c++)
+    { if (lib_int(t, &val))
+        return 1;
+      if (form == MATRIX_LOWER_DIAG_ROW)
+        data->adj[r][c] = val;
+      else if (c >= r)
+        data->adj[c][r] = val;
+    }
+  }
+  return 0;
+}
+
+static int read_lib (compass_prob *prob, lib_text *t)
 { compass_data *data = prob->data;
+  struct op_prob *op = prob->op;
   int matrixform = MATRIX_LOWER_DIAG_ROW;
   int scoresform = SCORES_FIXED;
   char buf[256], key[256], field[256];
   char *p,*q;
+  double d0 = 0.0;
+  int have_d0 = 0;
   xprintf("\n");
-  while (fgets (buf, 254,  (FILE *) fp->file) != (char *) NULL)
+  while (lib_getline (t, buf, LIB_LINE))
   { p = buf;
     while (*p != '\0')
     { if (*p == ':')
@@ -133,22 +465,14 @@ static int read_lib( compass_prob *prob, compass_file *fp)
       while (*p == ' ')
         p++;
       if (!strcmp (key, "NAME"))
-      { //if (p[strlen(p)-2]=='\r')
-        //  strncpy(prob->name , p,strlen(p)-2);
-        //else
-       if (p[strlen(p)-2]=='\r')
-       { p[strlen(p)-2] = '\0';
-          strcpy(prob->name , p);
-       }
-       if (p[strlen(p)-1]=='\n')
-       { p[strlen(p)-1] = '\0';
-          strcpy(prob->name , p);
-                }
-       else {
-         p[strlen(p)-2] = '\0';
-          strcpy(prob->name , p);
-       }
-        for (q = prob->name; q != '\0'; q++)
+      { int len = strlen (p);
+        while (len > 0 && isspace((unsigned char) p[len-1]))
+          len--;
+        if (len > 99)
+          len = 99;
+        memcpy (prob->name, p, len);
+        prob->name[len] = '\0';
+        for (q = prob->name; *q != '\0'; q++)
           *q = (char) tolower(*q);
         xprintf ("  Problem Name: %s\n", prob->name);
       }
@@ -179,29 +503,12 @@ static int read_lib( compass_prob *prob, compass_file *fp)
         xprintf ("  Number of Nodes: %d\n", prob->n);
         compass_tsp_init_prob(prob);
         compass_op_init_prob(prob);
+        op = prob->op;
       }
-    }
-  }
-
-  struct tsp_prob *tsp = prob->tsp;
-  struct op_prob *op = prob->op;
-  rewind(fp->file);
-  while (fgets (buf, 254,  (FILE *) fp->file) != (char *) NULL)
-  { p = buf;
-    while (*p != '\0')
-    { if (*p == ':')
-        *p = ' ';
-      p++;
-    }
-    p = buf;
-    if (sscanf (p, "%s", key) != EOF)
-    { p += strlen (key);
-      while (*p == ' ')
-        p++;
 #if 0
 /*--------------------------------------------------------------------------*/
 /* TSP Solution */
-      if (!strcmp (key, "TSP_SOLUTION"))
+      else if (!strcmp (key, "TSP_SOLUTION"))
       { double tspsol;
         if (sscanf (p, "%s", field) == EOF)
           xprintf ("Not explicit TSP_SOLUTION\n");
@@ -213,13 +520,12 @@ static int read_lib( compass_prob *prob, compass_file *fp)
 #endif
 /*--------------------------------------------------------------------------*/
 /* D0 */
-      if (!strcmp (key, "COST_LIMIT"))
-      { double d0;
-        if (sscanf (p, "%s", field) == EOF)
+      else if (!strcmp (key, "COST_LIMIT"))
+      { if (sscanf (p, "%s", field) == EOF)
           xprintf ("Not explicit COST_LIMIT\n");
         str2num (field, &d0);
-        prob->op->d0 = d0;
-        xprintf ("  Cost limit: %.2f\n", op->d0);
+        have_d0 = 1;
+        xprintf ("  Cost limit: %.2f\n", d0);
       }
 /*--------------------------------------------------------------------------*/
 /* Edge Weight Type */
@@ -317,7 +623,7 @@ static int read_lib( compass_prob *prob, compass_file *fp)
 /*--------------------------------------------------------------------------*/
 /* Node coordinates section */
       else if (!strcmp (key, "NODE_COORD_SECTION"))
-      { int i;
+      { int i, id;
         if (prob->n <= 0)
         { put_err_msg ( "ERROR: Dimension not specified\n");
           return 1;
@@ -329,61 +635,39 @@ static int read_lib( compass_prob *prob, compass_file *fp)
         }
         if ((data->norm & CC_NORM_SIZE_BITS) == CC_D2_NORM_SIZE)
         { data->x = xcalloc (prob->n, sizeof(double));
-          if (!data->x)
-          { compass_erase_prob(prob);
-            return 1;
-          }
           data->y = xcalloc (prob->n, sizeof(double));
-          if (!data->y)
-          { compass_erase_prob(prob);
-            return 1;
-          }
           for (i = 0; i < prob->n; i++)
-           fscanf ((FILE *)fp->file, "%*d %lf %lf", &(data->x[i]), &(data->y[i]));
+          { if (lib_int (t, &id) || lib_num (t, &(data->x[i]))
+                || lib_num (t, &(data->y[i])))
+              goto badnum;
+          }
         } else if ((data->norm & CC_NORM_SIZE_BITS) == CC_D3_NORM_SIZE)
         { data->x = xcalloc (prob->n, sizeof(double));
-          if (!data->x)
-          { compass_erase_prob(prob);
-            return 1;
-          }
-          data->y = xcalloc(prob->n, sizeof(double));
-          if (!data->y)
-          { compass_erase_prob(prob);
-            return 1;
-          }
-          data->z = xcalloc(prob->n, sizeof(double));
-          if (!data->z)
-          { compass_erase_prob(prob);
-            return 1;
-          }
+          data->y = xcalloc (prob->n, sizeof(double));
+          data->z = xcalloc (prob->n, sizeof(double));
           for (i = 0; i < prob->n; i++)
-           fscanf ((FILE *)fp->file, "%*d %lf %lf %lf", &(data->x[i]),
-               &(data->y[i]), &(data->z[i]));
+          { if (lib_int (t, &id) || lib_num (t, &(data->x[i]))
+                || lib_num (t, &(data->y[i])) || lib_num (t, &(data->z[i])))
+              goto badnum;
+          }
         }
+        /* the GEO norms precompute their nodes from the coordinates */
+        compass_data_set_norm(data, data->norm);
       }
 /*--------------------------------------------------------------------------*/
 /* Node scores section */
       else if (!strcmp (key, "NODE_SCORE_SECTION"))
-      { int i;
+      { int i, id;
         if (prob->n <= 0)
         { put_err_msg ( "ERROR: Dimension not specified\n");
           return 1;
         }
-#if 0
-        if (op->s != (double *) NULL)
-        { put_err_msg ( "ERROR: A second NODE_SCORES_SECTION?\n");
-          compass_erase_prob(prob);
-          return 1;
-        }
-#endif
         if (scoresform == SCORES_FIXED)
         { op->s = xcalloc (prob->n, sizeof(double));
-          if (!op->s)
-          { compass_erase_prob(prob);
-            return 1;
-          }
           for (i = 0; i < prob->n; i++)
-            fscanf ((FILE *)fp->file, "%*d %lf", &(op->s[i]));
+          { if (lib_int (t, &id) || lib_num (t, &(op->s[i])))
+              goto badnum;
+          }
         }
         if (scoresform == SCORES_FSGRANDOM)
         { put_err_msg ( "FSG_RAND not implemented yet!\n");
@@ -406,58 +690,12 @@ static int read_lib( compass_prob *prob, compass_file *fp)
         if ((data->norm & CC_NORM_SIZE_BITS) == CC_MATRIX_NORM_SIZE)
         { data->adj = xcalloc (prob->n, sizeof(int *));
           data->adjspace = xcalloc ((prob->n)*(prob->n+1)/2, sizeof(int));
-          if (data->adj == (int **) NULL || data->adjspace == (int *) NULL)
-          { compass_erase_prob(prob);
-            return 1;
-          }
           for (i = 0, j = 0; i < prob->n; i++)
           { data->adj[i] = data->adjspace + j;
             j += (i+1);
           }
-          if (matrixform == MATRIX_LOWER_DIAG_ROW)
-          { for (i = 0; i < prob->n; i++)
-            { for (j = 0; j <= i; j++)
-                fscanf ((FILE *)fp->file, "%d", &(data->adj[i][j]));
-            }
-          } else if (matrixform == MATRIX_UPPER_ROW ||
-              matrixform == MATRIX_UPPER_DIAG_ROW ||
-              matrixform == MATRIX_FULL_MATRIX)
-          {
-            int **tempadj = (int **) NULL;
-            int *tempadjspace = (int *) NULL;
-            tempadj = xcalloc (prob->n, sizeof(int *) );
-            tempadjspace = xcalloc ((prob->n) * (prob->n), sizeof(int));
-            if (tempadj == (int **) NULL || tempadjspace == (int *) NULL)
-            {
-              xfree (tempadj);
-              xfree (tempadjspace);
-              compass_erase_prob(prob);
-              return 1;
-            }
-            for (i = 0; i < prob->n; i++)
-            { tempadj[i] = tempadjspace + i * (prob->n);
-              if (matrixform == MATRIX_UPPER_ROW)
-              { tempadj[i][i] = 0;
-                for (j = i + 1; j < prob->n; j++)
-                  fscanf ((FILE *)fp->file, "%d", &(tempadj[i][j]));
-              }
-              else if (matrixform == MATRIX_UPPER_DIAG_ROW)
-              { for (j = i; j < prob->n; j++)
-                  fscanf ((FILE *)fp->file, "%d", &(tempadj[i][j]));
-              }
-              else
-              {
-                for (j = 0; j < prob->n; j++)
-                  fscanf ((FILE *)fp->file, "%d", &(tempadj[i][j]));
-              }
-            }
-            for (i = 0; i < prob->n; i++)
-            { for (j = 0; j <= i; j++)
-                data->adj[i][j] = tempadj[j][i];
-            }
-            xfree (tempadjspace);
-            xfree (tempadj);
-          }
+          if (lib_matrix (data, prob->n, matrixform, t))
+            goto badnum;
         }
         else
         { put_err_msg ( "ERROR: Matrix with norm %d?\n", data->norm);
@@ -473,41 +711,394 @@ static int read_lib( compass_prob *prob, compass_file *fp)
     }
   }
 
+  if (have_d0 && op != NULL)
+    op->d0 = d0;
   if (data->x == (double *) NULL && data->adj == (int **) NULL)
   { put_err_msg ( "ERROR: Didn't find the data\n");
     return 1;
   }
   else
     return 0;
+badnum:
+  put_err_msg ( "ERROR: line %d: number expected in %s\n", t->line, key);
+  return 1;
 }
 
+/* map the file fname in memory, or read it all if it cannot be mapped
+ * (a stream, a special file, a compressed file decompressed by
+ * compass_open); *len is its size in bytes and *mapped is set if the
+ * text must be released with munmap rather than xfree */
 
-int compass_read_prob(compass_prob *prob, int flags, const char *fname)
+static char *lib_load (const char *fname, size_t *len, int *mapped)
+{ compass_file *fp;
+  char *text;
+  const char *ext = strrchr(fname, '.');
+  size_t size;
+  int cnt;
+#ifdef HAVE_SYS_MMAN_H
+  if (strncmp(fname, "/dev/", 5) != 0 && !(ext != NULL
+      && (strcmp(ext, ".gz") == 0 || strcmp(ext, ".zst") == 0)))
+  { int fd = open(fname, O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+        && st.st_size > 0)
+    { text = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE,
+          MAP_PRIVATE, fd, 0);
+      if (text != MAP_FAILED)
+      { madvise(text, (size_t) st.st_size, MADV_SEQUENTIAL);
+        close(fd);
+        *len = (size_t) st.st_size;
+        *mapped = 1;
+        return text;
+      }
+    }
+    if (fd >= 0)
+      close(fd);
+  }
+#endif
+  fp = compass_open(fname, "r");
+  if (fp == NULL)
+    return NULL;
+  size = 1048576;
+  text = xmalloc(size);
+  *len = 0;
+  for (;;)
+  { if (*len == size)
+    { char *more = xmalloc(2 * size);
+      memcpy(more, text, size);
+      xfree(text);
+      text = more;
+      size *= 2;
+    }
+    cnt = compass_read(fp, text + *len, (int) (size - *len < INT_MAX ?
+        size - *len : INT_MAX));
+    if (cnt < 0)
+    { xfree(text);
+      compass_close(fp);
+      return NULL;
+    }
+    if (cnt == 0)
+      break;
+    *len += cnt;
+  }
+  compass_close(fp);
+  *mapped = 0;
+  return text;
+}
+
+/* A binary problem file (see compass_write_bin) starts with a bin_header
+ * and holds the arrays of the problem at the offsets it gives, aligned
+ * on BIN_ALIGN bytes and in the byte order of the machine which wrote
+ * it, so that a mapped file is used in place. */
+
+#define BIN_MAGIC    "COMPASSB"
+#define BIN_VERSION  1
+#define BIN_ORDER    0x01020304
+#define BIN_ALIGN    64
+
+struct bin_header
+{ char magic[8];
+  /* BIN_MAGIC */
+  int version;
+  /* BIN_VERSION */
+  int order;
+  /* BIN_ORDER, to detect a file of another byte order */
+  int n;
+  /* number of nodes */
+  int norm;
+  /* norm of the edge lengths */
+  int from, to;
+  /* departure and arrival nodes */
+  double d0;
+  /* cost limit */
+  long long off_x, off_y, off_z, off_s, off_adj;
+  /* offsets of the coordinates x, y and z and of the scores s (n
+     doubles each), and of the lower triangular matrix (n*(n+1)/2 ints,
+     explicit norms only); 0 if the array is absent */
+  unsigned char hash[32];
+  /* hash of the problem */
+  char name[100];
+  /* name of the problem */
+};
+
+#define bin_align(off) (((off) + BIN_ALIGN - 1) / BIN_ALIGN * BIN_ALIGN)
+
+/* non-zero if the array of size bytes at offset off is in a file of len
+ * bytes, or absent (off = 0) */
+static int bin_array (long long off, size_t size, size_t len)
+{ return off == 0 || (off > 0 && off % BIN_ALIGN == 0
+      && (size_t) off <= len && size <= len - (size_t) off);
+}
+
+/* the array of size bytes at offset off of text: in place if the file
+ * is mapped, a copy otherwise; NULL if absent */
+static void *bin_ptr (char *text, long long off, size_t size, int mapped)
+{ void *p;
+  if (off == 0)
+    return NULL;
+  if (mapped)
+    return text + off;
+  p = xmalloc(size);
+  memcpy(p, text + off, size);
+  return p;
+}
+
+static int read_bin (compass_prob *prob, char *text, size_t len, int mapped)
 { compass_data *data = prob->data;
-  compass_file *fp;
+  struct bin_header h;
+  size_t n, tri;
+  int i, j;
+  memcpy(&h, text, sizeof(h));
+  if (h.version != BIN_VERSION || h.order != BIN_ORDER)
+  { put_err_msg("ERROR: binary file of version %d or of another byte "
+        "order\n", h.version);
+    return 1;
+  }
+  n = (size_t) h.n;
+  tri = n * (n + 1) / 2;
+  if (h.n <= 0 || h.from < 0 || h.from >= h.n || h.to < 0 || h.to >= h.n
+      || !bin_array(h.off_x, n * sizeof(double), len)
+      || !bin_array(h.off_y, n * sizeof(double), len)
+      || !bin_array(h.off_z, n * sizeof(double), len)
+      || !bin_array(h.off_s, n * sizeof(double), len)
+      || !bin_array(h.off_adj, tri * sizeof(int), len)
+      || (h.off_x == 0 && h.off_adj == 0))
+  { put_err_msg("ERROR: truncated or invalid binary file\n");
+    return 1;
+  }
+  xprintf("\n");
+  h.name[sizeof(h.name) - 1] = '\0';
+  strcpy(prob->name, h.name);
+  xprintf("  Problem Name: %s\n", prob->name);
+  xprintf("  Binary file (version %d)\n", h.version);
+  prob->n = h.n;
+  data->n = h.n;
+  xprintf("  Number of Nodes: %d\n", prob->n);
+  compass_tsp_init_prob(prob);
+  compass_op_init_prob(prob);
+  prob->op->d0 = h.d0;
+  prob->op->from = h.from;
+  prob->op->to = h.to;
+  xprintf("  Cost limit: %.2f\n", prob->op->d0);
+  data->x = bin_ptr(text, h.off_x, n * sizeof(double), mapped);
+  data->y = bin_ptr(text, h.off_y, n * sizeof(double), mapped);
+  data->z = bin_ptr(text, h.off_z, n * sizeof(double), mapped);
+  if (h.off_s != 0)
+  { xfree(prob->op->s);
+    prob->op->s = bin_ptr(text, h.off_s, n * sizeof(double), mapped);
+  }
+  if (h.off_adj != 0)
+  { data->adjspace = bin_ptr(text, h.off_adj, tri * sizeof(int), mapped);
+    data->adj = xcalloc(h.n, sizeof(int *));
+    for (i = 0, j = 0; i < h.n; i++)
+    { data->adj[i] = data->adjspace + j;
+      j += (i+1);
+    }
+  }
+  if (mapped)
+  { data->map = text;
+    data->maplen = len;
+#ifdef HAVE_SYS_MMAN_H
+    madvise(text, len, MADV_NORMAL);
+#endif
+  }
+  if (compass_data_set_norm(data, h.norm))
+    return 1;
+  memcpy(prob->hash, h.hash, sizeof(h.hash));
+  prob->hashed = 1;
+  return 0;
+}
+
+/***********************************************************************
+*  NAME
+*
+*  compass_read_prob - read Orienteering Problem data in LIB format
+*
+*  SYNOPSIS
+*
+*  int compass_read_prob(compass_prob *prob, int flags, const char *fname);
+*
+*  DESCRIPTION
+*
+*  The routine compass_read_prob reads Orienteering Problem data in LIB
+*  format (flags is FMT_LIB_FILE) from a text file.
+*
+*  The character string fname specifies a name of the text file to be
+*  read. The file is mapped in memory, when possible, and parsed in one
+*  pass. If flags also has the bit FMT_LOAD_STATS, the routine reports
+*  the size of the file and the speed at which it was loaded.
+*
+*  A binary file written by the routine compass_write_bin is recognized
+*  by its header. Its arrays are used in place if the file is mapped,
+*  and copied otherwise; the hash of the problem is read with it.
+*
+*  RETURNS
+*
+*  If the operation was successful, the routine compass_read_prob returns
+*  zero. Otherwise, it prints an error message and returns non-zero. */
+
+int compass_read_prob(compass_prob *prob, int flags, const char *fname)
+{ lib_text t;
+  char *text;
+  size_t len;
+  int mapped, ret = 1;
+  double tm_beg;
   if (prob == NULL || prob->magic != COMPASS_PROB_MAGIC)
-  { put_err_msg("glp_read_prob: prob = %p; invalid problem object\n", prob);
+  { put_err_msg("compass_read_prob: prob = %p; invalid problem object\n",
+        prob);
     goto done;
   }
   if (fname == NULL)
-  { put_err_msg("glp_read_prob: fname = %d; invalid parameter\n", fname);
+  { put_err_msg("compass_read_prob: fname = %d; invalid parameter\n",
+        fname);
     goto done;
   }
   xprintf("\n");
   xprintf("Reading problem data from '%s'...\n", fname);
-  fp = compass_open(fname, "r");
-  if (fp == NULL)
+  tm_beg = xtime();
+  text = lib_load(fname, &len, &mapped);
+  if (text == NULL)
   { xprintf("Unable to open '%s' - %s\n", fname, get_err_msg());
     goto done;
   }
-  /* read problem line */
-  if (flags == FMT_LIB_FILE)
-    read_lib(prob, fp);
+  t.ptr = text;
+  t.end = text + len;
+  t.line = 1;
+  if (len >= sizeof(struct bin_header)
+      && memcmp(text, BIN_MAGIC, strlen(BIN_MAGIC)) == 0)
+    ret = read_bin(prob, text, len, mapped);
+  else if ((flags & ~FMT_LOAD_STATS) == FMT_LIB_FILE)
+    ret = read_lib(prob, &t);
+  else
+    put_err_msg("compass_read_prob: flags = %d; invalid parameter\n",
+        flags);
+  if (ret != 0)
+    xprintf("%s", get_err_msg());
+  if (prob->data->map != text)
+  { /* the text is not used in place by a binary file */
+#ifdef HAVE_SYS_MMAN_H
+    if (mapped)
+      munmap(text, len);
+    else
+#endif
+      xfree(text);
+  }
+  if (ret == 0 && (flags & FMT_LOAD_STATS))
+  { double tm = xdifftime(xtime(), tm_beg);
+    xprintf("  Loaded %.1f Mb in %.3f secs (%.1f Mb/sec, %s)\n",
+        (double) len / 1048576.0, tm,
+        tm > 0.0 ? (double) len / 1048576.0 / tm : 0.0,
+        mapped ? "mapped" : "read");
+  }
+done:
+  return ret;
+}
 
+/***********************************************************************
+*  NAME
+*
+*  compass_write_bin - write problem data in binary format
+*
+*  SYNOPSIS
+*
+*  int compass_write_bin(compass_prob *prob, const char *fname);
+*
+*  DESCRIPTION
+*
+*  The routine compass_write_bin writes the problem data (name, hash,
+*  cost limit, depot, coordinates, scores and explicit matrix) to a
+*  binary file, which compass_read_prob maps in memory and uses without
+*  parsing nor copying; the processes which read the same file share its
+*  pages. The file is only read back on machines with the same byte
+*  order.
+*
+*  The problem must be as read, its nodes not renumbered nor its edge
+*  lengths precomputed (see compass_data_build_table).
+*
+*  RETURNS
+*
+*  If the operation was successful, the routine compass_write_bin returns
+*  zero. Otherwise, it prints an error message and returns non-zero. */
 
-  compass_close(fp);
+/* write the size bytes of p at offset off of the file, padding it with
+ * zeros from offset *pos */
+static int bin_write (compass_file *fp, long long *pos, long long off,
+    const void *p, size_t size)
+{ static const char zero[BIN_ALIGN];
+  size_t k, cnt;
+  if (off == 0)
+    return 0;
+  if (off > *pos && compass_write(fp, zero, (int) (off - *pos)) < 0)
+    return 1;
+  for (k = 0; k < size; k += cnt)
+  { cnt = size - k < 1073741824 ? size - k : 1073741824;
+    if (compass_write(fp, (const char *) p + k, (int) cnt) < 0)
+      return 1;
+  }
+  *pos = off + (long long) size;
+  return 0;
+}
+
+int compass_write_bin(compass_prob *prob, const char *fname)
+{ compass_data *data = prob->data;
+  struct bin_header h;
+  compass_file *fp;
+  size_t n = (size_t) prob->n;
+  long long off, pos;
+  int ret = 1;
+  xprintf("\n");
+  xprintf("Writing binary problem data to '%s'...\n", fname);
+  if (data->orig != (compass_data *) NULL || prob->node_id != (int *) NULL
+      || prob->op == NULL || (data->adj != (int **) NULL
+      && (data->norm & CC_NORM_SIZE_BITS) != CC_MATRIX_NORM_SIZE))
+  { xprintf("Unable to write '%s' - problem not as read\n", fname);
+    return 1;
+  }
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, BIN_MAGIC, sizeof(h.magic));
+  h.version = BIN_VERSION;
+  h.order = BIN_ORDER;
+  h.n = prob->n;
+  h.norm = data->norm;
+  h.from = prob->op->from;
+  h.to = prob->op->to;
+  h.d0 = prob->op->d0;
+  memcpy(h.hash, prob->hash, sizeof(h.hash));
+  strncpy(h.name, prob->name, sizeof(h.name) - 1);
+  off = bin_align((long long) sizeof(h));
+  if (data->x != (double *) NULL)
+    h.off_x = off, off = bin_align(off + n * sizeof(double));
+  if (data->y != (double *) NULL)
+    h.off_y = off, off = bin_align(off + n * sizeof(double));
+  if (data->z != (double *) NULL)
+    h.off_z = off, off = bin_align(off + n * sizeof(double));
+  if (prob->op->s != (double *) NULL)
+    h.off_s = off, off = bin_align(off + n * sizeof(double));
+  if (data->adj != (int **) NULL)
+    h.off_adj = off;
+  fp = compass_open(fname, "wb");
+  if (fp == NULL)
+  { xprintf("Unable to create '%s' - %s\n", fname, get_err_msg());
+    return 1;
+  }
+  pos = (long long) sizeof(h);
+  if (compass_write(fp, &h, sizeof(h)) < 0
+      || bin_write(fp, &pos, h.off_x, data->x, n * sizeof(double))
+      || bin_write(fp, &pos, h.off_y, data->y, n * sizeof(double))
+      || bin_write(fp, &pos, h.off_z, data->z, n * sizeof(double))
+      || bin_write(fp, &pos, h.off_s, prob->op->s, n * sizeof(double))
+      || bin_write(fp, &pos, h.off_adj, data->adjspace,
+         n * (n + 1) / 2 * sizeof(int)))
+  { xprintf("Unable to write '%s' - %s\n", fname, get_err_msg());
+    goto done;
+  }
+  ret = 0;
 done:
-   return 0;
+  if (compass_close(fp) != 0 && ret == 0)
+  { xprintf("Unable to write '%s' - %s\n", fname, get_err_msg());
+    ret = 1;
+  }
+  return ret;
 }
 
 /*******************************************************************************
@@ -559,11 +1150,15 @@ int compass_write_op_sol(compass_prob *prob, const char *fname)
   xfprintf (fp, "ROUTE_SCORE : %.2f\n", sol->val );
   xfprintf (fp, "ROUTE_COST : %.2f\n", sol->length );
   xfprintf (fp, "NODE_SEQUENCE_SECTION\n");
+  /* nodes renumbered by compass_spacefill_prob are written with their
+   * numbers in the input file */
   for ( i=0; i< sol->ns; i++)
-    xfprintf (fp, "%d\n", sol->cycle[i] +1 );
+    xfprintf (fp, "%d\n", (prob->node_id != NULL ?
+        prob->node_id[sol->cycle[i]] : sol->cycle[i]) +1 );
   xfprintf (fp, "-1\n");
   xfprintf (fp, "DEPOT_SECTION\n");
-  xfprintf (fp, "%d\n",prob->op->from+1);
+  xfprintf (fp, "%d\n", (prob->node_id != NULL ?
+      prob->node_id[prob->op->from] : prob->op->from) +1);
   xfprintf (fp, "-1\n");
   xfprintf (fp, "EOF\n");
 
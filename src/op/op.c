@@ -39,6 +39,7 @@ int compass_op_solve (compass_prob *prob, struct op_cp *opcp)
     compass_op_init_pop (prob, op->population, opcp->pop_size );
     op->population->stop_per = opcp->stop_pop;
     compass_op_start_population (prob, op->population, opcp);
+    opcp->pop_size = op->population->size;
     best_sol = &op->population->solution[op->population->best_ind];
     compass_op_copy_sol(prob, best_sol, opcp->initcp->best);
     opcp->initcp->tm_end = xtime();
@@ -60,7 +61,10 @@ int compass_op_solve (compass_prob *prob, struct op_cp *opcp)
     { xprintf("\n");
       xprintf("op   : Starting the Evolutionary Algorithm...\n");
     }
-    compass_op_solve_ea (prob, op->population, opcp);
+    if (opcp->eacp->nislands > 1)
+      compass_op_solve_ea_islands (prob, op->population, opcp);
+    else
+      compass_op_solve_ea (prob, op->population, opcp);
   }
 #if 0
   else if ( opcp->heur_tech == OP_HEUR_2PIA)
@@ -18,6 +18,7 @@
 #ifndef OP_H
 #define OP_H
 #include "env.h"
+#include "util/util.h"
 #include "tsp/tsp.h"
 #include "op/init/init.h"
 #include "op/ea/ea.h"
@@ -30,6 +31,11 @@ typedef struct op_population op_population;
 struct op_solution
 { int         tot_n;
   int         *genotype;
+  /* genotype[v] is the successor of v in the tour, v if v is not
+     visited */
+  int         *pred;
+  /* pred[v] is the predecessor of v in the tour, v if v is not
+     visited */
   int         *cycle;
   int         *selected;
   int         *sposition;
@@ -38,6 +44,11 @@ struct op_solution
   int         ns;
   int         greedycount;
   int         *greedylist;
+  int         *touched;
+  /* touched[0..ntouched-1] are the nodes whose tour edges changed since
+     the tour was last improved by the local search */
+  int         ntouched;
+  /* -1 if the whole tour has to be improved */
 };
 
 struct op_population
@@ -45,6 +56,7 @@ struct op_population
   int         stop_per;
   struct op_solution *solution;
   int         *rankperm;
+  double      *values;
   double      mean_val;
   double      best_val;
   int         best_ind;
@@ -135,4 +147,13 @@ struct op_cp
   const char *stats_file;
 };
 
+struct compass_prob;
+
+void compass_op_copy_sol(struct compass_prob *prob, op_solution *insol,
+    op_solution *outsol);
+/* copy solution insol to outsol */
+
+void compass_op_swap_sol(op_solution *sol1, op_solution *sol2);
+/* exchange the contents of two solutions of the same problem */
+
 #endif
@@ -154,7 +154,8 @@ static void op_delete_prob(compass_prob *prob)
 { struct op_prob *op = prob->op;
   op->magic = 0x3F3F3F3F;
   xfree(op->noderank);
-  xfree(op->s);
+  if (!compass_data_mapped(prob->data, op->s))
+    xfree(op->s);
   if (op->elist != NULL) xfree (op->elist);
   compass_op_delete_sol (op->sol);
   return;
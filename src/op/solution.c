@@ -24,17 +24,21 @@ static void op_init_sol(int n, op_solution *sol)
 { int i;
   sol->tot_n       = n;
   sol->genotype    = xcalloc(n, sizeof(int));
+  sol->pred        = xcalloc(n, sizeof(int));
   sol->selected    = xcalloc(n, sizeof(int));
   sol->sposition   = xcalloc(n, sizeof(int));
   sol->cycle       = xcalloc(n, sizeof(int));
   sol->greedylist  = xcalloc(n, sizeof(int));
+  sol->touched     = xcalloc(n, sizeof(int));
   sol->greedycount = n;
+  sol->ntouched    = -1;
   sol->val=0.0;
   sol->length      = 1e30;
   sol->ns=0;
   for (i=0; i<n; i++)
   { sol->selected[i]   =  0;
     sol->genotype[i]   =  i;
+    sol->pred[i]       =  i;
     sol->cycle[i]      = -1;
     sol->sposition[i]  =  n;
     sol->greedylist[i] =  1;
@@ -48,15 +52,39 @@ void compass_op_init_sol(compass_prob *prob, op_solution *sol)
 
 static void op_delete_sol(op_solution *sol)
 { xfree(sol->genotype);
+  xfree(sol->pred);
   xfree(sol->selected);
   xfree(sol->sposition);
   xfree(sol->cycle);
   xfree(sol->greedylist);
+  xfree(sol->touched);
+}
+
+/* reset sol to the empty solution without reallocating its arrays */
+static void op_reset_sol(op_solution *sol)
+{ int i, n = sol->tot_n;
+  for (i=0; i<n; i++)
+  { sol->selected[i]   =  0;
+    sol->genotype[i]   =  i;
+    sol->pred[i]       =  i;
+    sol->cycle[i]      = -1;
+    sol->sposition[i]  =  n;
+    sol->greedylist[i] =  1;
+  }
+  sol->greedycount = n;
+  sol->ntouched    = -1;
+  sol->val         = 0.0;
+  sol->length      = 1e30;
+  sol->ns          = 0;
 }
 
 void compass_op_erase_sol(compass_prob *prob, op_solution *sol)
-{ op_delete_sol(sol);
-  op_init_sol(prob->n, sol);
+{ if (sol->tot_n == prob->n)
+    op_reset_sol(sol);
+  else
+  { op_delete_sol(sol);
+    op_init_sol(prob->n, sol);
+  }
   return;
 }
 
@@ -68,16 +96,22 @@ void compass_op_delete_sol(struct op_solution *sol)
 
 void compass_op_copy_sol(compass_prob *prob, op_solution *insol,
     op_solution *outsol)
-{ int i;
-  op_delete_sol(outsol);
-  op_init_sol(prob->n, outsol);
-  for (i=0; i<prob->n; i++)
-  { outsol->genotype[i]   = insol->genotype[i];
-    outsol->selected[i]   = insol->selected[i];
-    outsol->sposition[i]  = insol->sposition[i];
-    outsol->cycle[i]      = insol->cycle[i];
-    outsol->greedylist[i] = insol->greedylist[i];
+{ int n = prob->n;
+  if (insol == outsol)
+    return;
+  if (outsol->tot_n != n)
+  { op_delete_sol(outsol);
+    op_init_sol(n, outsol);
   }
+  memcpy(outsol->genotype,   insol->genotype,   n * sizeof(int));
+  memcpy(outsol->pred,       insol->pred,       n * sizeof(int));
+  memcpy(outsol->selected,   insol->selected,   n * sizeof(int));
+  memcpy(outsol->sposition,  insol->sposition,  n * sizeof(int));
+  memcpy(outsol->cycle,      insol->cycle,      n * sizeof(int));
+  memcpy(outsol->greedylist, insol->greedylist, n * sizeof(int));
+  if (insol->ntouched > 0)
+    memcpy(outsol->touched, insol->touched, insol->ntouched * sizeof(int));
+  outsol->ntouched    = insol->ntouched;
   outsol->val         = insol->val;
   outsol->length      = insol->length;
   outsol->ns          = insol->ns;
@@ -85,6 +119,16 @@ void compass_op_copy_sol(compass_prob *prob, op_solution *insol,
   return;
 }
 
+/* exchange the contents of two solutions of the same problem */
+void compass_op_swap_sol(op_solution *sol1, op_solution *sol2)
+{ op_solution temp;
+  xassert(sol1->tot_n == sol2->tot_n);
+  temp  = *sol1;
+  *sol1 = *sol2;
+  *sol2 = temp;
+  return;
+}
+
 
 
 static void op_init_pop( op_population *pop, int size)
@@ -92,6 +136,7 @@ static void op_init_pop( op_population *pop, int size)
   pop->size      = size;
   pop->solution  = talloc(size, struct op_solution );
   pop->rankperm  = xcalloc(size, sizeof(int));
+  pop->values    = xcalloc(size, sizeof(double));
   for(i=0; i<size; i++)
     pop->rankperm[i] = i;
   pop->mean_val  = 0.0;
@@ -129,12 +174,7 @@ void compass_op_set_pop_sol(compass_prob *prob, op_population *pop,
 
 static void op_update_pop ( op_population *pop)
 { int i, qstep, stoppos;
-  double *values;
-  values = xcalloc(pop->size, sizeof(double));
-  if (!values)
-  { put_err_msg("op | pop: Error updating population.\n");
-    goto cleanup;
-  }
+  double *values = pop->values;
   pop->mean_val = 0.0;
   for (i=0; i< pop->size; i++)
   { op_solution *sol = &pop->solution[i];
@@ -160,8 +200,6 @@ static void op_update_pop ( op_population *pop)
   }
   pop->worst_ind = pop->rankperm[0];
   pop->worst_val = values[pop->worst_ind];
-cleanup:
-  xfree(values);
   return;
 }
 
@@ -180,6 +218,7 @@ static void op_delete_pop(op_population *pop)
   }
   tfree(pop->solution);
   xfree(pop->rankperm);
+  xfree(pop->values);
 }
 
 void compass_op_erase_pop(op_population *pop)
@@ -196,71 +235,85 @@ void compass_op_delete_pop(op_population *pop)
   return;
 }
 
-void compass_convert_sol_op2tsp(compass_prob *prob, op_solution *opsol,
+/* convert the tour of opsol to a tour of the subproblem tspprob, built
+ * with compass_sub_prob from the nodes selected in opsol */
+void compass_convert_sol_op2tsp(compass_prob *tspprob, op_solution *opsol,
     tsp_solution *tspsol)
-{ int i,j;
+{ int i, k;
+  compass_data *data = tspprob->data;
+  xassert(data->orig != (compass_data *) NULL);
   for (i=0; i<opsol->ns; i++)
-  { for (j=0; j<opsol->ns; j++)
-    { if (opsol->sposition[j] == opsol->cycle[i])
-      { tspsol->cycle[i] = j; break; }
-    }
+  { if (opsol->cycle[i] < 0)
+      continue;
+    k = data->orig_pos[opsol->cycle[i]];
+    if (k >= 0)
+      tspsol->cycle[i] = k;
   }
   tspsol->val = opsol->length;
   return;
 }
 
-void compass_convert_sol_tsp2op(compass_prob *prob, tsp_solution *tspsol,
-    op_solution *opsol, int *selected)
-{ int i, j;
+/* replace the tour of opsol by the tour tspsol of the subproblem tspprob;
+ * opsol must visit the nodes of tspprob, and its entries sposition[k],
+ * k >= opsol->ns, must be prob->n */
+void compass_convert_sol_tsp2op(compass_prob *prob, compass_prob *tspprob,
+    tsp_solution *tspsol, op_solution *opsol)
+{ int i, v;
   int next, prev, ns;
-  int *tselected;
-  tselected = xcalloc(prob->n, sizeof(int));
-  for (i=0; i<prob->n;i++)
-    tselected[i] = selected[i];
-  compass_op_erase_sol(prob, opsol);
-  for (i=0; i<prob->n; i++)
-  { opsol->selected[i]  = tselected[i];
-    opsol->sposition[i] = prob->n;
-    opsol->genotype[i]  =  i;
+  int *names = tspprob->data->orig_names;
+  xassert(tspprob->data->orig == prob->data);
+  ns = tspprob->n;
+  for (i = 0; i < opsol->ns; i++)
+  { v = opsol->cycle[i];
+    if (v >= 0)
+    { opsol->genotype[v] = v;
+      opsol->pred[v]     = v;
+    }
     opsol->cycle[i]     = -1;
+    opsol->sposition[i] = prob->n;
   }
-  j = 0;
-  for (i = 0; i < prob->n; i++)
-  { if (opsol->selected[i])
-      opsol->sposition[j++] = i;
-  }
-  opsol->ns = j;
-  for (i = 0; i < opsol->ns; i++) {
-    opsol->cycle[i] = opsol->sposition[tspsol->cycle[i]];
+  opsol->val = 0.0;
+  for (i = 0; i < ns; i++)
+  { opsol->sposition[i] = names[i];
+    opsol->val += prob->op->s[names[i]];
   }
+  opsol->ns = ns;
+  for (i = 0; i < ns; i++)
+    opsol->cycle[i] = names[tspsol->cycle[i]];
   prev= opsol->cycle[0];
-  for (i = 1; i < opsol->ns; i++)
+  for (i = 1; i < ns; i++)
   { next = opsol->cycle[i];
     opsol->genotype[prev] = next;
+    opsol->pred[next] = prev;
     prev = next;
   }
   opsol->genotype[prev] = opsol->cycle[0];
-  opsol->val = 0.0;
-  for (i = 0; i < prob->n; i++)
-  { if (opsol->selected[i])
-      opsol->val += prob->op->s[i];
-  }
+  opsol->pred[opsol->cycle[0]] = prev;
   opsol->length = tspsol->val;
-  xfree(tselected);
   return;
 }
 
+/* drop and add nodes until the tour is feasible and no further node fits;
+ * if the tour was improved by the local search, the nodes whose tour
+ * edges change are appended to sol->touched; work are the operator work
+ * arrays of the calling thread */
 void compass_op_fit_solution ( compass_prob *prob, op_solution *sol,
-    struct op_cp *opcp)
-{ int i;
+    struct op_cp *opcp, struct op_eawork *work)
+{ int i, v;
+  int *oldnext = (int *) NULL;
+
+  if (sol->ntouched >= 0)
+  { oldnext = work->oldnext;
+    memcpy(oldnext, sol->genotype, prob->n * sizeof(int));
+  }
 
   OPdrop_operator ( prob->n, prob->data,
-  &sol->ns, sol->selected, sol->sposition, sol->cycle, sol->genotype, &sol->length,
-  prob->op->s, prob->op->d0, prob->rstate_cc);
+  &sol->ns, sol->selected, sol->sposition, sol->cycle, sol->genotype, sol->pred,
+  &sol->length, prob->op->s, prob->op->d0, prob->rstate_cc, work);
 
   OPadd_operator (prob->kdtree, prob->n, prob,
-  &sol->ns, sol->selected, sol->sposition, sol->cycle, sol->genotype, &sol->length,
-  prob->op->d0, prob->rstate_cc);
+  &sol->ns, sol->selected, sol->sposition, sol->cycle, sol->genotype, sol->pred,
+  &sol->length, prob->op->d0, work);
 
   sol->val = 0.0;
   for (i=0; i<prob->n; i++)
@@ -268,6 +321,23 @@ void compass_op_fit_solution ( compass_prob *prob, op_solution *sol,
       sol->val += prob->op->s[i];
   }
 
+  if (oldnext != (int *) NULL)
+  { /* a node is touched if the edge to its successor or the one from
+     * its predecessor is new; the list is dropped once it could hold
+     * as many entries as nodes */
+    v = 0;
+    do
+    { if (oldnext[v] != sol->genotype[v] || oldnext[sol->pred[v]] != v)
+      { if (sol->ntouched == prob->n)
+        { sol->ntouched = -1;
+          break;
+        }
+        sol->touched[sol->ntouched++] = v;
+      }
+      v = sol->genotype[v];
+    } while (v != 0);
+  }
+
   return;
 }
 
@@ -5,6 +5,7 @@
 #include "env.h"
 #include <gsl/gsl_rng.h>
 #include "dmp.h"
+#include "op.h"
 
 static const gsl_rng_type *T = NULL;
 
@@ -38,16 +39,18 @@ static void init_prob(compass_prob *prob)
   prob->n = 1;
   prob->data = xmalloc(sizeof(compass_data ));
   compass_init_data(prob->data);
-  prob->cacheind  = (int *) NULL;
-  prob->cacheval  = (int *) NULL;
-  prob->cacheM = 0;
+  prob->cache = (compass_cache *) NULL;
+  prob->node_id = (int *) NULL;
   //prob->kdtree = (CCkdtree *) NULL;
   prob->kdtree = xmalloc(sizeof(CCkdtree));
   prob->kdtree->root = (CCkdtree *) NULL;
   //prob->kdtree = xcalloc(1, sizeof(CCkdtree *));
+  prob->neighbeg = (int *) NULL;
+  prob->neighlist = (int *) NULL;
   prob->tsp = (struct tsp_prob *) NULL;
   prob->op = (struct op_prob *) NULL;
   prob->hash = xcalloc(32,sizeof(unsigned char));
+  prob->hashed = 0;
   prob->ctx = xmalloc(sizeof(SHA256_CTX));
   return;
 }
@@ -74,6 +77,51 @@ void compass_free_rng(compass_prob *prob)
   xfree(prob->rstate_cc);
 }
 
+/***********************************************************************
+*  NAME
+*
+*  compass_worker_prob - create thread-private view of problem object
+*
+*  SYNOPSIS
+*
+*  int compass_worker_prob(compass_prob *inprob, compass_prob *outprob,
+*     int seed);
+*
+*  DESCRIPTION
+*
+*  The routine compass_worker_prob initializes the problem object outprob
+*  as a view of inprob which can be used by a thread concurrently with
+*  other views of the same problem. The problem data, the kd-tree, the
+*  candidate graph, the scores and the control structures are shared
+*  with inprob and must not be modified (the kd-tree is only queried
+*  with caller-owned masks); the random number generators, seeded with
+*  seed, are private to outprob.
+*
+*  The view must be freed with the routine compass_delete_worker_prob.
+*
+*  RETURNS
+*
+*  The routine returns zero on success and non-zero otherwise. */
+
+int compass_worker_prob(compass_prob *inprob, compass_prob *outprob,
+    int seed)
+{ int ret = 0;
+  *outprob = *inprob;
+  outprob->seed = seed;
+  outprob->rstate_cc = talloc(1, CCrandstate);
+  CCutil_sprand (seed, outprob->rstate_cc);
+  outprob->rstate_gsl = gsl_rng_alloc (T);
+  gsl_rng_set (outprob->rstate_gsl, seed);
+  outprob->rstate = rng_create_rand();
+  rng_init_rand(outprob->rstate, seed);
+  return ret;
+}
+
+void compass_delete_worker_prob(compass_prob *prob)
+{ compass_free_rng(prob);
+  return;
+}
+
 /***********************************************************************
 *  NAME
 *
@@ -162,11 +210,14 @@ static void delete_prob(compass_prob *prob)
   if (prob->kdtree->root != (CCkdtree *) NULL)
     CCkdtree_free(prob->kdtree);
   xfree(prob->kdtree);
+  if (prob->neighbeg != (int *) NULL) xfree(prob->neighbeg);
+  if (prob->neighlist != (int *) NULL) xfree(prob->neighlist);
+  if (prob->cache != (compass_cache *) NULL)
+    compass_cache_delete(prob->cache);
+  if (prob->node_id != (int *) NULL) xfree(prob->node_id);
   compass_delete_data(prob->data);
   xfree(prob->name);
   dmp_delete_pool(prob->pool);
-  //xfree(prob->cacheind);
-  //xfree(prob->cacheval);
   return;
 }
 
@@ -176,23 +227,6 @@ void compass_delete_prob(compass_prob *prob)
   return;
 }
 
-/***********************************************************************
-*  NAME
-*
-*  compass_sub_prob - assign (change) select a subproblem
-*
-*  SYNOPSIS
-*
-*  void compass_sub_prob(compass_prob *inprob, compass_prob *outprob, int *nodes);
-*
-*  DESCRIPTION
-*
-*  The routine compass_set_prob_name assigns a given symbolic name (1 up to
-*  255 characters) to the specified problem object.
-*
-*  If the parameter name is NULL or empty string, the routine erases an
-*  existing symbolic name of the problem object. */
-
 int compass_sub_data ( struct compass_data *indata, struct compass_data *outdata, int *selected)
 { int ret;
   int i, j, ri, rj, nout;
@@ -290,21 +324,42 @@ cleanup:
   return ret;
 }
 
+/***********************************************************************
+*  NAME
+*
+*  compass_sub_prob - make problem object a view of a subproblem
+*
+*  SYNOPSIS
+*
+*  int compass_sub_prob(compass_prob *inprob, compass_prob *outprob,
+*     int *selected);
+*
+*  DESCRIPTION
+*
+*  The routine compass_sub_prob makes outprob the subproblem of inprob
+*  induced by the nodes i with selected[i] != 0. The data of outprob is
+*  a view of the data of inprob (see compass_view_data), so no distance
+*  matrix is copied and node k of outprob is node
+*  outprob->data->orig_names[k] of inprob.
+*
+*  outprob may be passed again with another node set; its data arrays
+*  are then reused and its kd-tree, if any, is freed. The random number
+*  generators of inprob are shared with outprob.
+*
+*  RETURNS
+*
+*  The routine returns zero on success and non-zero otherwise. */
+
 int compass_sub_prob(compass_prob *inprob, compass_prob *outprob, int *selected)
-{ int ret, i, nout;
-  //if (outprob != NULL)
-  nout = 0;
-  for ( i=0; i< inprob->n; i++)
-  { if (selected[i])
-      nout++;
-  }
-  outprob->n = nout;
-  if (compass_sub_data( inprob->data, outprob->data, selected))
-  { put_err_msg( "out of memory in compass_sub_data\n");
+{ int ret;
+  if (compass_view_data( inprob->data, outprob->data, selected))
+  { put_err_msg( "compass_view_data failed in compass_sub_prob\n");
     ret = 1; goto done;
   }
-  outprob->kdtree = talloc(1, CCkdtree);
-  outprob->kdtree->root = (CCkdtree *) NULL;
+  outprob->n = outprob->data->n;
+  if (outprob->kdtree->root != (CCkdnode *) NULL)
+    CCkdtree_free(outprob->kdtree);
+  outprob->kdtree->root = (CCkdnode *) NULL;
 
   outprob->tsp = (struct tsp_prob *) NULL;
   outprob->op = (struct op_prob *) NULL;
@@ -316,5 +371,79 @@ done:
   return ret;
 }
 
+/***********************************************************************
+*  NAME
+*
+*  compass_spacefill_prob - renumber nodes along a space filling curve
+*
+*  SYNOPSIS
+*
+*  int compass_spacefill_prob(compass_prob *prob);
+*
+*  DESCRIPTION
+*
+*  The routine compass_spacefill_prob renumbers the nodes of prob in the
+*  order of the Platzman-Bartholdi space filling curve through their
+*  coordinates, so that nodes close in the plane have close numbers and
+*  their coordinates, matrix rows, scores and solution entries share
+*  cache lines. The curve is a closed one and is rotated to start at
+*  node 0, the depot, which keeps its number; the departure and arrival
+*  nodes of the OP are renumbered with the others.
+*
+*  node_id[k] is then the node of the input file for node k, which the
+*  solution writers report. The routine must be called before the
+*  kd-tree, the candidate graph, the edge length table and the distance
+*  cache are built.
+*
+*  RETURNS
+*
+*  The routine returns zero on success and non-zero if prob has no
+*  coordinates. */
+
+int compass_spacefill_prob(compass_prob *prob)
+{ compass_data *data = prob->data;
+  int i, k, n = prob->n, *cyc, *perm, *pos;
+  if (data->x == (double *) NULL || data->y == (double *) NULL)
+  { put_err_msg("compass_spacefill_prob: no node coordinates\n");
+    return 1;
+  }
+  cyc = xcalloc(n, sizeof(int));
+  if (CCkdtree_space_fill_order(n, data, cyc))
+  { xfree(cyc);
+    put_err_msg("compass_spacefill_prob: space filling curve failed\n");
+    return 1;
+  }
+  for (k = 0; cyc[k] != 0; k++);
+  perm = xcalloc(n, sizeof(int));
+  pos = xcalloc(n, sizeof(int));
+  for (i = 0; i < n; i++)
+  { perm[i] = cyc[(k + i) % n];
+    pos[perm[i]] = i;
+  }
+  compass_data_permute(data, perm);
+  if (prob->op != NULL)
+  { struct op_prob *op = prob->op;
+    if (op->s != (double *) NULL)
+    { double *s = xcalloc(n, sizeof(double));
+      for (i = 0; i < n; i++)
+        s[i] = op->s[perm[i]];
+      if (!compass_data_mapped(data, op->s))
+        xfree(op->s);
+      op->s = s;
+    }
+    op->from = pos[op->from];
+    op->to = pos[op->to];
+  }
+  /* cyc becomes the new node_id */
+  for (i = 0; i < n; i++)
+    cyc[i] = prob->node_id != (int *) NULL ? prob->node_id[perm[i]]
+        : perm[i];
+  if (prob->node_id != (int *) NULL)
+    xfree(prob->node_id);
+  prob->node_id = cyc;
+  xfree(perm);
+  xfree(pos);
+  return 0;
+}
 
 /* eof */
@@ -18,6 +18,7 @@
 #include "compass.h"
 #include "env.h"
 #include "tsp.h"
+#include "data/xnear.h"
 #include "macrorus.h"
 
 static void
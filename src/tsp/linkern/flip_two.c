@@ -31,6 +31,11 @@
 /*    initializes flipper to an initial cycle given in cyc.                 */
 /*    returns 0 on success, nonzero on failure.                             */
 /*                                                                          */
+/*  int CClinkern_flipper_reset (CClk_flipper *f, int ncount, int *cyc)     */
+/*    like CClinkern_flipper_init, but the space of f (set up by an         */
+/*    earlier init or reset, or all zero) is reused if it is large enough.  */
+/*    returns 0 on success, nonzero on failure.                             */
+/*                                                                          */
 /*  void CClinkern_flipper_cycle (CClk_flipper *F, int *x)                  */
 /*    places the current cycle in x.                                        */
 /*                                                                          */
@@ -89,7 +94,8 @@ static void
     free_flipper (CClk_flipper *Fl);
 
 static int
-    build_flipper (CClk_flipper *Fl, int ncount);
+    build_flipper (CClk_flipper *Fl, int ncount),
+    flipper_setcycle (CClk_flipper *F, int ncount, int *cyc);
 
 
 #define SAME_SEGMENT(a, b)                                                  \
@@ -100,16 +106,65 @@ static int
 
 int CClinkern_flipper_init (CClk_flipper *F, int ncount, int *cyc)
 {
-    int i, j, cind, remain;
     int rval = 0;
-    CClk_childnode *c, *cprev;
-    CClk_parentnode *p;
 
     init_flipper (F);
     rval = build_flipper (F, ncount); 
     if (rval) {
         fprintf (stderr, "build_flipper failed\n"); goto CLEANUP;
     }
+    rval = flipper_setcycle (F, ncount, cyc);
+
+CLEANUP:
+   
+    if (rval) {
+        free_flipper (F);
+    }
+    return rval;
+}
+
+int CClinkern_flipper_reset (CClk_flipper *F, int ncount, int *cyc)
+{
+    int rval = 0;
+
+    F->reversed = 0;
+    F->groupsize = (int) (sqrt ((double) ncount) * GROUPSIZE_FACTOR);
+    F->nsegments =  (ncount + F->groupsize - 1) / F->groupsize;
+    F->split_cutoff = F->groupsize * SEGMENT_SPLIT_CUTOFF;
+
+    if (F->nsegments > F->maxsegments) {
+        CC_IFFREE (F->parents, CClk_parentnode);
+        F->parents = CC_SAFE_MALLOC (F->nsegments, CClk_parentnode);
+        if (F->parents == (CClk_parentnode *) NULL) {
+            fprintf (stderr, "out of memory in CClinkern_flipper_reset\n");
+            rval = 1; goto CLEANUP;
+        }
+        F->maxsegments = F->nsegments;
+    }
+    if (ncount > F->maxcount) {
+        CC_IFFREE (F->children, CClk_childnode);
+        F->children = CC_SAFE_MALLOC (ncount + 1, CClk_childnode);
+        if (F->children == (CClk_childnode *) NULL) {
+            fprintf (stderr, "out of memory in CClinkern_flipper_reset\n");
+            rval = 1; goto CLEANUP;
+        }
+        F->maxcount = ncount;
+    }
+    rval = flipper_setcycle (F, ncount, cyc);
+
+CLEANUP:
+
+    if (rval) {
+        free_flipper (F);
+    }
+    return rval;
+}
+
+static int flipper_setcycle (CClk_flipper *F, int ncount, int *cyc)
+{
+    int i, j, cind, remain;
+    CClk_childnode *c, *cprev;
+    CClk_parentnode *p;
 
     remain = ncount;
     i = 0;
@@ -129,7 +184,7 @@ int CClinkern_flipper_init (CClk_flipper *F, int ncount, int *cyc)
 
     if (i != F->nsegments) {
         fprintf (stderr, "seg count is wrong\n");
-        rval = 1; goto CLEANUP;
+        return 1;
     }
 
     c = &(F->children[cyc[ncount - 1]]);
@@ -154,12 +209,7 @@ int CClinkern_flipper_init (CClk_flipper *F, int ncount, int *cyc)
     F->parents[0].adj[0] = &(F->parents[F->nsegments - 1]);
     F->parents[F->nsegments - 1].adj[1] = &(F->parents[0]);
 
-CLEANUP:
-   
-    if (rval) {
-        free_flipper (F);
-    }
-    return rval;
+    return 0;
 }
 
 void CClinkern_flipper_cycle (CClk_flipper *F, int *x)
@@ -601,6 +651,8 @@ static void init_flipper (CClk_flipper *Fl)
     Fl->nsegments = 0;
     Fl->groupsize = 100;
     Fl->split_cutoff = 100;
+    Fl->maxsegments = 0;
+    Fl->maxcount = 0;
 }
 
 static void free_flipper (CClk_flipper *Fl)
@@ -612,6 +664,8 @@ static void free_flipper (CClk_flipper *Fl)
         Fl->nsegments = 0;
         Fl->groupsize = 0;
         Fl->split_cutoff = 0;
+        Fl->maxsegments = 0;
+        Fl->maxcount = 0;
     }
 }
 
@@ -632,6 +686,8 @@ static int build_flipper (CClk_flipper *Fl, int ncount)
         fprintf (stderr, "out of memory in build_flipper\n");
         rval = 1; goto CLEANUP;
     }
+    Fl->maxsegments = Fl->nsegments;
+    Fl->maxcount = ncount;
 
 CLEANUP:
 
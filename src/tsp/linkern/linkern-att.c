@@ -0,0 +1,11 @@
+/****************************************************************************/
+/*                                                                          */
+/*  Lin-Kernighan compiled for the ATT norm (see linkern.c).                */
+/*                                                                          */
+/****************************************************************************/
+
+#define LK_NORM  att
+#define LK_NORM_LEN(i, j, D)  CCdata_att_len ((D)->x, (D)->y, i, j)
+#define LK_NO_CACHE
+
+#include "linkern.c"
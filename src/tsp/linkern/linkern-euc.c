@@ -0,0 +1,11 @@
+/****************************************************************************/
+/*                                                                          */
+/*  Lin-Kernighan compiled for the EUC_2D norm (see linkern.c).             */
+/*                                                                          */
+/****************************************************************************/
+
+#define LK_NORM  euc
+#define LK_NORM_LEN(i, j, D)  CCdata_euclid_len ((D)->x, (D)->y, i, j)
+#define LK_NO_CACHE
+
+#include "linkern.c"
@@ -0,0 +1,14 @@
+/****************************************************************************/
+/*                                                                          */
+/*  Lin-Kernighan compiled for the GEO norm (see linkern.c). The lengths    */
+/*  are dear, so they still go through the distance cache.                  */
+/*                                                                          */
+/****************************************************************************/
+
+#define LK_NORM  geo
+#define LK_NORM_LEN(i, j, D)                                                \
+    ((D)->geo != (CCdata_geonode *) NULL                                    \
+        ? CCdata_geographic_node_len ((D)->geo, i, j)                       \
+        : CCdata_geographic_len ((D)->x, (D)->y, i, j))
+
+#include "linkern.c"
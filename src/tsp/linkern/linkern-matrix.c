@@ -0,0 +1,15 @@
+/****************************************************************************/
+/*                                                                          */
+/*  Lin-Kernighan compiled for explicit matrices and the tables of          */
+/*  compass_data_build_table, read directly or through the orig_names of    */
+/*  a view (see linkern.c).                                                 */
+/*                                                                          */
+/****************************************************************************/
+
+#define LK_NORM  matrix
+#define LK_NORM_LEN(i, j, D)                                                 \
+    ((D)->names ? CCdata_matrix_len ((D)->adj, (D)->names[i], (D)->names[j]) \
+                : CCdata_matrix_len ((D)->adj, i, j))
+#define LK_NO_CACHE
+
+#include "linkern.c"
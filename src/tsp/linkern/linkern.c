@@ -55,6 +55,59 @@
 /*     outcycle is not NULL, then it should point to an array of length     */
 /*     at least ncount.                                                     */
 /*                                                                          */
+/*  CClk_ctx *CClinkern_ctx_alloc (void)                                    */
+/*    RETURNS an empty Lin-Kernighan context, or NULL if out of memory.     */
+/*                                                                          */
+/*  void CClinkern_ctx_free (CClk_ctx *ctx)                                 */
+/*    FREES the context and all the space it holds.                         */
+/*                                                                          */
+/*  int CClinkern_tour_ctx (CClk_ctx *ctx, int ncount, compass_data *dat,   */
+/*      int ecount, int *elist, int stallcount, int repeatcount,            */
+/*      int *incycle, int *outcycle, double *val, int silent,               */
+/*      double time_bound, double length_bound, char *saveit_name,          */
+/*      int kicktype, CCrandstate *rstate)                                  */
+/*    RUNS Chained Lin-Kernighan like CClinkern_tour, but the graph, the    */
+/*     distance cache, the flipper, the queues and the pools are taken      */
+/*     from ctx. They grow to the largest ncount and ecount seen and are    */
+/*     only reset between calls, so many calls on small graphs do not       */
+/*     allocate. A context must not be used by two threads at once.         */
+/*                                                                          */
+/*  int CClinkern_repair_ctx (CClk_ctx *ctx, int ncount, compass_data *dat, */
+/*      int ecount, int *elist, int nactive, int *active, int *incycle,     */
+/*      int *outcycle, double *val, int silent, CCrandstate *rstate)        */
+/*    RUNS a single Lin-Kernighan pass from incycle, with the active queue  */
+/*     seeded only with the nodes active[0], ..., active[nactive-1] and     */
+/*     their neighbours in incycle. It is meant to repair a tour that was   */
+/*     already Lin-Kernighan optimal before a few nodes were inserted or    */
+/*     removed; it stops as soon as the queue drains (no kicks).            */
+/*                                                                          */
+/*  int CClinkern_ctx_fixedges (CClk_ctx *ctx, int ncount, int fcount,      */
+/*      int *flist)                                                         */
+/*    FIXES the fcount edges in flist (end1 end2 format) for the next call  */
+/*     of CClinkern_tour_ctx or CClinkern_repair_ctx on ctx, which must be  */
+/*     on ncount nodes. A node may have at most two fixed edges, and the    */
+/*     starting cycle of that call should contain all of them.              */
+/*                                                                          */
+/*  int CClinkern_fixed (int ncount, compass_data *dat, int ecount,         */
+/*      int *elist, int nkicks, int *incycle, int *outcycle, double *val,   */
+/*      int fcount, int *flist, int silent, CCrandstate *rstate)            */
+/*    RUNS Chained Lin-Kernighan from incycle with the fcount edges in      */
+/*     flist fixed (see CClinkern_ctx_fixedges).                            */
+/*                                                                          */
+/*    NOTES: Fixed edges are priced down by a penalty larger than any       */
+/*     possible gain, so no improving move removes them, and nodes with    */
+/*     two fixed edges are never put on the active queue. The returned      */
+/*     lengths are the true ones.                                           */
+/*                                                                          */
+/*  int CClinkern_tour_ctx_<norm>, CClinkern_repair_ctx_<norm>              */
+/*    RUN as CClinkern_tour_ctx and CClinkern_repair_ctx, with the edge     */
+/*     length of one norm compiled in instead of called through             */
+/*     dat->edgelen. They are built from this file by linkern-<norm>.c,     */
+/*     which defines LK_NORM (the suffix) and LK_NORM_LEN (the length of    */
+/*     the edge (i, j) for the distobj D), and LK_NO_CACHE if the length    */
+/*     is cheaper than a lookup in the distance cache. Contexts are shared  */
+/*     by all the variants.                                                 */
+/*                                                                          */
 /****************************************************************************/
 
 #include "compass.h"
@@ -63,6 +116,16 @@
 #include "data/kdtree/kdtree.h"
 #include "util.h"
 #include "macrorus.h"
+#include "data/norms.h"
+
+#ifdef LK_NORM
+#define LK_CAT(f, sfx)   f ## _ ## sfx
+#define LK_XCAT(f, sfx)  LK_CAT (f, sfx)
+#define LK_NAME(f)       LK_XCAT (f, LK_NORM)
+#else
+#define LK_NAME(f)       f
+#define LK_NORM_LEN(i, j, D)  CCutil_dat_edgelen (i, j, (D)->dat)
+#endif
 
 #define MAXDEPTH       25   /* Shouldn't really be less than 2.             */
 #define KICK_MAXDEPTH  50
@@ -174,10 +237,17 @@ typedef struct graph {
 
 typedef struct distobj {
     compass_data *dat;
+    double    *x;         /* coordinates of dat, and the matrix of dat  */
+    double    *y;         /* (or of the data it is a view of, names     */
+    int      **adj;       /* being the orig_names of the view, NULL     */
+    int       *names;     /* otherwise), for the LK_NORM_LEN variants   */
+    CCdata_geonode *geo;  /* the nodes of dat for the GEO norms         */
     int       *cacheval;
     int       *cacheind;
     int        cacheM;
-} distobj;
+    int       *fixmate;   /* fixed neighbours of i are fixmate[2i], and */
+    int        fixM;      /* fixmate[2i+1] (-1 if none), their edges    */
+} distobj;                /* are priced down by fixM                    */
 
 typedef struct adddel {
     char *add_edges;
@@ -191,6 +261,27 @@ typedef struct aqueue {
     CCdheap *h;
 } aqueue;
 
+struct CClk_ctx {
+    int          nmax;      /* node arrays are sized for nmax nodes     */
+    int          espace;    /* number of entries in G.edgespace         */
+    graph        G;
+    distobj      D;
+    adddel       E;
+    aqueue       Q;
+    CClk_flipper F;
+    flipstack    fstack;
+    flipstack    winstack;
+    int         *win_cycle;
+    int         *tcyc;      /* working cycle                            */
+    int         *qcyc;      /* random order of the initial active queue */
+    CCptrworld   intptr_world;
+    CCptrworld   edgelook_world;
+    int         *fixmate;   /* fixed edges for the next call, see       */
+    int          fixmax;    /* CClinkern_ctx_fixedges; fixmate has      */
+    int          fixcount;  /* 2 * fixmax entries                       */
+    int          fixncount;
+};
+
 
 static void
    lin_kernighan (graph *G, distobj *D, adddel *E, aqueue *Q, CClk_flipper *F,
@@ -220,9 +311,6 @@ static void
         int *t2, int *t3, int *t4, int *t5, int *t6, int *t7, int *t8),
    randcycle (int ncount, int *cyc, CCrandstate *rstate),
    insertedge (graph *G, int n1, int n2, int w),
-   initgraph (graph *G),
-   freegraph (graph *G),
-   init_adddel (adddel *E),
    free_adddel (adddel *E),
    init_aqueue (aqueue *Q),
    free_aqueue (aqueue *Q, CCptrworld *intptr_world),
@@ -233,16 +321,30 @@ static void
 #endif
    init_distobj (distobj *D),
    free_distobj (distobj *D),
-   linkern_free_world (CCptrworld *intptr_world, CCptrworld *edgelook_world),
+   reset_distobj (distobj *D, int ncount, compass_data *dat),
+   reset_adddel (adddel *E, int ncount),
    free_flipstack (flipstack *f);
 
+#ifndef LK_NORM
+static void
+   initgraph (graph *G),
+   freegraph (graph *G),
+   init_adddel (adddel *E),
+   linkern_free_world (CCptrworld *intptr_world, CCptrworld *edgelook_world);
+#endif
+
 static int
    buildgraph (graph *G, int ncount, int ecount, int *elist, distobj *D),
-   repeated_lin_kernighan (graph *G, distobj *D, int *cyc,
-       int stallcount, int repeatcount, double *val, double time_bound,
-       double length_bound,  char *saveit_name, int silent, int kicktype,
-       CCptrworld *intptr_world, CCptrworld *edgelook_world,
-        CCrandstate *rstate),
+   ctx_size (CClk_ctx *ctx, int ncount, int ecount),
+   tour_ctx (CClk_ctx *ctx, int ncount, compass_data *dat, int ecount,
+       int *elist, int stallcount, int repeatcount, int nactive, int *active,
+       int *incycle, int *outcycle, double *val, int silent,
+       double time_bound, double length_bound, char *saveit_name,
+       int kicktype, CCrandstate *rstate),
+   repeated_lin_kernighan (CClk_ctx *ctx, int *cyc,
+       int stallcount, int repeatcount, int nactive, int *active,
+       double *val, double time_bound, double length_bound,
+       char *saveit_name, int silent, int kicktype, CCrandstate *rstate),
    weird_second_step (graph *G, distobj *D, adddel *E, aqueue *Q,
        CClk_flipper *F, int gain, int t1, int t2, flipstack *fstack,
        CCptrworld *intptr_world, CCptrworld *edgelook_world),
@@ -290,39 +392,297 @@ static edgelook
 
 CC_PTRWORLD_ROUTINES(intptr, intptralloc, intptr_bulkalloc, intptrfree)
 CC_PTRWORLD_LISTFREE_ROUTINE(intptr, intptr_listfree, intptrfree)
-CC_PTRWORLD_LEAKS_ROUTINE(intptr, intptr_check_leaks, this, int)
 
 CC_PTRWORLD_ROUTINES(edgelook, edgelookalloc, edgelook_bulkalloc, edgelookfree)
 CC_PTRWORLD_LISTFREE_ROUTINE(edgelook, edgelook_listfree, edgelookfree)
+
+#ifndef LK_NORM
+CC_PTRWORLD_LEAKS_ROUTINE(intptr, intptr_check_leaks, this, int)
 CC_PTRWORLD_LEAKS_ROUTINE(edgelook, edgelook_check_leaks, diff, int)
+#endif
+
 
+#ifndef LK_NORM
 
 int CClinkern_tour (int ncount, compass_data *dat, int ecount,
         int *elist, int stallcount, int repeatcount, int *incycle,
         int *outcycle, double *val,
         int silent, double time_bound, double length_bound,
         char *saveit_name, int kicktype, CCrandstate *rstate)
+{
+    int rval = 0;
+    CClk_ctx *ctx;
+
+    ctx = CClinkern_ctx_alloc ();
+    if (ctx == (CClk_ctx *) NULL) {
+        fprintf (stderr, "CClinkern_ctx_alloc failed\n");
+        return 1;
+    }
+    rval = CClinkern_tour_ctx (ctx, ncount, dat, ecount, elist, stallcount,
+                 repeatcount, incycle, outcycle, val, silent, time_bound,
+                 length_bound, saveit_name, kicktype, rstate);
+    CClinkern_ctx_free (ctx);
+
+    return rval;
+}
+
+CClk_ctx *CClinkern_ctx_alloc (void)
+{
+    int rval = 0;
+    CClk_ctx *ctx;
+
+    ctx = CC_SAFE_MALLOC (1, CClk_ctx);
+    if (ctx == (CClk_ctx *) NULL) {
+        fprintf (stderr, "out of memory in CClinkern_ctx_alloc\n");
+        return (CClk_ctx *) NULL;
+    }
+    ctx->nmax   = 0;
+    ctx->espace = 0;
+    initgraph (&ctx->G);
+    init_distobj (&ctx->D);
+    init_adddel (&ctx->E);
+    init_aqueue (&ctx->Q);
+    memset (&ctx->F, 0, sizeof (CClk_flipper));
+    ctx->fstack.stack   = (flippair *) NULL;
+    ctx->winstack.stack = (flippair *) NULL;
+    ctx->win_cycle = (int *) NULL;
+    ctx->tcyc      = (int *) NULL;
+    ctx->qcyc      = (int *) NULL;
+    ctx->fixmate   = (int *) NULL;
+    ctx->fixmax    = 0;
+    ctx->fixcount  = 0;
+    ctx->fixncount = 0;
+    CCptrworld_init (&ctx->intptr_world);
+    CCptrworld_init (&ctx->edgelook_world);
+
+    rval = edgelook_bulkalloc (&ctx->edgelook_world, MAX_BACK * (BACKTRACK + 3));
+    if (rval) {
+        fprintf (stderr, "Unable to allocate initial edgelooks\n");
+        goto CLEANUP;
+    }
+    rval = init_flipstack (&ctx->fstack, 2 * (MAXDEPTH + 7 + KICK_MAXDEPTH), 0);
+    if (rval) {
+        fprintf (stderr, "init_flipstack failed\n"); goto CLEANUP;
+    }
+
+CLEANUP:
+
+    if (rval) {
+        CClinkern_ctx_free (ctx);
+        ctx = (CClk_ctx *) NULL;
+    }
+    return ctx;
+}
+
+void CClinkern_ctx_free (CClk_ctx *ctx)
+{
+    if (ctx == (CClk_ctx *) NULL) return;
+
+    freegraph (&ctx->G);
+    free_distobj (&ctx->D);
+    free_adddel (&ctx->E);
+    free_aqueue (&ctx->Q, &ctx->intptr_world);
+    CClinkern_flipper_finish (&ctx->F);
+    free_flipstack (&ctx->fstack);
+    free_flipstack (&ctx->winstack);
+    CC_IFFREE (ctx->win_cycle, int);
+    CC_IFFREE (ctx->tcyc, int);
+    CC_IFFREE (ctx->qcyc, int);
+    CC_IFFREE (ctx->fixmate, int);
+    linkern_free_world (&ctx->intptr_world, &ctx->edgelook_world);
+    CC_FREE (ctx, CClk_ctx);
+}
+
+#endif  /* LK_NORM */
+
+/* make the space of ctx large enough for ncount nodes and ecount edges */
+
+static int ctx_size (CClk_ctx *ctx, int ncount, int ecount)
+{
+    int rval = 0;
+
+    if (ncount > ctx->nmax) {
+        /* These bulkalloc's allocate sufficient objects that the individual
+         * allocs will not fail, and thus do not need to be tested */
+        rval = intptr_bulkalloc (&ctx->intptr_world, ncount - ctx->nmax);
+        if (rval) {
+            fprintf (stderr, "Unable to allocate initial intptrs\n");
+            goto CLEANUP;
+        }
+        ctx->nmax = 0;
+
+        CC_IFFREE (ctx->G.goodlist, edge *);
+        CC_IFFREE (ctx->G.degree, int);
+        CC_IFFREE (ctx->G.weirdmark, int);
+        free_distobj (&ctx->D);
+        free_adddel (&ctx->E);
+        free_aqueue (&ctx->Q, &ctx->intptr_world);
+        free_flipstack (&ctx->winstack);
+        CC_IFFREE (ctx->win_cycle, int);
+        CC_IFFREE (ctx->tcyc, int);
+        CC_IFFREE (ctx->qcyc, int);
+
+        ctx->G.goodlist  = CC_SAFE_MALLOC (ncount, edge *);
+        ctx->G.degree    = CC_SAFE_MALLOC (ncount, int);
+        ctx->G.weirdmark = CC_SAFE_MALLOC (ncount, int);
+        ctx->win_cycle   = CC_SAFE_MALLOC (ncount, int);
+        ctx->tcyc        = CC_SAFE_MALLOC (ncount, int);
+        ctx->qcyc        = CC_SAFE_MALLOC (ncount, int);
+        if (ctx->G.goodlist == (edge **) NULL ||
+            ctx->G.degree == (int *) NULL ||
+            ctx->G.weirdmark == (int *) NULL ||
+            ctx->win_cycle == (int *) NULL || ctx->tcyc == (int *) NULL ||
+            ctx->qcyc == (int *) NULL) {
+            fprintf (stderr, "out of memory in linkern\n");
+            rval = 1; goto CLEANUP;
+        }
+        rval = build_distobj (&ctx->D, ncount, (compass_data *) NULL);
+        if (rval) goto CLEANUP;
+        rval = build_aqueue (&ctx->Q, ncount, &ctx->intptr_world);
+        if (rval) {
+            fprintf (stderr, "build_aqueue failed\n"); goto CLEANUP;
+        }
+        rval = build_adddel (&ctx->E, ncount);
+        if (rval) {
+            fprintf (stderr, "build_adddel failed\n"); goto CLEANUP;
+        }
+        rval = init_flipstack (&ctx->winstack, 500 + ncount / 50,
+                               2 * (MAXDEPTH + 7 + KICK_MAXDEPTH));
+        if (rval) {
+            fprintf (stderr, "init_flipstack failed\n"); goto CLEANUP;
+        }
+        ctx->nmax = ncount;
+    }
+
+    if ((2 * ecount) + ncount > ctx->espace) {
+        CC_IFFREE (ctx->G.edgespace, edge);
+        ctx->espace = 0;
+        ctx->G.edgespace = CC_SAFE_MALLOC ((2 * ecount) + ncount, edge);
+        if (ctx->G.edgespace == (edge *) NULL) {
+            fprintf (stderr, "out of memory in linkern\n");
+            rval = 1; goto CLEANUP;
+        }
+        ctx->espace = (2 * ecount) + ncount;
+    }
+
+CLEANUP:
+
+    return rval;
+}
+
+int LK_NAME (CClinkern_tour_ctx) (CClk_ctx *ctx, int ncount,
+        compass_data *dat, int ecount, int *elist, int stallcount,
+        int repeatcount, int *incycle, int *outcycle, double *val,
+        int silent, double time_bound, double length_bound,
+        char *saveit_name, int kicktype, CCrandstate *rstate)
+{
+    return tour_ctx (ctx, ncount, dat, ecount, elist, stallcount,
+                 repeatcount, -1, (int *) NULL, incycle, outcycle, val,
+                 silent, time_bound, length_bound, saveit_name, kicktype,
+                 rstate);
+}
+
+int LK_NAME (CClinkern_repair_ctx) (CClk_ctx *ctx, int ncount,
+        compass_data *dat, int ecount, int *elist, int nactive, int *active,
+        int *incycle, int *outcycle, double *val, int silent,
+        CCrandstate *rstate)
+{
+    if (incycle == (int *) NULL) {
+        fprintf (stderr, "CClinkern_repair_ctx needs a starting cycle\n");
+        return 1;
+    }
+    return tour_ctx (ctx, ncount, dat, ecount, elist, 0, 0, nactive,
+                 active, incycle, outcycle, val, silent, -1.0, -1.0,
+                 (char *) NULL, CC_LK_WALK_KICK, rstate);
+}
+
+#ifndef LK_NORM
+
+int CClinkern_ctx_fixedges (CClk_ctx *ctx, int ncount, int fcount,
+        int *flist)
+{
+    int i, k, end;
+
+    ctx->fixcount = 0;
+    if (fcount <= 0) return 0;
+
+    if (ncount > ctx->fixmax) {
+        CC_IFFREE (ctx->fixmate, int);
+        ctx->fixmax = 0;
+        ctx->fixmate = CC_SAFE_MALLOC (2 * ncount, int);
+        if (ctx->fixmate == (int *) NULL) {
+            fprintf (stderr, "out of memory in CClinkern_ctx_fixedges\n");
+            return 1;
+        }
+        ctx->fixmax = ncount;
+    }
+    for (i = 0; i < 2 * ncount; i++) ctx->fixmate[i] = -1;
+
+    for (i = 0; i < fcount; i++) {
+        for (k = 0; k < 2; k++) {
+            end = flist[2*i+k];
+            if (ctx->fixmate[2*end] == -1) {
+                ctx->fixmate[2*end] = flist[2*i+1-k];
+            } else if (ctx->fixmate[2*end+1] == -1) {
+                ctx->fixmate[2*end+1] = flist[2*i+1-k];
+            } else {
+                fprintf (stderr, "node %d has more than two fixed edges\n",
+                         end);
+                return 1;
+            }
+        }
+    }
+    ctx->fixcount  = fcount;
+    ctx->fixncount = ncount;
+
+    return 0;
+}
+
+int CClinkern_fixed (int ncount, compass_data *dat, int ecount, int *elist,
+        int nkicks, int *incycle, int *outcycle, double *val, int fcount,
+        int *flist, int silent, CCrandstate *rstate)
+{
+    int rval = 0;
+    CClk_ctx *ctx;
+
+    ctx = CClinkern_ctx_alloc ();
+    if (ctx == (CClk_ctx *) NULL) {
+        fprintf (stderr, "CClinkern_ctx_alloc failed\n");
+        return 1;
+    }
+    rval = CClinkern_ctx_fixedges (ctx, ncount, fcount, flist);
+    if (rval) {
+        fprintf (stderr, "CClinkern_ctx_fixedges failed\n"); goto CLEANUP;
+    }
+    rval = CClinkern_tour_ctx (ctx, ncount, dat, ecount, elist, 100000000,
+                 nkicks, incycle, outcycle, val, silent, -1.0, -1.0,
+                 (char *) NULL, CC_LK_WALK_KICK, rstate);
+
+CLEANUP:
+
+    CClinkern_ctx_free (ctx);
+    return rval;
+}
+
+#endif  /* LK_NORM */
+
+/* nactive < 0 seeds the active queue with all the nodes */
+static int tour_ctx (CClk_ctx *ctx, int ncount, compass_data *dat,
+        int ecount, int *elist, int stallcount, int repeatcount,
+        int nactive, int *active, int *incycle, int *outcycle, double *val,
+        int silent, double time_bound, double length_bound,
+        char *saveit_name, int kicktype, CCrandstate *rstate)
 {
     int rval = 0;
     int i;
-    int *tcyc = (int *) NULL;
+    int *tcyc;
     double startzeit;
-    graph G;
-    distobj D;
-    CCptrworld intptr_world;
-    CCptrworld edgelook_world;
 
     if (silent == 0) {
         printf ("linkern ...\n"); fflush (stdout);
     }
     startzeit = CCutil_zeit ();
 
-    initgraph (&G);
-    init_distobj (&D);
-    CCptrworld_init (&intptr_world);
-    CCptrworld_init (&edgelook_world);
-    G.rstate = rstate;
-
     if (ncount < 10 && repeatcount > 0) {
         printf ("Less than 10 nodes, setting repeatcount to 0\n");  
         fflush (stdout);
@@ -338,30 +698,23 @@ int CClinkern_tour (int ncount, compass_data *dat, int ecount,
         }
     }
 
-    /* These bulkalloc's allocate sufficient objects that the individual
-     * allocs will not fail, and thus do not need to be tested */
-    rval = intptr_bulkalloc (&intptr_world, ncount);
+    rval = ctx_size (ctx, ncount, ecount);
     if (rval) {
-        fprintf (stderr, "Unable to allocate initial intptrs\n");
-        goto CLEANUP;
+        fprintf (stderr, "ctx_size failed\n"); goto CLEANUP;
     }
+    tcyc = ctx->tcyc;
+    ctx->G.rstate = rstate;
 
-    rval = edgelook_bulkalloc (&edgelook_world, MAX_BACK * (BACKTRACK + 3));
-    if (rval) {
-        fprintf (stderr, "Unable to allocate initial edgelooks\n");
-        goto CLEANUP;
-    }
-
-    tcyc = CC_SAFE_MALLOC (ncount, int);
-    if (tcyc == (int *) NULL) {
-        fprintf (stderr, "out of memory in linkern\n");
-        rval = 1; goto CLEANUP;
+    reset_distobj (&ctx->D, ncount, dat);
+    if (ctx->fixcount > 0) {
+        if (ctx->fixncount != ncount) {
+            fprintf (stderr, "fixed edges are not on %d nodes\n", ncount);
+            rval = 1; goto CLEANUP;
+        }
+        ctx->D.fixmate = ctx->fixmate;
     }
-
-    rval = build_distobj (&D, ncount, dat);
-    if (rval) goto CLEANUP;
     
-    rval = buildgraph (&G, ncount, ecount, elist, &D);
+    rval = buildgraph (&ctx->G, ncount, ecount, elist, &ctx->D);
     if (rval) {
         fprintf (stderr, "buildgraph failed\n"); goto CLEANUP;
     }
@@ -369,21 +722,32 @@ int CClinkern_tour (int ncount, compass_data *dat, int ecount,
     if (incycle) {
         for (i = 0; i < ncount; i++) tcyc[i] = incycle[i];
     } else {
-        randcycle (ncount, tcyc, G.rstate);
+        randcycle (ncount, tcyc, ctx->G.rstate);
     }
-    *val = cycle_length (ncount, tcyc, &D);
+    *val = cycle_length (ncount, tcyc, &ctx->D);
     if (silent == 0) {
         printf ("Starting Cycle: %.0f\n", *val); fflush (stdout);
     }
+    if (ctx->D.fixmate) {
+        /* larger than any gain, small enough that the gains of a move
+         * do not overflow */
+        ctx->D.fixM = (*val < BIGINT / (4 * KICK_MAXDEPTH) ?
+                       (int) *val + 1 : BIGINT / (4 * KICK_MAXDEPTH));
+        *val = cycle_length (ncount, tcyc, &ctx->D);
+    }
 
     //for (i=0; i<ncount; i++) printf("%d\n",tcyc[i]);
 
-    rval = repeated_lin_kernighan (&G, &D, tcyc, stallcount, repeatcount,
-                 val, time_bound, length_bound, saveit_name, silent,
-                 kicktype, &intptr_world, &edgelook_world, rstate);
+    rval = repeated_lin_kernighan (ctx, tcyc, stallcount, repeatcount,
+                 nactive, active, val, time_bound, length_bound, saveit_name, silent,
+                 kicktype, rstate);
     if (rval) {
         fprintf (stderr, "repeated_lin_kernighan failed\n"); goto CLEANUP;
     }
+    if (ctx->D.fixmate) {
+        ctx->D.fixmate = (int *) NULL;
+        *val = cycle_length (ncount, tcyc, &ctx->D);
+    }
 
     if (silent == 0) {
         printf ("Best cycle length: %.0f\n", *val);
@@ -398,11 +762,8 @@ int CClinkern_tour (int ncount, compass_data *dat, int ecount,
 
 CLEANUP:
 
-    CC_IFFREE (tcyc, int);
-    freegraph (&G);
-    free_distobj (&D);
-    linkern_free_world (&intptr_world, &edgelook_world);
-
+    ctx->D.fixmate = (int *) NULL;
+    ctx->fixcount = 0;
     return rval;
 }
 
@@ -411,89 +772,83 @@ CLEANUP:
 #define HEAT_RESET 100000
 #endif
 
-static int repeated_lin_kernighan (graph *G, distobj *D, int *cyc,
-        int stallcount, int count, double *val, double time_bound,
-        double length_bound, char *saveit_name, int silent, int kicktype,
-        CCptrworld *intptr_world, CCptrworld *edgelook_world,
-        CCrandstate *rstate)
+static int repeated_lin_kernighan (CClk_ctx *ctx, int *cyc,
+        int stallcount, int count, int nactive, int *active, double *val,
+        double time_bound, double length_bound, char *saveit_name,
+        int silent, int kicktype, CCrandstate *rstate)
 {
     int rval    = 0;
     int round   = 0;
     int newtree = 0;
     int quitcount, hit, delta;
-    int *win_cycle = (int *) NULL;
+    graph *G = &ctx->G;
+    distobj *D = &ctx->D;
+    adddel *E = &ctx->E;
+    aqueue *Q = &ctx->Q;
+    CClk_flipper *F = &ctx->F;
+    flipstack *winstack = &ctx->winstack, *fstack = &ctx->fstack;
+    int *win_cycle = ctx->win_cycle;
+    CCptrworld *intptr_world = &ctx->intptr_world;
+    CCptrworld *edgelook_world = &ctx->edgelook_world;
     CCkdtree kdt;
-    flipstack winstack, fstack;
     double t, best = *val, oldbest = *val;
     double szeit = CCutil_zeit ();
 #ifdef ACCEPT_BAD_TOURS
     double heat = *val / (20 * G->ncount), tdelta;
 #endif
     int ncount = G->ncount;
-    adddel E;
-    CClk_flipper F;
-    aqueue Q;
-
-    init_aqueue (&Q);
-    init_adddel (&E);
-    rval = build_aqueue (&Q, ncount, intptr_world);
-    if (rval) {
-        fprintf (stderr, "build_aqueue failed\n"); goto CLEANUP;
-    }
-    rval = build_adddel (&E, ncount);
-    if (rval) {
-        fprintf (stderr, "build_adddel failed\n"); goto CLEANUP;
-    }
-
-    hit = 2 * (MAXDEPTH + 7 + KICK_MAXDEPTH);
-    rval = init_flipstack (&fstack, hit, 0);
-    if (rval) {
-        fprintf (stderr, "init_flipstack failed\n"); goto CLEANUP;
-    }
-    rval = init_flipstack (&winstack, 500 + ncount / 50, hit);
-    if (rval) {
-        fprintf (stderr, "init_flipstack failed\n"); goto CLEANUP;
-    }
+    int i;
 
-    win_cycle = CC_SAFE_MALLOC (ncount, int);
-    if (win_cycle == (int *) NULL) {
-        fprintf (stderr, "out of memory in repeated_lin_kernighan\n");
-        rval = 1; goto CLEANUP;
+    /* reset the space of ctx for this graph */
+    for (i = 0; i < ncount; i++) Q->active[i] = 0;
+    if (D->fixmate) {
+        /* a node with two fixed edges cannot start an improving move;
+         * marking it active keeps it off the queue */
+        for (i = 0; i < ncount; i++) {
+            if (D->fixmate[2*i+1] != -1) Q->active[i] = 1;
+        }
     }
-    win_cycle[0] = -1;
+    reset_adddel (E, ncount);
+    winstack->max = 500 + ncount / 50;
 
     quitcount = stallcount;
     if (quitcount > count) quitcount = count;
 
-    CClinkern_flipper_init (&F, ncount, cyc);
-    fstack.counter = 0;
-    winstack.counter = 0;
+    rval = CClinkern_flipper_reset (F, ncount, cyc);
+    if (rval) {
+        fprintf (stderr, "CClinkern_flipper_reset failed\n"); goto CLEANUP;
+    }
+    fstack->counter = 0;
+    winstack->counter = 0;
     win_cycle[0] = -1;
 
 #ifdef USE_HEAP
     {
-        int i;
-
         for (i = 0; i < ncount; i++) {
-            add_to_active_queue (i, &Q, D, G, &F); 
+            add_to_active_queue (i, Q, D, G, F); 
         }
     }
 #else
-    {
-        int *tcyc = (int *) NULL;
-        int i;
-
-        tcyc = CC_SAFE_MALLOC (ncount, int);
-        if (tcyc == (int *) NULL) {
-            fprintf (stderr, "out of memory in repeated_lin_kernighan\n");
-            rval = 1; goto CLEANUP;
+    if (nactive >= 0) {
+        int n;
+
+        /* only the given nodes and their tour neighbours */
+        for (i = 0; i < nactive; i++) {
+            n = active[i];
+            add_to_active_queue (n, Q, intptr_world);
+            add_to_active_queue (CClinkern_flipper_prev (F, n), Q,
+                                 intptr_world);
+            add_to_active_queue (CClinkern_flipper_next (F, n), Q,
+                                 intptr_world);
         }
+    } else {
+        int *tcyc = ctx->qcyc;
+
         /* init active_queue with random order */
         randcycle (ncount, tcyc, G->rstate);
         for (i = 0; i < ncount; i++) {
-            add_to_active_queue (tcyc[i], &Q, intptr_world);
+            add_to_active_queue (tcyc[i], Q, intptr_world);
         }
-        CC_IFFREE (tcyc, int);
     }
 #endif
 
@@ -506,10 +861,10 @@ static int repeated_lin_kernighan (graph *G, distobj *D, int *cyc,
         }
     }
 
-    lin_kernighan (G, D, &E, &Q, &F, &best, win_cycle, &winstack, &fstack,
+    lin_kernighan (G, D, E, Q, F, &best, win_cycle, winstack, fstack,
                    intptr_world, edgelook_world);
 
-    winstack.counter = 0;
+    winstack->counter = 0;
     win_cycle[0] = -1;
 
     if (silent == 0) {
@@ -524,23 +879,23 @@ static int repeated_lin_kernighan (graph *G, distobj *D, int *cyc,
 
     while (round < quitcount) {
         hit = 0;
-        fstack.counter = 0;
+        fstack->counter = 0;
 
 
         if (IMPROVE_SWITCH == -1 || round < IMPROVE_SWITCH) {
-            rval = random_four_swap (G, D, &Q, &F, &kdt, &delta, kicktype,
-                                     &winstack, &fstack, intptr_world, rstate);
+            rval = random_four_swap (G, D, Q, F, &kdt, &delta, kicktype,
+                                     winstack, fstack, intptr_world, rstate);
             if (rval) {
                 fprintf (stderr, "random_four_swap failed\n"); goto CLEANUP;
             }
         } else {
-            delta = kick_improve (G, D, &E, &Q, &F, &winstack, &fstack, intptr_world);
+            delta = kick_improve (G, D, E, Q, F, winstack, fstack, intptr_world);
         }
 
 
-        fstack.counter = 0;
+        fstack->counter = 0;
         t = best + delta;
-        lin_kernighan (G, D, &E, &Q, &F, &t, win_cycle, &winstack, &fstack,
+        lin_kernighan (G, D, E, Q, F, &t, win_cycle, winstack, fstack,
                        intptr_world, edgelook_world);
 
 #ifdef ACCEPT_BAD_TOURS
@@ -560,7 +915,7 @@ static int repeated_lin_kernighan (graph *G, distobj *D, int *cyc,
         if (t < best) {
 #endif /* ACCEPT_TIES */
 #endif /* ACCEPT_BAD_TOURS */
-            winstack.counter = 0;
+            winstack->counter = 0;
             win_cycle[0] = -1;
             if (t < best) {
                 best = t;
@@ -582,20 +937,19 @@ printf ("%4d Steps   Best: %.0f   %.2f seconds (Negative %.0f) (%.0f)\n",
 #endif
         } else {
             if (win_cycle[0] == -1) {
-                while (winstack.counter) {
-                    winstack.counter--;
-                    CClinkern_flipper_flip (&F,
-                                      winstack.stack[winstack.counter].last, 
-                                      winstack.stack[winstack.counter].first);
+                while (winstack->counter) {
+                    winstack->counter--;
+                    CClinkern_flipper_flip (F,
+                                      winstack->stack[winstack->counter].last, 
+                                      winstack->stack[winstack->counter].first);
                 }
             } else {
-                CClinkern_flipper_finish (&F);
-                CClinkern_flipper_init (&F, ncount, win_cycle);
-                while (winstack.counter) {
-                    winstack.counter--;
-                    CClinkern_flipper_flip (&F,
-                                      winstack.stack[winstack.counter].last, 
-                                      winstack.stack[winstack.counter].first);
+                CClinkern_flipper_reset (F, ncount, win_cycle);
+                while (winstack->counter) {
+                    winstack->counter--;
+                    CClinkern_flipper_flip (F,
+                                      winstack->stack[winstack->counter].last, 
+                                      winstack->stack[winstack->counter].first);
                 }
                 win_cycle[0] = -1;
             }
@@ -609,7 +963,7 @@ printf ("%4d Steps   Best: %.0f   %.2f seconds (Negative %.0f) (%.0f)\n",
         }
 
         if (saveit_name && (round % 10000 == 9999) && best < oldbest) {
-            rval = save_tour (ncount, saveit_name, &F);
+            rval = save_tour (ncount, saveit_name, F);
             if (rval) {
                 fprintf (stderr, "save_tour failed\n"); goto CLEANUP;
             }
@@ -638,8 +992,7 @@ printf ("%4d Steps   Best: %.0f   %.2f seconds (Negative %.0f) (%.0f)\n",
         printf ("%4d Total Steps.\n", round); fflush (stdout);
     }
 
-    CClinkern_flipper_cycle (&F, cyc);
-    CClinkern_flipper_finish (&F);
+    CClinkern_flipper_cycle (F, cyc);
 
 #if 0
     if (saveit_name && best < oldbest) {
@@ -667,11 +1020,10 @@ printf ("%4d Steps   Best: %.0f   %.2f seconds (Negative %.0f) (%.0f)\n",
 
 CLEANUP:
 
-    free_aqueue (&Q, intptr_world);
-    free_adddel (&E);
-    free_flipstack (&fstack);
-    free_flipstack (&winstack);
-    CC_IFFREE (win_cycle, int);
+    /* leave the queue empty for the next call */
+    intptr_listfree (intptr_world, Q->active_queue);
+    Q->active_queue = (intptr *) NULL;
+    Q->bottom_active_queue = (intptr *) NULL;
     if (newtree) CCkdtree_free (&kdt);
     return rval;
 }
@@ -1070,7 +1422,7 @@ static int weird_second_step (graph *G, distobj *D, adddel *E, aqueue *Q,
 {
     int t3, t4, t5, t6, t7, t8;
     int oldG, gain, tG, Gstar = 0, val, hit;
-    int t3prev, t4next;
+    int t4next;
     edgelook *e, *f, *h, *list, *list2, *list3;
 
     list = weird_look_ahead (G, D, F, len_t1_t2, t1, t2, edgelook_world);
@@ -1080,7 +1432,6 @@ static int weird_second_step (graph *G, distobj *D, adddel *E, aqueue *Q,
 
         oldG = len_t1_t2 - h->diff;
   
-        t3prev = CClinkern_flipper_prev (F, t3);
         t4next = CClinkern_flipper_next (F, t4);
   
         markedge_add (t2, t3, E);
@@ -2099,6 +2450,8 @@ static void kickturn (int n, aqueue *Q, CC_UNUSED distobj *D,
         add_to_active_queue (k, Q, D, G, F);
     }
 #else
+    (void) D;
+    (void) G;
     add_to_active_queue (n, Q, intptr_world);
     {
         int k;
@@ -2138,6 +2491,7 @@ static void bigturn (graph *G, int n, int tonext, aqueue *Q, CClk_flipper *F,
         add_to_active_queue (G->goodlist[n][i].other, Q, D, G, F);
     }
 #else
+    (void) D;
     add_to_active_queue (n, Q, intptr_world);
     if (tonext) {
         for (i = 0, k = n; i < MARK_LEVEL; i++) {
@@ -2168,6 +2522,10 @@ static void randcycle (int ncount, int *cyc, CCrandstate *rstate)
     }
 }
 
+#ifndef LK_NORM
+
+/* the context is only created and freed by the generic variant */
+
 static void initgraph (graph *G)
 {
     G->goodlist   = (edge **) NULL;
@@ -2190,6 +2548,8 @@ static void freegraph (graph *G)
     }
 }
 
+#endif  /* LK_NORM */
+
 static int buildgraph (graph *G, int ncount, int ecount, int *elist,
         distobj *D)
 {
@@ -2197,15 +2557,7 @@ static int buildgraph (graph *G, int ncount, int ecount, int *elist,
     int n1, n2, w, i;
     edge *p;
 
-    G->goodlist  = CC_SAFE_MALLOC (ncount, edge *);
-    G->degree    = CC_SAFE_MALLOC (ncount, int);
-    G->weirdmark = CC_SAFE_MALLOC (ncount, int);
-    G->edgespace = CC_SAFE_MALLOC ((2 * ecount) + ncount, edge);
-    if (G->goodlist == (edge **) NULL || G->degree == (int *) NULL ||
-        G->edgespace == (edge *) NULL)  {
-        fprintf (stderr, "out of memory in buildgraph\n");
-        rval = 1; goto CLEANUP;
-    }
+    /* the space of G is allocated by ctx_size */
 
     for (i = 0; i < ncount; i++) {
         G->degree[i] = 1;
@@ -2233,9 +2585,6 @@ static int buildgraph (graph *G, int ncount, int ecount, int *elist,
     G->ncount     = ncount;
     G->weirdmagic = 0;
 
-CLEANUP:
-
-    if (rval) freegraph (G);
     return rval;
 }
 
@@ -2253,6 +2602,8 @@ static void insertedge (graph *G, int n1, int n2, int w)
     G->degree[n1]++;
 }
 
+#ifndef LK_NORM
+
 static void linkern_free_world (CCptrworld *intptr_world,
         CCptrworld *edgelook_world)
 {
@@ -2268,6 +2619,8 @@ static void linkern_free_world (CCptrworld *intptr_world,
     CCptrworld_delete (edgelook_world);
 }
 
+#endif  /* LK_NORM */
+
 static int init_flipstack (flipstack *f, int total, int single)
 {
     f->counter = 0;
@@ -2290,12 +2643,16 @@ static void free_flipstack (flipstack *f)
     CC_IFFREE (f->stack, flippair);
 }
 
+#ifndef LK_NORM
+
 static void init_adddel (adddel *E)
 {
     E->add_edges = (char *) NULL;
     E->del_edges = (char *) NULL;
 }
 
+#endif  /* LK_NORM */
+
 static void free_adddel (adddel *E)
 {
     if (E) {
@@ -2320,10 +2677,7 @@ static int build_adddel (adddel *E, int ncount)
         fprintf (stderr, "out of memory in build_adddel\n");
         rval = 1; goto CLEANUP;
     }
-    for (i = 0; i < M; i++) {
-        E->add_edges[i] = 0;
-        E->del_edges[i] = 0;
-    }
+    reset_adddel (E, ncount);
 
 CLEANUP:
 
@@ -2333,6 +2687,21 @@ CLEANUP:
     return rval;
 }
 
+static void reset_adddel (adddel *E, int ncount)
+{
+    int i, M;
+
+    i = 0;
+    while ((1 << i) < ncount)
+        i++;
+    M = (1 << i);
+
+    for (i = 0; i < M; i++) {
+        E->add_edges[i] = 0;
+        E->del_edges[i] = 0;
+    }
+}
+
 static void init_aqueue (aqueue *Q)
 {
     Q->active = (char *) NULL;
@@ -2457,9 +2826,16 @@ static int pop_from_active_queue (aqueue *Q, CCptrworld *intptr_world)
 static void init_distobj (distobj *D)
 {
     D->dat = (compass_data *) NULL;
+    D->x = (double *) NULL;
+    D->y = (double *) NULL;
+    D->adj = (int **) NULL;
+    D->names = (int *) NULL;
+    D->geo = (CCdata_geonode *) NULL;
     D->cacheind  = (int *) NULL;
     D->cacheval  = (int *) NULL;
     D->cacheM = 0;
+    D->fixmate = (int *) NULL;
+    D->fixM = 0;
 }
 
 static void free_distobj (distobj *D)
@@ -2498,22 +2874,75 @@ static int build_distobj (distobj *D, int ncount, compass_data *dat)
         fprintf (stderr, "out of memory in build_distobj\n");
         rval = 1; goto CLEANUP;
     }
+    reset_distobj (D, ncount, dat);
+
+CLEANUP:
+
+    if (rval) {
+        free_distobj (D);
+    }
+    return rval; 
+}
+
+/* clear the cache of D, which must have been built for at least ncount
+ * nodes, and point it to dat; the cache size depends only on ncount */
+
+static void reset_distobj (distobj *D, int ncount, compass_data *dat)
+{
+    int i;
+
+    D->dat = dat;
+    D->fixmate = (int *) NULL;
+    D->fixM = 0;
+    if (dat != (compass_data *) NULL) {
+        D->x = dat->x;
+        D->y = dat->y;
+        D->geo = dat->geo;
+        if (dat->orig != (compass_data *) NULL) {
+            D->adj = dat->orig->adj;
+            D->names = dat->orig_names;
+        } else {
+            D->adj = dat->adj;
+            D->names = (int *) NULL;
+        }
+    }
+
+#ifndef BENTLEY_CACHE
+    i = 0;
+    while ((1 << i) < (ncount << 2))
+        i++;
+    D->cacheM = (1 << i);  
+#else
+    i = 0;
+    while ((1 << i) < ncount)
+        i++;
+    D->cacheM = (1 << i);
+#endif
+
+#ifndef LK_NO_CACHE
     for (i = 0; i < D->cacheM; i++) {
         D->cacheind[i] = -1;
     }
+#endif
 
 #ifndef BENTLEY_CACHE
     D->cacheM--;
 #endif
+}
 
-CLEANUP:
 
-    if (rval) {
-        free_distobj (D);
-    }
-    return rval; 
+#ifdef LK_NO_CACHE
+
+static int dist (int i, int j, distobj *D)
+{
+    int len = LK_NORM_LEN (i, j, D);
+
+    if (D->fixmate && (D->fixmate[2*i] == j || D->fixmate[2*i+1] == j))
+        return len - D->fixM;
+    return len;
 }
 
+#else
 
 static int dist (int i, int j, distobj *D)   /* As in Bentley's kdtree paper */
 {
@@ -2532,7 +2961,11 @@ static int dist (int i, int j, distobj *D)   /* As in Bentley's kdtree paper */
 
     if (D->cacheind[ind] != i) {
         D->cacheind[ind] = i;
-        D->cacheval[ind] = CCutil_dat_edgelen (i, j, D->dat);
+        D->cacheval[ind] = LK_NORM_LEN (i, j, D);
     }
+    if (D->fixmate && (D->fixmate[2*i] == j || D->fixmate[2*i+1] == j))
+        return D->cacheval[ind] - D->fixM;
     return D->cacheval[ind];
 }
+
+#endif  /* LK_NO_CACHE */
@@ -22,7 +22,25 @@
 
 
 
+typedef struct CClk_ctx CClk_ctx;
+
+CClk_ctx
+    *CClinkern_ctx_alloc (void);
+
+void
+    CClinkern_ctx_free (CClk_ctx *ctx);
+
 int
+    CClinkern_tour_ctx (CClk_ctx *ctx, int ncount, compass_data *dat,
+        int ecount, int *elist, int stallcount, int repeatcount,
+        int *incycle, int *outcycle, double *val, int silent,
+        double time_bound, double length_bound, char *saveit_name,
+        int kicktype, CCrandstate *rstate),
+    CClinkern_repair_ctx (CClk_ctx *ctx, int ncount, compass_data *dat,
+        int ecount, int *elist, int nactive, int *active, int *incycle,
+        int *outcycle, double *val, int silent, CCrandstate *rstate),
+    CClinkern_ctx_fixedges (CClk_ctx *ctx, int ncount, int fcount,
+        int *flist),
     CClinkern_tour (int ncount, compass_data *dat, int ecount,
         int *elist, int stallcount, int repeatcount, int *incycle,
         int *outcycle, double *val, int silent, double time_bound,
@@ -35,6 +53,26 @@ int
         int nkicks, int *incycle, int *outcycle, double *val, int fcount,
         int *flist, int silent, CCrandstate *rstate);
 
+/* CClinkern_tour_ctx and CClinkern_repair_ctx compiled for one norm
+ * (linkern-<sfx>.c) */
+#define CC_LK_VARIANT(sfx)                                                   \
+int                                                                          \
+    CClinkern_tour_ctx_##sfx (CClk_ctx *ctx, int ncount, compass_data *dat,  \
+        int ecount, int *elist, int stallcount, int repeatcount,             \
+        int *incycle, int *outcycle, double *val, int silent,                \
+        double time_bound, double length_bound, char *saveit_name,           \
+        int kicktype, CCrandstate *rstate),                                  \
+    CClinkern_repair_ctx_##sfx (CClk_ctx *ctx, int ncount,                   \
+        compass_data *dat, int ecount, int *elist, int nactive, int *active, \
+        int *incycle, int *outcycle, double *val, int silent,                \
+        CCrandstate *rstate);
+
+CC_LK_VARIANT (euc)
+CC_LK_VARIANT (ceil)
+CC_LK_VARIANT (att)
+CC_LK_VARIANT (geo)
+CC_LK_VARIANT (matrix)
+
 #endif  /* __LINKERN_H */
 
 
@@ -70,12 +108,15 @@ typedef struct CClk_flipper {
     int                     nsegments;
     int                     groupsize;
     int                     split_cutoff;
+    int                     maxsegments;  /* space in parents        */
+    int                     maxcount;     /* space in children, - 1  */
 } CClk_flipper;
 
 
 
 int
     CClinkern_flipper_init (CClk_flipper *f, int ncount, int *cyc),
+    CClinkern_flipper_reset (CClk_flipper *f, int ncount, int *cyc),
     CClinkern_flipper_next (CClk_flipper *f, int x),
     CClinkern_flipper_prev (CClk_flipper *f, int x),
     CClinkern_flipper_sequence (CClk_flipper *f, int x, int y, int z);
@@ -18,6 +18,29 @@
 #include "compass.h"
 #include "env.h"
 #include "tsp.h"
+#include "tsp/linkern/linkern.h"
+#include "data/kdtree/kdtree.h"
+
+typedef struct ls_engine
+{ /* local search routines for the edge lengths of one data object */
+  int (*tour_ctx) (CClk_ctx *ctx, int ncount, compass_data *dat,
+      int ecount, int *elist, int stallcount, int repeatcount,
+      int *incycle, int *outcycle, double *val, int silent,
+      double time_bound, double length_bound, char *saveit_name,
+      int kicktype, CCrandstate *rstate);
+  int (*repair_ctx) (CClk_ctx *ctx, int ncount, compass_data *dat,
+      int ecount, int *elist, int nactive, int *active, int *incycle,
+      int *outcycle, double *val, int silent, CCrandstate *rstate);
+  int (*twoopt) (CCkdtree *kt, int ncount, compass_data *dat,
+      int *incycle, int *outcycle, double *val, int run_two_and_a_half_opt,
+      int silent, CCrandstate *rstate);
+  int (*threeopt) (CCkdtree *kt, int ncount, compass_data *dat,
+      int *incycle, int *outcycle, double *val, int silent,
+      CCrandstate *rstate);
+} ls_engine;
+
+static void
+select_engine (compass_data *data, ls_engine *eng);
 
 static int
 call_twoopt_tour (compass_prob *prob, tsp_solution *sol,
@@ -27,10 +50,13 @@ call_twoopt5_tour (compass_prob *prob, tsp_solution *sol,
 call_threeopt_tour (compass_prob *prob, tsp_solution *sol,
     struct tsp_cp *tspcp),
 call_linkern (compass_prob *prob, tsp_solution *sol,
-    struct tsp_cp *tspcp);
+    struct tsp_cp *tspcp, CClk_ctx *lkctx, int nactive, int *active);
 
+
+/* lkctx, if not NULL, is the Lin-Kernighan context reused by the caller
+ * across calls; otherwise a temporary one is used */
 int compass_tsp_local_search (compass_prob *prob, tsp_solution *sol,
-    struct tsp_cp *tspcp)
+    struct tsp_cp *tspcp, CClk_ctx *lkctx)
 { int ret;
   if ( prob->n <= 3) {
     put_err_msg("tsp    : Cannot run local search in an %d node graph\n",
@@ -60,7 +86,7 @@ int compass_tsp_local_search (compass_prob *prob, tsp_solution *sol,
     }
     goto done;
   case TSP_LINKERN_LS:
-    if (call_linkern (prob, sol, tspcp)) {
+    if (call_linkern (prob, sol, tspcp, lkctx, -1, (int *) NULL)) {
       put_err_msg("tsp   :   call_linkern failed\n");
       return 1;
     }
@@ -73,17 +99,36 @@ done:
  return 0;
 }
 
+/* improve the tour sol, which was locally optimal before the tour edges
+ * at the nodes active[0], ..., active[nactive-1] were changed; with the
+ * Lin-Kernighan local search and a context lkctx only these nodes and
+ * their tour neighbours are searched from, any other local search is
+ * run in full */
+int compass_tsp_repair (compass_prob *prob, tsp_solution *sol,
+    struct tsp_cp *tspcp, CClk_ctx *lkctx, int nactive, int *active)
+{ if (tspcp->local_search != TSP_LINKERN_LS || lkctx == (CClk_ctx *) NULL
+      || prob->n <= 3)
+    return compass_tsp_local_search (prob, sol, tspcp, lkctx);
+  if (call_linkern (prob, sol, tspcp, lkctx, nactive, active))
+  { put_err_msg("tsp   :   call_linkern failed\n");
+    return 1;
+  }
+  return 0;
+}
+
 static int call_twoopt_tour (compass_prob *prob, tsp_solution *sol,
     struct tsp_cp *tspcp)
 { compass_data *data = prob->data;
   if ((data->norm & CC_NORM_BITS) == CC_KD_NORM_TYPE)
   { struct tsp_solution *tempsol;
+    ls_engine eng;
     tempsol = xcalloc(1, sizeof(tsp_solution ));
     if (tspcp->msg_lev >= COMPASS_MSG_ALL)
       xprintf ("tsp   :  2-OPT local search...");
     compass_tsp_init_sol(prob, tempsol);
     tempsol->val = sol->val;
-    if (CCkdtree_twoopt_tour (prob->kdtree, prob->n, data, sol->cycle,
+    select_engine(data, &eng);
+    if (eng.twoopt (prob->kdtree, prob->n, data, sol->cycle,
           tempsol->cycle, &tempsol->val, 0, 1, prob->rstate_cc))
     { put_err_msg("CCkdtree_twoopt_tour failed\n");
       compass_tsp_delete_sol (tempsol);
@@ -116,12 +161,14 @@ static int call_twoopt5_tour (compass_prob *prob, tsp_solution *sol,
 { compass_data *data = prob->data;
   if ((data->norm & CC_NORM_BITS) == CC_KD_NORM_TYPE)
   { struct tsp_solution *tempsol;
+    ls_engine eng;
     tempsol = xcalloc(1, sizeof(tsp_solution ));
     if (tspcp->msg_lev >= COMPASS_MSG_ALL)
       xprintf ("tsp   :  2.5-OPT local search...");
     compass_tsp_init_sol(prob, tempsol);
     tempsol->val = sol->val;
-    if (CCkdtree_twoopt_tour (prob->kdtree, prob->n, data, sol->cycle,
+    select_engine(data, &eng);
+    if (eng.twoopt (prob->kdtree, prob->n, data, sol->cycle,
           tempsol->cycle, &tempsol->val, 1, 1, prob->rstate_cc))
     { put_err_msg("CCkdtree_twoopt5_tour failed\n");
       compass_tsp_delete_sol (tempsol);
@@ -151,13 +198,15 @@ static int call_threeopt_tour (compass_prob *prob, tsp_solution *sol,
 { compass_data *data = prob->data;
   if ((data->norm & CC_NORM_BITS) == CC_KD_NORM_TYPE)
   { struct tsp_solution *tempsol;
+    ls_engine eng;
     tempsol = xcalloc(1, sizeof(tsp_solution ));
     if (tspcp->msg_lev >= COMPASS_MSG_ALL)
       xprintf ("tsp   :  3-OPT local search...");
     compass_tsp_init_sol(prob, tempsol);
     compass_tsp_copy_sol(prob, sol , tempsol);
     tempsol->val = sol->val;
-    if (CCkdtree_3opt_tour (prob->kdtree, prob->n, data, sol->cycle,
+    select_engine(data, &eng);
+    if (eng.threeopt (prob->kdtree, prob->n, data, sol->cycle,
           tempsol->cycle, &tempsol->val, 1, prob->rstate_cc))
     { put_err_msg("CCkdtree_3opt_tour failed\n");
       compass_tsp_delete_sol (tempsol);
@@ -184,19 +233,37 @@ static int call_threeopt_tour (compass_prob *prob, tsp_solution *sol,
 
 
 static int call_linkern (compass_prob *prob, tsp_solution *sol,
-    struct tsp_cp *tspcp)
-{ struct tsp_prob *tsp = prob->tsp;
+    struct tsp_cp *tspcp, CClk_ctx *lkctx, int nactive, int *active)
+{ int ret; struct tsp_prob *tsp = prob->tsp;
   struct tsp_lkcp *lkcp = tspcp->lkcp;
   struct tsp_solution *tempsol;
+  ls_engine eng;
   tempsol = xmalloc(sizeof(tsp_solution ));
   if (tspcp->msg_lev >= COMPASS_MSG_ALL)
      xprintf ("tsp   :  Lin-Kernighan local search...");
   compass_tsp_init_sol(prob, tempsol);
   tempsol->val = sol->val;
   //lkcp->nkicks = prob->n;
-  if (CClinkern_tour (prob->n, prob->data, tsp->ecount, tsp->elist,
-        100000000, lkcp->nkicks, sol->cycle, tempsol->cycle, &tempsol->val, 1, -1.0, -1.0,
-       (char *) NULL, lkcp->kick_type, prob->rstate_cc))
+  select_engine(prob->data, &eng);
+  if (lkctx != (CClk_ctx *) NULL && nactive >= 0)
+    ret = eng.repair_ctx (lkctx, prob->n, prob->data, tsp->ecount,
+        tsp->elist, nactive, active, sol->cycle, tempsol->cycle,
+        &tempsol->val, 1, prob->rstate_cc);
+  else
+  { /* a temporary context, as CClinkern_tour does */
+    CClk_ctx *ctx = lkctx != (CClk_ctx *) NULL ? lkctx
+        : CClinkern_ctx_alloc ();
+    if (ctx == (CClk_ctx *) NULL)
+      ret = 1;
+    else
+      ret = eng.tour_ctx (ctx, prob->n, prob->data, tsp->ecount,
+          tsp->elist, 100000000, lkcp->nkicks, sol->cycle, tempsol->cycle,
+          &tempsol->val, 1, -1.0, -1.0, (char *) NULL, lkcp->kick_type,
+          prob->rstate_cc);
+    if (lkctx == (CClk_ctx *) NULL)
+      CClinkern_ctx_free (ctx);
+  }
+  if (ret)
   { put_err_msg("CClinkern_tour failed\n");
     compass_tsp_delete_sol (tempsol);
     return 1;
@@ -210,3 +277,52 @@ static int call_linkern (compass_prob *prob, tsp_solution *sol,
   compass_tsp_delete_sol (tempsol);
   return 0;
 }
+
+/* select_engine picks the routines compiled for the norm of data, whose
+ * distances are then computed inline (see linkern-*.c and kdtwoopt-*.c),
+ * or the generic ones, which call data->edgelen: for other norms, for
+ * data with depots and for the views read through a distance cache. An
+ * explicit matrix, or a table of compass_data_build_table, is read
+ * directly, through orig_names for a view. */
+static void select_engine (compass_data *data, ls_engine *eng)
+{ compass_data *root = data->orig != NULL ? data->orig : data;
+  int norm = -1;
+  eng->tour_ctx = CClinkern_tour_ctx;
+  eng->repair_ctx = CClinkern_repair_ctx;
+  eng->twoopt = CCkdtree_twoopt_tour;
+  eng->threeopt = CCkdtree_3opt_tour;
+  if (data->ndepot)
+    return;
+  if (root->adj != (int **) NULL && root->norm != CC_SPARSE)
+    norm = CC_MATRIXNORM;
+  else if (root->cache == NULL && data->x != (double *) NULL
+      && data->y != (double *) NULL)
+    norm = data->norm;
+  switch (norm)
+  { case CC_EUCLIDEAN:
+      eng->tour_ctx = CClinkern_tour_ctx_euc;
+      eng->repair_ctx = CClinkern_repair_ctx_euc;
+      eng->twoopt = CCkdtree_twoopt_tour_euc;
+      eng->threeopt = CCkdtree_3opt_tour_euc;
+      break;
+    case CC_EUCLIDEAN_CEIL:
+      eng->tour_ctx = CClinkern_tour_ctx_ceil;
+      eng->repair_ctx = CClinkern_repair_ctx_ceil;
+      eng->twoopt = CCkdtree_twoopt_tour_ceil;
+      eng->threeopt = CCkdtree_3opt_tour_ceil;
+      break;
+    case CC_ATT:
+      eng->tour_ctx = CClinkern_tour_ctx_att;
+      eng->repair_ctx = CClinkern_repair_ctx_att;
+      break;
+    case CC_GEOGRAPHIC:
+      eng->tour_ctx = CClinkern_tour_ctx_geo;
+      eng->repair_ctx = CClinkern_repair_ctx_geo;
+      break;
+    case CC_MATRIXNORM:
+      eng->tour_ctx = CClinkern_tour_ctx_matrix;
+      eng->repair_ctx = CClinkern_repair_ctx_matrix;
+      break;
+  }
+  return;
+}
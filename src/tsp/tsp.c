@@ -38,7 +38,7 @@ void compass_tsp_solve (compass_prob *prob, struct tsp_cp *tspcp)
     { xprintf("\n");
       xprintf("tsp  :  - Starting local seach...\n");
     }
-    compass_tsp_local_search (prob, prob->tsp->sol, tspcp );
+    compass_tsp_local_search (prob, prob->tsp->sol, tspcp, NULL );
   }
   return;
 }
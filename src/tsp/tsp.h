@@ -96,4 +96,11 @@ struct tsp_cp
   struct tsp_lkcp *lkcp;
 };
 
+struct compass_prob;
+struct CClk_ctx;
+
+int compass_tsp_repair(struct compass_prob *prob, tsp_solution *sol,
+    struct tsp_cp *tspcp, struct CClk_ctx *lkctx, int nactive, int *active);
+/* improve sol after its tour edges at active[0..nactive-1] changed */
+
 #endif
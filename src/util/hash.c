@@ -48,7 +48,7 @@ void compass_hash_update(compass_prob *prob, int flag)
         len =  ceil(log10(prob->op->s[i]));
       }
       else
-      { str[0] = "0";
+      { str[0] = '0';
         len    = 1;
       }
       SHA256_Update(prob->ctx, str, len);